@@ -0,0 +1,230 @@
+// Microbenchmark firmware, built by [env:bench] instead of main.cpp.
+//
+// Times the firmware hot paths with the CPU cycle counter and measures
+// encoder interrupt throughput against a synthetic quadrature signal.
+// Every result is one JSON object per line on the serial port, lines not
+// starting with '{' are comments.
+//
+// The quadrature signal comes out of BENCH_QUAD_A_PIN / BENCH_QUAD_B_PIN.
+// Unplug the encoder and jumper those to ENCODER_A / ENCODER_B.
+
+#include <Arduino.h>
+#include <algorithm>
+#include "driver/ledc.h"
+#include "motor.h"
+#include "steering.h"
+#include "protocol.h"
+#include "control.h"
+#include "telemetry.h"
+#include "watchdog.h"
+
+#ifndef BENCH_QUAD_A_PIN
+#define BENCH_QUAD_A_PIN 4
+#endif
+#ifndef BENCH_QUAD_B_PIN
+#define BENCH_QUAD_B_PIN 5
+#endif
+
+#define BENCH_SAMPLES 1000
+#define BENCH_ISR_WINDOW_MS 200
+
+#define QUAD_TIMER LEDC_TIMER_0
+#define QUAD_CHANNEL_A LEDC_CHANNEL_0
+#define QUAD_CHANNEL_B LEDC_CHANNEL_1
+#define QUAD_BITS 8
+
+static uint32_t samples[BENCH_SAMPLES];
+static uint32_t overheadCycles = 0;
+
+// Sorts samples[] and prints one result line
+static void report(const char *name, size_t n)
+{
+  std::sort(samples, samples + n);
+  float nsPerCycle = 1000.0f / getCpuFreqMHz();
+  uint32_t min = samples[0];
+  uint32_t median = samples[n / 2];
+  uint32_t p99 = samples[(n * 99) / 100];
+  uint32_t max = samples[n - 1];
+
+  Serial.printf("{\"bench\":\"%s\",\"n\":%u,\"min_cycles\":%u,\"median_cycles\":%u,"
+                "\"p99_cycles\":%u,\"max_cycles\":%u,\"min_ns\":%.0f,\"median_ns\":%.0f,\"p99_ns\":%.0f}\n",
+                name, (unsigned)n, min, median, p99, max,
+                min * nsPerCycle, median * nsPerCycle, p99 * nsPerCycle);
+}
+
+// Runs fn BENCH_SAMPLES times, each call timed on its own
+template <typename Fn>
+static void bench(const char *name, Fn fn)
+{
+  for (size_t i = 0; i < BENCH_SAMPLES; i++) {
+    uint32_t start = ESP.getCycleCount();
+    fn(i);
+    uint32_t cycles = ESP.getCycleCount() - start;
+    samples[i] = cycles > overheadCycles ? cycles - overheadCycles : 0;
+  }
+  report(name, BENCH_SAMPLES);
+}
+
+static void measure_overhead()
+{
+  for (size_t i = 0; i < BENCH_SAMPLES; i++) {
+    uint32_t start = ESP.getCycleCount();
+    samples[i] = ESP.getCycleCount() - start;
+  }
+  std::sort(samples, samples + BENCH_SAMPLES);
+  overheadCycles = samples[0];
+  Serial.printf("# timer overhead %u cycles, subtracted from every sample\n", overheadCycles);
+}
+
+static void bench_hot_paths()
+{
+  bench("encoder_isr", [](size_t) { encoderISR(); });
+  bench("encoder_read64", [](size_t) { (void)encoder_read64(); });
+  bench("encoder_snapshot", [](size_t) {
+    encoder_snapshot_t snapshot;
+    encoder_snapshot(&snapshot);
+  });
+  bench("encoder_velocity", [](size_t) { (void)encoder_velocity(); });
+
+  bench("motor_set", [](size_t i) { motor_set(FORWARD, i & 0x3F); });
+  bench("motor_set_output", [](size_t i) { motor_set_output((float)(i & 0x3F) * 0.5f); });
+  bench("motor_set_duty16", [](size_t i) { motor_set_duty16((int32_t)(i & 0x3FFF)); });
+  motor_stop();
+
+  bench("steering_set", [](size_t i) { steering_set(60 + (i & 0x3F)); });
+  bench("steering_set_cdeg", [](size_t i) { steering_set_cdeg(6000 + (i & 0xFFF)); });
+  steering_center();
+
+  bench("telemetry_push", [](size_t) {
+    telemetry_record_t record = {};
+    record.type = TELEM_STATE;
+    telemetry_push(&record);
+  });
+  telemetry_init();
+
+  // Full control iteration with a fresh setpoint every call
+  bench("control_update", [](size_t i) {
+    control_command_t cmd = {};
+    cmd.arrival_us = (uint32_t)esp_timer_get_time();
+    cmd.mode = CONTROL_MODE_OPEN_LOOP;
+    cmd.steer_cdeg = 9000;
+    control_submit(&cmd);
+    control_update();
+    if ((i & 0x7F) == 0) telemetry_init();  // Nothing drains the ring here
+  });
+  motor_stop();
+}
+
+static void quad_init()
+{
+  ledc_timer_config_t timer = {};
+  timer.speed_mode = LEDC_LOW_SPEED_MODE;
+  timer.duty_resolution = (ledc_timer_bit_t)QUAD_BITS;
+  timer.timer_num = QUAD_TIMER;
+  timer.freq_hz = 1000;
+  timer.clk_cfg = LEDC_AUTO_CLK;
+  ledc_timer_config(&timer);
+
+  // Same timer, 50% duty, B shifted a quarter period behind A
+  ledc_channel_config_t channel = {};
+  channel.speed_mode = LEDC_LOW_SPEED_MODE;
+  channel.timer_sel = QUAD_TIMER;
+  channel.duty = 0;
+
+  channel.gpio_num = BENCH_QUAD_A_PIN;
+  channel.channel = QUAD_CHANNEL_A;
+  channel.hpoint = 0;
+  ledc_channel_config(&channel);
+
+  channel.gpio_num = BENCH_QUAD_B_PIN;
+  channel.channel = QUAD_CHANNEL_B;
+  channel.hpoint = 1 << (QUAD_BITS - 2);
+  ledc_channel_config(&channel);
+}
+
+static void quad_run(uint32_t freq_hz, bool on)
+{
+  uint32_t duty = on ? 1 << (QUAD_BITS - 1) : 0;
+  if (on) {
+    ledc_set_freq(LEDC_LOW_SPEED_MODE, QUAD_TIMER, freq_hz);
+  }
+  ledc_set_duty_with_hpoint(LEDC_LOW_SPEED_MODE, QUAD_CHANNEL_A, duty, 0);
+  ledc_set_duty_with_hpoint(LEDC_LOW_SPEED_MODE, QUAD_CHANNEL_B, duty, 1 << (QUAD_BITS - 2));
+  ledc_update_duty(LEDC_LOW_SPEED_MODE, QUAD_CHANNEL_A);
+  ledc_update_duty(LEDC_LOW_SPEED_MODE, QUAD_CHANNEL_B);
+}
+
+// Busy loop on this core for a fixed time, returns iterations completed.
+// Fewer iterations with the signal running = CPU time taken by interrupts.
+static uint32_t spin(uint32_t ms)
+{
+  volatile uint32_t iterations = 0;
+  int64_t end = esp_timer_get_time() + ms * 1000LL;
+  while (esp_timer_get_time() < end) {
+    iterations++;
+  }
+  return iterations;
+}
+
+static void bench_isr_throughput()
+{
+  static const uint32_t rates[] = { 1000, 5000, 10000, 25000, 50000, 100000 };
+
+  quad_init();
+  uint32_t idle = spin(BENCH_ISR_WINDOW_MS);
+
+  for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+    uint32_t freq = rates[i];
+
+    encoder_reset();
+    int64_t start = esp_timer_get_time();
+    quad_run(freq, true);
+    uint32_t busy = spin(BENCH_ISR_WINDOW_MS);
+    quad_run(freq, false);
+    int64_t elapsed = esp_timer_get_time() - start;
+
+    int64_t counted = encoder_read64();
+    if (counted < 0) counted = -counted;
+    int64_t expected = (int64_t)freq * 4 * elapsed / 1000000;
+    float load = 100.0f * (1.0f - (float)busy / idle);
+
+    Serial.printf("{\"bench\":\"isr_throughput\",\"edge_hz\":%u,\"expected\":%lld,"
+                  "\"counted\":%lld,\"lost_pct\":%.2f,\"cpu_load_pct\":%.2f}\n",
+                  (unsigned)(freq * 4), expected, counted,
+                  expected ? 100.0f * (expected - counted) / expected : 0.0f, load);
+  }
+}
+
+void setup()
+{
+  Serial.begin(115200);
+  unsigned long startWait = millis();
+  while (!Serial && (millis() - startWait < 3000)) {
+    delay(100);
+  }
+
+  motor_init();
+  steering_init(true);
+  protocol_init();
+  telemetry_init();
+  watchdog_init();
+  control_init();
+
+#ifdef ENCODER_BACKEND_PCNT
+  Serial.println("# encoder backend: pcnt");
+#else
+  Serial.println("# encoder backend: isr");
+#endif
+  Serial.printf("# cpu %u MHz, %u samples per bench\n", getCpuFreqMHz(), BENCH_SAMPLES);
+
+  measure_overhead();
+  bench_hot_paths();
+  bench_isr_throughput();
+
+  Serial.println("# done");
+}
+
+void loop()
+{
+  delay(1000);
+}
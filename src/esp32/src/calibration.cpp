@@ -0,0 +1,139 @@
+#include "calibration.h"
+#include "encoder.h"
+#include "motor.h"
+#include "watchdog.h"
+#include "instrument.h"
+#include <Preferences.h>
+
+static calibration_t cal;
+static uint8_t source = CAL_SOURCE_DEFAULTS;
+
+static void fill_defaults(calibration_t *c)
+{
+  memset(c, 0, sizeof(*c));
+  c->magic = CALIBRATION_MAGIC;
+  c->version = CALIBRATION_VERSION;
+  c->size = sizeof(*c);
+
+  c->steering = { STEERING_CENTER, STEERING_LEFT, STEERING_RIGHT,
+                  STEERING_PULSE_MIN_US, STEERING_PULSE_MAX_US };
+  c->gains = { SPEED_KP, SPEED_KI, SPEED_KD, SPEED_KFF };
+  c->profile = { { PROFILE_DUTY_ACCEL, PROFILE_DUTY_DECEL, PROFILE_DUTY_JERK },
+                 { PROFILE_VEL_ACCEL, PROFILE_VEL_DECEL, PROFILE_VEL_JERK },
+                 PROFILE_BRAKE_VELOCITY, PROFILE_BRAKE_TIMEOUT_MS };
+  c->move = { MOVE_DECEL, MOVE_MIN_SPEED };
+  c->fault = { FAULT_STALL_DUTY, FAULT_STALL_RATIO, FAULT_STALL_VELOCITY, FAULT_STALL_MS,
+               FAULT_LOSS_VELOCITY, FAULT_LOSS_EDGES,
+               FAULT_MISMATCH_VELOCITY, FAULT_MISMATCH_MS };
+  c->watchdog_ms = WATCHDOG_DEADLINE_MS;
+  c->motor_pwm_hz = MOTOR_PWM_FREQ_HZ;
+  c->motor_decay = MOTOR_DECAY;
+  c->load_stream = 1;
+
+  c->encoder_a = ENCODER_A;
+  c->encoder_b = ENCODER_B;
+  c->race_mode = 0;
+  c->encoder_filter = ENCODER_FILTER_CYCLES;
+}
+
+// One blob read. Anything missing, short or from another layout version
+// leaves out untouched.
+static bool read_flash(calibration_t *out)
+{
+  Preferences prefs;
+  if (!prefs.begin(CALIBRATION_NAMESPACE, true)) return false;
+
+  calibration_t stored;
+  size_t len = prefs.getBytes(CALIBRATION_KEY, &stored, sizeof(stored));
+  prefs.end();
+
+  if (len != sizeof(stored)) return false;
+  if (stored.magic != CALIBRATION_MAGIC || stored.version != CALIBRATION_VERSION) return false;
+  if (stored.size != sizeof(stored)) return false;
+
+  *out = stored;
+  return true;
+}
+
+// Boot: defaults, then whatever valid record is in flash
+void calibration_init()
+{
+  fill_defaults(&cal);
+  source = read_flash(&cal) ? CAL_SOURCE_FLASH : CAL_SOURCE_DEFAULTS;
+  calibration_apply();
+}
+
+// Push the record into the modules. Encoder pins only take effect in the
+// next encoder_init(), i.e. after a reboot.
+void calibration_apply()
+{
+  if (!steering_set_cal(&cal.steering)) {
+    cal.steering = { STEERING_CENTER, STEERING_LEFT, STEERING_RIGHT,
+                     STEERING_PULSE_MIN_US, STEERING_PULSE_MAX_US };
+    steering_set_cal(&cal.steering);
+  }
+  speed_control_set_gains(&cal.gains);
+  motion_profile_set_config(&cal.profile);
+  move_set_config(&cal.move);
+  fault_set_config(&cal.fault);
+  if (cal.watchdog_ms > 0) watchdog_set_deadline_ms(cal.watchdog_ms);
+  motor_set_pwm(cal.motor_pwm_hz, cal.motor_decay);
+  instrument_set_stream(cal.load_stream != 0);
+  encoder_configure(cal.encoder_a, cal.encoder_b, cal.encoder_filter);
+}
+
+// Collect the live values and write them as one blob. NVS writes stall
+// flash access on both cores for a few ms, so this is refused while the
+// motor is driven.
+bool calibration_save()
+{
+  if (motor_running()) return false;
+
+  steering_get_cal(&cal.steering);
+  speed_control_get_gains(&cal.gains);
+  motion_profile_get_config(&cal.profile);
+  move_get_config(&cal.move);
+  fault_get_config(&cal.fault);
+  cal.watchdog_ms = watchdog_get_deadline_ms();
+  cal.motor_pwm_hz = motor_get_pwm_freq();
+  cal.motor_decay = motor_get_decay();
+  cal.load_stream = instrument_get_stream();
+
+  Preferences prefs;
+  if (!prefs.begin(CALIBRATION_NAMESPACE, false)) return false;
+  bool ok = prefs.putBytes(CALIBRATION_KEY, &cal, sizeof(cal)) == sizeof(cal);
+  prefs.end();
+
+  if (ok) source = CAL_SOURCE_FLASH;
+  return ok;
+}
+
+// Back to what is stored, dropping unsaved changes
+bool calibration_reload()
+{
+  calibration_t stored;
+  if (!read_flash(&stored)) return false;
+  cal = stored;
+  source = CAL_SOURCE_FLASH;
+  calibration_apply();
+  return true;
+}
+
+// Compiled-in defaults, live until saved
+void calibration_defaults()
+{
+  fill_defaults(&cal);
+  source = CAL_SOURCE_DEFAULTS;
+  calibration_apply();
+}
+
+uint8_t calibration_source()
+{
+  return source;
+}
+
+// Boot-only fields are edited here directly, from the comms task
+calibration_t *calibration_get()
+{
+  return &cal;
+}
@@ -0,0 +1,54 @@
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <Arduino.h>
+#include "steering.h"
+#include "speed_control.h"
+#include "motion_profile.h"
+#include "move.h"
+#include "fault.h"
+
+// Every tunable in one struct, stored as a single NVS blob and read back in
+// one call at boot. Modules keep their own live copy; calibration_save()
+// collects those back into the record first. Bump CALIBRATION_VERSION
+// whenever the layout changes, an older record then falls back to defaults.
+#define CALIBRATION_MAGIC 0x314C4143  // "CAL1"
+#define CALIBRATION_VERSION 4
+#define CALIBRATION_NAMESPACE "wro"
+#define CALIBRATION_KEY "cal"
+
+// Where the values in use came from
+#define CAL_SOURCE_DEFAULTS 0
+#define CAL_SOURCE_FLASH 1
+
+typedef struct {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t size;              // sizeof(calibration_t) when written
+
+  steering_cal_t steering;
+  speed_gains_t gains;
+  profile_config_t profile;
+  move_config_t move;
+  fault_config_t fault;
+  uint32_t watchdog_ms;
+  uint32_t motor_pwm_hz;
+  uint8_t motor_decay;
+  uint8_t load_stream;
+
+  // Only read at boot
+  uint8_t encoder_a;
+  uint8_t encoder_b;
+  uint8_t race_mode;          // Skip the serial wait and init delays
+  uint16_t encoder_filter;
+} calibration_t;
+
+void calibration_init();
+void calibration_apply();
+bool calibration_save();
+bool calibration_reload();
+void calibration_defaults();
+uint8_t calibration_source();
+calibration_t *calibration_get();
+
+#endif
@@ -0,0 +1,245 @@
+#include "control.h"
+#include "motor.h"
+#include "steering.h"
+#include "speed_control.h"
+#include "telemetry.h"
+#include "watchdog.h"
+#include "trajectory.h"
+#include "odometry.h"
+#include "motion_profile.h"
+#include "move.h"
+#include "fault.h"
+#include "trigger.h"
+
+// Single-slot mailbox: the comms task overwrites, the control task drains
+static QueueHandle_t commandQueue = NULL;
+static QueueHandle_t traceQueue = NULL;
+
+static uint8_t mode = CONTROL_MODE_OPEN_LOOP;
+static float target = 0;  // Commanded speed, before the motion profile
+static int64_t lastUpdate = 0;
+
+void control_init()
+{
+  commandQueue = xQueueCreate(1, sizeof(control_command_t));
+  if (!traceQueue) {
+    traceQueue = xQueueCreate(CONTROL_TRACE_QUEUE, sizeof(control_trace_t));
+  }
+  mode = CONTROL_MODE_OPEN_LOOP;
+  target = 0;
+  lastUpdate = esp_timer_get_time();
+  speed_control_init();
+  motion_profile_init();
+  move_init();
+  fault_init();
+  trigger_init();
+  trajectory_init();
+  odometry_init();
+}
+
+void control_submit(const control_command_t *cmd)
+{
+  xQueueOverwrite(commandQueue, cmd);
+}
+
+// Only records the target, control_update() ramps towards it
+static void apply_setpoint(uint8_t newMode, int32_t speed, int32_t steer_cdeg)
+{
+  if (newMode != mode) {
+    // Pick the ramp up where the wheel is now
+    if (newMode == CONTROL_MODE_VELOCITY) {
+      speed_control_reset();
+      motion_profile_reset(newMode, encoder_velocity());
+    } else {
+      motion_profile_reset(newMode, motor_get_output());
+    }
+  }
+
+  if (newMode == CONTROL_MODE_VELOCITY) {
+    target = speed;
+  } else {
+    target = constrain(speed, -100, 100);
+  }
+  mode = newMode;
+  steering_set_cdeg(steer_cdeg);
+}
+
+// Stop right away, no ramp
+static void stop_now()
+{
+  mode = CONTROL_MODE_OPEN_LOOP;
+  target = 0;
+  motion_profile_reset(mode, 0);
+  speed_control_reset();
+  motor_stop();
+}
+
+// A direct command always wins over a trajectory or move that is running
+static void apply_command(const control_command_t *cmd, int64_t count)
+{
+  trajectory_abort();
+  if (cmd->mode == CONTROL_MODE_MOVE) {
+    move_start(cmd->seq, count, cmd->distance, cmd->speed);
+    apply_setpoint(CONTROL_MODE_VELOCITY, 0, cmd->steer_cdeg);
+    return;
+  }
+  move_finish(MOVE_RESULT_ABORTED, count);
+  apply_setpoint(cmd->mode, cmd->speed, cmd->steer_cdeg);
+}
+
+// Pi went quiet: stop, center and wait for the next command. Armed
+// triggers go too, nobody is left to act on them.
+static void failsafe(int64_t count)
+{
+  trajectory_abort();
+  trigger_clear_all();
+  move_finish(MOVE_RESULT_FAILSAFE, count);
+  stop_now();
+  steering_center();
+}
+
+static void publish_state(int64_t now, int64_t count, uint16_t flags)
+{
+  telemetry_record_t record;
+  record.time_us = (uint32_t)now;
+  record.type = TELEM_STATE;
+  record.flags = flags;
+  if (motor_running()) record.flags |= TELEM_FLAG_RUNNING;
+  if (mode == CONTROL_MODE_VELOCITY) record.flags |= TELEM_FLAG_VELOCITY;
+  if (watchdog_tripped()) record.flags |= TELEM_FLAG_FAILSAFE;
+  if (trajectory_active()) record.flags |= TELEM_FLAG_TRAJECTORY;
+  if (motion_profile_braking()) record.flags |= TELEM_FLAG_BRAKING;
+  if (move_active()) record.flags |= TELEM_FLAG_MOVE;
+  record.state.count = (int32_t)count;
+  record.state.velocity = (int32_t)encoder_velocity();
+  record.state.duty = (int16_t)(motor_get_output() * 100);
+  record.state.steer_cdeg = steering_get_cdeg();
+  record.state.overruns = telemetry_overruns();
+  telemetry_push(&record);
+
+  odom_pose_t pose;
+  odometry_get(&pose);
+  record.type = TELEM_ODOM;
+  record.odom.x = (int32_t)(pose.x_mm * 10);
+  record.odom.y = (int32_t)(pose.y_mm * 10);
+  record.odom.heading = (int16_t)(pose.heading * 10000);
+  record.odom.yaw_rate = (int16_t)constrain(pose.yaw_rate * 1000, -32768.0f, 32767.0f);
+  record.odom.distance = (uint32_t)pose.distance_mm;
+  telemetry_push(&record);
+}
+
+static void publish_fault(int64_t now, int64_t count, const fault_event_t *fault)
+{
+  telemetry_record_t record;
+  record.time_us = (uint32_t)now;
+  record.type = TELEM_FAULT;
+  record.flags = TELEM_FLAG_STALL;
+  record.fault.code = fault->code;
+  record.fault.pad = 0;
+  record.fault.duty = (int16_t)(fault->duty * 100);
+  record.fault.velocity = (int32_t)fault->velocity;
+  record.fault.duration = fault->duration_ms;
+  record.fault.count = (int32_t)count;
+  telemetry_push(&record);
+}
+
+// Runs every control period on CONTROL_CORE
+void control_update()
+{
+  encoder_snapshot_t enc;
+  encoder_snapshot(&enc);
+  int64_t count = enc.count;
+
+  control_command_t cmd;
+  control_trace_t trace = {};
+  if (xQueueReceive(commandQueue, &cmd, 0) == pdTRUE) {
+    apply_command(&cmd, count);
+    watchdog_actuated(cmd.arrival_us, (uint32_t)esp_timer_get_time());
+    trace.seq = cmd.seq;
+    trace.trace = cmd.trace;
+    trace.arrival_us = cmd.arrival_us;
+  }
+
+  trigger_update(count, enc.edge_us);
+
+  int64_t now = esp_timer_get_time();
+
+  traj_sample_t sample;
+  if (trajectory_sample(now, count, &sample)) {
+    apply_setpoint(sample.mode, sample.speed, sample.steer_cdeg);
+    trace.flags |= TRACE_FLAG_OVERRIDDEN;
+    if (!sample.last) {
+      watchdog_hold((uint32_t)now);  // Queued plan still has points to go
+    }
+  }
+
+  float moveTarget;
+  switch (move_sample(now, count, encoder_velocity(), &moveTarget))
+  {
+    case MOVE_STEP_DRIVE:
+      apply_setpoint(CONTROL_MODE_VELOCITY, (int32_t)moveTarget, steering_get_cdeg());
+      watchdog_hold((uint32_t)now);  // The Pi is waiting for the completion
+      trace.flags |= TRACE_FLAG_OVERRIDDEN;
+      break;
+    case MOVE_STEP_BRAKE:
+      stop_now();
+      watchdog_hold((uint32_t)now);
+      trace.flags |= TRACE_FLAG_OVERRIDDEN;
+      break;
+    default:
+      break;
+  }
+
+  if (watchdog_check((uint32_t)now)) {
+    failsafe(count);
+    trace.flags |= TRACE_FLAG_STOPPED;
+  }
+  float dt = (now - lastUpdate) * 1e-6f;
+  lastUpdate = now;
+
+  if (dt > 0) {
+    float setpoint = motion_profile_step(target, encoder_velocity(), dt);
+    if (motion_profile_braking() || setpoint != target) trace.flags |= TRACE_FLAG_RAMPING;
+    if (motion_profile_braking()) {
+      motor_stop();  // Reversing: drive off until the wheel has slowed
+      speed_control_reset();
+    } else if (mode == CONTROL_MODE_VELOCITY) {
+      speed_control_set_target(setpoint);
+      speed_control_update(dt);
+    } else {
+      motor_set_output(setpoint);
+    }
+  }
+
+  // Servo and PWM registers now hold this tick's output; flags say how
+  // much of it is the command's. Sent after the fault check, which can
+  // still stop it.
+  if (trace.trace) trace.applied_us = (uint32_t)esp_timer_get_time();
+
+  odometry_update((uint32_t)now, count, steering_get_cdeg());
+
+  uint16_t flags = 0;
+  fault_event_t fault;
+  if (fault_check(now, &enc, motor_get_output(), encoder_velocity(), &fault) != FAULT_NONE) {
+    // Nothing may drive on after this: a trajectory would set its next
+    // point on the next tick, and stop_now() drops the old target so the
+    // profile ramps from zero towards nothing
+    trajectory_abort();
+    move_finish(fault.code == FAULT_STALL ? MOVE_RESULT_STALLED : MOVE_RESULT_FAULT, count);
+    stop_now();  // Don't let the PID loop push into the wall
+    flags |= TELEM_FLAG_STALL;
+    publish_fault(now, count, &fault);
+    trace.flags |= TRACE_FLAG_STOPPED;
+  }
+
+  if (trace.trace) {
+    xQueueSend(traceQueue, &trace, 0);  // Dropped if the Pi link is backed up
+  }
+
+  publish_state(now, count, flags);
+}
+
+bool control_poll_trace(control_trace_t *trace)
+{
+  return xQueueReceive(traceQueue, trace, 0) == pdTRUE;
+}
@@ -0,0 +1,46 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <Arduino.h>
+
+// How control_command_t.speed is interpreted
+#define CONTROL_MODE_OPEN_LOOP 0  // speed = duty percent, -100..100
+#define CONTROL_MODE_VELOCITY 1   // speed = target ticks/s, held by the PID loop
+#define CONTROL_MODE_MOVE 2       // Commands only: drive distance ticks at up to speed ticks/s
+
+// Latest setpoint from the Pi, handed from the comms task to the control task
+typedef struct {
+  uint32_t arrival_us; // When the comms task received it
+  uint8_t mode;        // CONTROL_MODE_*
+  int16_t steer_cdeg;  // Steering angle in 0.01 degree
+  int32_t speed;       // Negative = reverse, units depend on mode
+  int32_t distance;    // CONTROL_MODE_MOVE: signed ticks to travel
+  uint8_t seq;         // Echoed in the MOVE completion / MSG_TRACE frame
+  uint16_t trace;      // Pi trace id, 0 = not traced
+} control_command_t;
+
+#define CONTROL_TRACE_QUEUE 8
+
+// control_trace_t.flags: why the output written in that tick is not (all
+// of) what the command asked for. 0 = the command's own output, in full.
+#define TRACE_FLAG_OVERRIDDEN 0x01  // A trajectory point or distance move set the output
+#define TRACE_FLAG_STOPPED 0x02     // Fault or failsafe stopped the motor
+#define TRACE_FLAG_RAMPING 0x04     // The motion profile took only a step towards it
+
+// A traced command reaching the motor and servo
+typedef struct {
+  uint8_t seq;
+  uint8_t flags;        // TRACE_FLAG_*
+  uint16_t trace;
+  uint32_t arrival_us;  // Comms task received the command
+  uint32_t applied_us;  // Control task's output write in the tick it was taken
+} control_trace_t;
+
+void control_init();
+void control_submit(const control_command_t *cmd);
+void control_update();
+
+// Comms task
+bool control_poll_trace(control_trace_t *trace);
+
+#endif
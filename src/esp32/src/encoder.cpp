@@ -0,0 +1,441 @@
+#include "encoder.h"
+#include "instrument.h"
+#include <atomic>
+
+#ifdef ENCODER_BACKEND_PCNT
+#include "driver/pcnt.h"
+#include "hal/pcnt_ll.h"
+#include "soc/pcnt_struct.h"
+#endif
+
+// Edge history for the velocity estimate. count is in velocity ticks:
+// every edge in the ISR backend, every fourth tick (rising edge of A) in
+// the PCNT backend.
+typedef struct {
+  uint32_t time_us;
+  int32_t count;
+} encoder_edge_t;
+
+// Everything the edge ISR writes. The ISR is the only writer and
+// publishes through a seqlock: seq is odd while an update is in progress,
+// readers copy and retry if seq changed. Neither side takes a lock, so a
+// reader on the other core never delays the ISR and never sees a torn
+// 64-bit count.
+typedef struct {
+  uint8_t head;  // Newest entry in edges[]
+  uint8_t fill;  // Valid entries, saturates at ENCODER_EDGE_HISTORY
+  encoder_edge_t edges[ENCODER_EDGE_HISTORY];
+} edge_history_t;
+
+typedef struct {
+  encoder_snapshot_t snap;  // Raw count (ISR backend only, PCNT counts in hardware)
+  edge_history_t history;
+  int32_t edgeTicks;        // Running count for the edge history
+  int8_t lastEncoded;       // Previous A/B state for the decoder table
+} isr_state_t;
+
+// Set before encoder_init(), fixed afterwards
+static uint8_t pinA = ENCODER_A;
+static uint8_t pinB = ENCODER_B;
+static uint16_t filterCycles = ENCODER_FILTER_CYCLES;
+static bool started = false;
+
+static isr_state_t isrState;
+static std::atomic<uint32_t> isrSeq(0);
+
+// Position of the last encoder_reset(), subtracted from the raw count so
+// reset never has to write ISR state
+static std::atomic<int64_t> resetBase(0);
+
+// Position compare window. base mirrors resetBase so the edge interrupt
+// can turn the raw count into the caller's ticks without another atomic.
+typedef struct {
+  int64_t low;
+  int64_t high;
+  int64_t base;
+  encoder_compare_fn_t fn;
+} compare_t;
+
+static compare_t compare = { INT64_MIN, INT64_MAX, 0, NULL };
+static portMUX_TYPE compareMux = portMUX_INITIALIZER_UNLOCKED;
+static std::atomic<bool> compareArmed(false);  // Skips the lock on every edge when unused
+
+static inline void IRAM_ATTR write_begin()
+{
+  isrSeq.store(isrSeq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+static inline void IRAM_ATTR write_end()
+{
+  isrSeq.store(isrSeq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+// Consistent copy of len bytes of isrState at src. Retries while the ISR
+// is mid-update; an edge takes well under a microsecond, so this rarely
+// loops more than once.
+static void read_state(void *out, const void *src, size_t len)
+{
+  uint32_t before, after;
+  do {
+    before = isrSeq.load(std::memory_order_acquire);
+    memcpy(out, src, len);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    after = isrSeq.load(std::memory_order_relaxed);
+  } while ((before & 1) || before != after);
+}
+
+// Called between write_begin() and write_end()
+static inline void IRAM_ATTR record_edge(int8_t direction, int32_t ticks)
+{
+  int64_t now = esp_timer_get_time();
+  edge_history_t *h = &isrState.history;
+
+  isrState.snap.edge_us = now;
+  isrState.snap.direction = direction;
+  isrState.edgeTicks += ticks;
+  h->head = (h->head + 1) % ENCODER_EDGE_HISTORY;
+  h->edges[h->head].time_us = (uint32_t)now;
+  h->edges[h->head].count = isrState.edgeTicks;
+  if (h->fill < ENCODER_EDGE_HISTORY) h->fill++;
+}
+
+static inline int64_t isr_raw_count();
+
+// After write_end(), so the callback runs outside the seqlock and may read
+// the encoder itself
+static inline void IRAM_ATTR check_compare()
+{
+  if (!compareArmed.load(std::memory_order_relaxed)) return;
+
+  portENTER_CRITICAL_ISR(&compareMux);
+  compare_t c = compare;
+  portEXIT_CRITICAL_ISR(&compareMux);
+
+  int64_t count = isr_raw_count() - c.base;
+  if (c.fn && (count <= c.low || count >= c.high)) {
+    c.fn(count, isrState.snap.edge_us);
+  }
+}
+
+#ifdef ENCODER_BACKEND_PCNT
+
+#define ENCODER_PCNT_UNIT PCNT_UNIT_0
+
+// The interrupt paths read the unit through the inline LL accessors: the
+// pcnt_get_* driver calls are in flash and fault if an edge arrives while
+// the cache is off.
+#define ENCODER_PCNT_HW (&PCNT)
+
+#define ENCODER_PCNT_INTR (1 << ENCODER_PCNT_UNIT)
+
+// Counts folded in from the hardware counter each time it hits a limit.
+// pcnt_limit_isr is the only writer and publishes through pcntGen, a
+// seqlock like isrSeq: odd while a fold is in progress, bumped twice per
+// fold. The unit's raw interrupt bit is cleared inside the fold, so while
+// it is set the counter has been reset and pcntAccum does not have it yet.
+static volatile int64_t pcntAccum = 0;
+static std::atomic<uint32_t> pcntGen(0);
+
+// Rising edge of A is one full quadrature cycle. PCNT does the counting,
+// this only timestamps it; B low means forward, same as the decoder.
+void IRAM_ATTR encoderISR()
+{
+  uint32_t start = instrument_cycles();
+  int8_t direction = digitalRead(pinB) ? -1 : 1;
+  write_begin();
+  record_edge(direction, direction * ENCODER_TICKS_PER_EDGE);
+  write_end();
+  check_compare();
+  instrument_isr(ISR_ENCODER_EDGE, start);
+}
+
+// Limit event: the hardware has already reset the counter to zero. A
+// handler of its own rather than the shared ISR service, which clears the
+// interrupt before calling in and so hides the fold from readers.
+static void IRAM_ATTR pcnt_limit_isr(void *arg)
+{
+  uint32_t start = instrument_cycles();
+  if (!(PCNT.int_st.val & ENCODER_PCNT_INTR)) return;
+  uint32_t status = pcnt_ll_get_event_status(ENCODER_PCNT_HW, ENCODER_PCNT_UNIT);
+
+  pcntGen.store(pcntGen.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  if (status & PCNT_EVT_H_LIM) pcntAccum += ENCODER_PCNT_LIMIT;
+  if (status & PCNT_EVT_L_LIM) pcntAccum -= ENCODER_PCNT_LIMIT;
+  PCNT.int_clr.val = ENCODER_PCNT_INTR;
+  pcntGen.store(pcntGen.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  instrument_isr(ISR_PCNT_LIMIT, start);
+}
+
+void encoder_init()
+{
+  pinMode(pinA, INPUT_PULLUP);
+  pinMode(pinB, INPUT_PULLUP);
+
+  // Full x4 decoding: each channel counts both edges of one signal and
+  // uses the other signal as direction. Same sign as the ISR table.
+  pcnt_config_t config = {};
+  config.unit = ENCODER_PCNT_UNIT;
+  config.counter_h_lim = ENCODER_PCNT_LIMIT;
+  config.counter_l_lim = -ENCODER_PCNT_LIMIT;
+
+  config.channel = PCNT_CHANNEL_0;
+  config.pulse_gpio_num = pinA;
+  config.ctrl_gpio_num = pinB;
+  config.pos_mode = PCNT_COUNT_DEC;
+  config.neg_mode = PCNT_COUNT_INC;
+  config.lctrl_mode = PCNT_MODE_REVERSE;
+  config.hctrl_mode = PCNT_MODE_KEEP;
+  pcnt_unit_config(&config);
+
+  config.channel = PCNT_CHANNEL_1;
+  config.pulse_gpio_num = pinB;
+  config.ctrl_gpio_num = pinA;
+  config.pos_mode = PCNT_COUNT_INC;
+  config.neg_mode = PCNT_COUNT_DEC;
+  pcnt_unit_config(&config);
+
+  pcnt_set_filter_value(ENCODER_PCNT_UNIT, filterCycles);
+  pcnt_filter_enable(ENCODER_PCNT_UNIT);
+
+  pcnt_event_enable(ENCODER_PCNT_UNIT, PCNT_EVT_H_LIM);
+  pcnt_event_enable(ENCODER_PCNT_UNIT, PCNT_EVT_L_LIM);
+
+  pcnt_counter_pause(ENCODER_PCNT_UNIT);
+  pcnt_counter_clear(ENCODER_PCNT_UNIT);
+
+  pcnt_isr_register(pcnt_limit_isr, NULL, ESP_INTR_FLAG_IRAM, NULL);
+  pcnt_intr_enable(ENCODER_PCNT_UNIT);
+
+  pcnt_counter_resume(ENCODER_PCNT_UNIT);
+
+  attachInterrupt(digitalPinToInterrupt(pinA), encoderISR, RISING);
+  started = true;
+}
+
+static inline bool IRAM_ATTR pcnt_fold_pending()
+{
+  return PCNT.int_raw.val & ENCODER_PCNT_INTR;
+}
+
+// Accumulated plus hardware count, lock-free so it never holds up the
+// fold. A limit hit the ISR has not folded yet (pending, or running on
+// the other core) is added here; the pending bit is sampled on both sides
+// of the counter read so a limit hit in between retries instead of being
+// counted twice or not at all.
+static inline int64_t IRAM_ATTR pcnt_total()
+{
+  uint32_t before, after;
+  bool pending, still;
+  int64_t total;
+  do {
+    before = pcntGen.load(std::memory_order_acquire);
+    pending = pcnt_fold_pending();
+    int16_t count = 0;
+    pcnt_ll_get_counter_value(ENCODER_PCNT_HW, ENCODER_PCNT_UNIT, &count);
+    uint32_t status = pcnt_ll_get_event_status(ENCODER_PCNT_HW, ENCODER_PCNT_UNIT);
+    still = pcnt_fold_pending();
+
+    total = pcntAccum + count;
+    if (pending) {
+      if (status & PCNT_EVT_H_LIM) total += ENCODER_PCNT_LIMIT;
+      if (status & PCNT_EVT_L_LIM) total -= ENCODER_PCNT_LIMIT;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    after = pcntGen.load(std::memory_order_relaxed);
+  } while ((before & 1) || before != after || pending != still);
+  return total;
+}
+
+static int64_t raw_count()
+{
+  return pcnt_total();
+}
+
+// Hardware count for the compare check, read only when a window is armed
+static inline int64_t IRAM_ATTR isr_raw_count()
+{
+  return pcnt_total();
+}
+
+#elif defined(ENCODER_BACKEND_ISR)
+
+// Encoder interrupt handler
+void IRAM_ATTR encoderISR()
+{
+  uint32_t start = instrument_cycles();
+  int MSB = digitalRead(pinA);
+  int LSB = digitalRead(pinB);
+  int encoded = (MSB << 1) | LSB;
+  int sum = (isrState.lastEncoded << 2) | encoded;
+
+  int8_t step = 0;
+  if (sum == 0b1101 || sum == 0b0100 || sum == 0b0010 || sum == 0b1011) step = 1;
+  if (sum == 0b1110 || sum == 0b0111 || sum == 0b0001 || sum == 0b1000) step = -1;
+
+  write_begin();
+  isrState.lastEncoded = encoded;
+  if (step) {
+    isrState.snap.count += step;
+    record_edge(step, step);
+  }
+  write_end();
+  if (step) check_compare();
+  instrument_isr(ISR_ENCODER_EDGE, start);
+}
+
+void encoder_init()
+{
+  pinMode(pinA, INPUT_PULLUP);
+  pinMode(pinB, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(pinA), encoderISR, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(pinB), encoderISR, CHANGE);
+  started = true;
+}
+
+#else  // ENCODER_BACKEND_SIM
+
+// No pins, the plant calls encoder_sim_step() instead
+void encoderISR()
+{
+}
+
+// One quadrature tick from the simulated wheel, at the current sim time
+void encoder_sim_step(int8_t step)
+{
+  write_begin();
+  isrState.snap.count += step;
+  record_edge(step, step);
+  write_end();
+  check_compare();
+}
+
+// Also called between simulation runs, so it starts from a clean slate
+void encoder_init()
+{
+  memset(&isrState, 0, sizeof(isrState));
+  resetBase.store(0);
+  encoder_clear_compare();
+  compare.base = 0;
+  started = true;
+}
+
+#endif
+
+#ifndef ENCODER_BACKEND_PCNT
+static int64_t raw_count()
+{
+  int64_t count;
+  read_state(&count, &isrState.snap.count, sizeof(count));
+  return count;
+}
+
+// Only ever called from the edge interrupt, the one writer
+static inline int64_t IRAM_ATTR isr_raw_count()
+{
+  return isrState.snap.count;
+}
+#endif
+
+// Pins and glitch filter from the calibration store, read by encoder_init()
+// and ignored after it. The filter only applies to the PCNT backend.
+void encoder_configure(uint8_t pin_a, uint8_t pin_b, uint16_t filter_cycles)
+{
+  if (started) return;  // The ISR reads the pins
+  pinA = pin_a;
+  pinB = pin_b;
+  filterCycles = filter_cycles > ENCODER_FILTER_MAX ? ENCODER_FILTER_MAX : filter_cycles;
+}
+
+// Count, newest edge time and direction from one consistent copy. With PCNT
+// the count comes from the hardware and can be up to three ticks past the
+// newest timestamped edge.
+void encoder_snapshot(encoder_snapshot_t *snapshot)
+{
+  read_state(snapshot, &isrState.snap, sizeof(*snapshot));
+#ifdef ENCODER_BACKEND_PCNT
+  snapshot->count = raw_count();
+#endif
+  snapshot->count -= resetBase.load();
+}
+
+int64_t encoder_read64()
+{
+  return raw_count() - resetBase.load();
+}
+
+long encoder_read()
+{
+  return (long)encoder_read64();
+}
+
+// Armed compare windows stay in ticks, so they move along with the count
+void encoder_reset()
+{
+  int64_t base = raw_count();
+  resetBase.store(base);
+  portENTER_CRITICAL(&compareMux);
+  compare.base = base;
+  portEXIT_CRITICAL(&compareMux);
+}
+
+// Replaces the window. Safe from tasks and from inside fn itself;
+// portENTER_CRITICAL_SAFE picks the ISR variant when needed.
+void IRAM_ATTR encoder_set_compare(int64_t low, int64_t high, encoder_compare_fn_t fn)
+{
+  portENTER_CRITICAL_SAFE(&compareMux);
+  compare.low = low;
+  compare.high = high;
+  compare.fn = fn;
+  portEXIT_CRITICAL_SAFE(&compareMux);
+  compareArmed.store(fn != NULL);
+}
+
+void IRAM_ATTR encoder_clear_compare()
+{
+  encoder_set_compare(INT64_MIN, INT64_MAX, NULL);
+}
+
+// Velocity in ticks/s from the edge history. Dense edges average over the
+// newest ENCODER_VEL_WINDOW_US (count delta), sparse edges give the time
+// between the last two (period measurement). Between edges the estimate
+// is capped by the time since the last one, so a stalled wheel reads
+// close to zero within a few edge periods instead of holding its last value.
+float encoder_velocity()
+{
+  edge_history_t history;
+  read_state(&history, &isrState.history, sizeof(history));
+
+  if (history.fill < 2) {
+    return 0;
+  }
+
+  const encoder_edge_t *last = &history.edges[history.head];
+  uint32_t sinceLast = (uint32_t)esp_timer_get_time() - last->time_us;
+  if (sinceLast > ENCODER_VEL_TIMEOUT_US) {
+    return 0;
+  }
+
+  // Walk back to the first edge at least one window older than the newest
+  const encoder_edge_t *ref = NULL;
+  uint8_t spanEdges = 0;
+  for (uint8_t i = 1; i < history.fill; i++) {
+    ref = &history.edges[(history.head + ENCODER_EDGE_HISTORY - i) % ENCODER_EDGE_HISTORY];
+    spanEdges = i;
+    if (last->time_us - ref->time_us >= ENCODER_VEL_WINDOW_US) break;
+  }
+
+  uint32_t span = last->time_us - ref->time_us;
+  if (span == 0) {
+    return 0;
+  }
+  float velocity = (float)(last->count - ref->count) * 1e6f / span;
+
+  // Slowing down: no edge yet where the last interval predicted one
+  uint32_t interval = span / spanEdges;
+  if (sinceLast > interval) {
+    velocity = velocity * interval / sinceLast;
+  }
+  return velocity;
+}
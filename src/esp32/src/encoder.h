@@ -0,0 +1,66 @@
+#ifndef ENCODER_H
+#define ENCODER_H
+
+#include <Arduino.h>
+
+// Default encoder pins (on IO header), see encoder_configure()
+#define ENCODER_A 44  // Green wire
+#define ENCODER_B 43  // Yellow wire
+
+// Quadrature decoder backend. The PCNT pulse counter is the default, build
+// with -DENCODER_BACKEND_ISR to use the GPIO interrupt decoder instead.
+// The native build (-DHAL_SIM) takes its ticks from the simulated plant.
+#if defined(HAL_SIM)
+#define ENCODER_BACKEND_SIM
+#elif !defined(ENCODER_BACKEND_ISR)
+#define ENCODER_BACKEND_PCNT
+#endif
+
+// Ticks between two timestamped edges: the PCNT backend only timestamps
+// rising edges of A, the ISR backend sees every edge
+#ifdef ENCODER_BACKEND_PCNT
+#define ENCODER_TICKS_PER_EDGE 4
+#else
+#define ENCODER_TICKS_PER_EDGE 1
+#endif
+
+// PCNT settings
+#define ENCODER_PCNT_LIMIT 16384   // Hardware counter folds into the 64-bit total here
+#define ENCODER_FILTER_CYCLES 100  // Glitch filter in APB cycles (80 MHz -> 1.25 us)
+#define ENCODER_FILTER_MAX 1023    // Widest filter the hardware takes
+
+// Velocity estimator
+#define ENCODER_EDGE_HISTORY 16         // Timestamped edges kept for the estimate
+#define ENCODER_VEL_WINDOW_US 2000      // Span averaged over when edges are dense
+#define ENCODER_VEL_TIMEOUT_US 100000   // No edge for this long = standing still
+
+// Consistent view of the encoder, safe to take from any task or core
+typedef struct {
+  int64_t count;      // Ticks since the last encoder_reset()
+  int64_t edge_us;    // esp_timer time of the newest edge, 0 if none yet
+  int8_t direction;   // 1 forward, -1 backward (newest edge), 0 if none yet
+} encoder_snapshot_t;
+
+// Position compare, called from the edge interrupt when the count is at or
+// below low, or at or above high. Counts are encoder_read64() ticks. fn
+// and everything it calls must be IRAM_ATTR and driver-free, like the ISR.
+typedef void (*encoder_compare_fn_t)(int64_t count, int64_t edge_us);
+
+// Edge interrupt: decodes in the ISR backend, only timestamps with PCNT
+void encoderISR();
+
+void encoder_configure(uint8_t pin_a, uint8_t pin_b, uint16_t filter_cycles);
+void encoder_init();
+long encoder_read();
+int64_t encoder_read64();
+void encoder_snapshot(encoder_snapshot_t *snapshot);
+void encoder_reset();
+float encoder_velocity();
+void encoder_set_compare(int64_t low, int64_t high, encoder_compare_fn_t fn);
+void encoder_clear_compare();
+
+#ifdef ENCODER_BACKEND_SIM
+void encoder_sim_step(int8_t step);
+#endif
+
+#endif
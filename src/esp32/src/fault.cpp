@@ -0,0 +1,110 @@
+#include "fault.h"
+#include "speed_control.h"
+
+static fault_config_t config = {
+  FAULT_STALL_DUTY, FAULT_STALL_RATIO, FAULT_STALL_VELOCITY, FAULT_STALL_MS,
+  FAULT_LOSS_VELOCITY, FAULT_LOSS_EDGES,
+  FAULT_MISMATCH_VELOCITY, FAULT_MISMATCH_MS
+};
+static portMUX_TYPE configMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Control task only. 0 = condition not present.
+static int64_t slowSince = 0;
+static int64_t mismatchSince = 0;
+static int64_t lastEdge = 0;
+static float edgeVelocity = 0;   // Estimate when the newest edge came in
+
+void fault_init()
+{
+  fault_reset();
+}
+
+// After a stop, so the next run starts with clean debounce timers
+void fault_reset()
+{
+  slowSince = 0;
+  mismatchSince = 0;
+  edgeVelocity = 0;
+}
+
+static uint8_t report(uint8_t code, int64_t now, int64_t since, float duty,
+                      float velocity, fault_event_t *event)
+{
+  event->code = code;
+  event->duty = duty;
+  event->velocity = velocity;
+  event->duration_ms = (uint32_t)((now - since) / 1000);
+  fault_reset();
+  return code;
+}
+
+// Returns FAULT_NONE or the fault found this tick (event filled in). The
+// caller stops the motor, the detector rearms by itself.
+uint8_t fault_check(int64_t now, const encoder_snapshot_t *enc, float duty,
+                    float velocity, fault_event_t *event)
+{
+  fault_config_t cfg;
+  portENTER_CRITICAL(&configMux);
+  cfg = config;
+  portEXIT_CRITICAL(&configMux);
+
+  if (enc->edge_us != lastEdge) {
+    lastEdge = enc->edge_us;
+    edgeVelocity = velocity;
+  }
+
+  float magnitude = fabsf(duty);
+  if (magnitude < cfg.stall_duty) {
+    fault_reset();
+    return FAULT_NONE;  // Not driven hard enough to judge
+  }
+
+  // Checked first: it also looks like a stall, but is reported for what it is
+  float fast = fabsf(edgeVelocity);
+  if (lastEdge != 0 && fast >= cfg.loss_velocity) {
+    float edgePeriod = ENCODER_TICKS_PER_EDGE * 1e6f / fast;
+    if (now - lastEdge > cfg.loss_edges * edgePeriod) {
+      return report(FAULT_ENCODER_LOSS, now, lastEdge, duty, edgeVelocity, event);
+    }
+  }
+
+  speed_gains_t gains;
+  speed_control_get_gains(&gains);
+  float threshold = cfg.stall_velocity;
+  if (gains.kff > 0 && magnitude / gains.kff * cfg.stall_ratio > threshold) {
+    threshold = magnitude / gains.kff * cfg.stall_ratio;
+  }
+
+  if (fabsf(velocity) >= threshold) {
+    slowSince = 0;
+  } else if (slowSince == 0) {
+    slowSince = now;
+  } else if (now - slowSince >= cfg.stall_ms * 1000LL) {
+    return report(FAULT_STALL, now, slowSince, duty, velocity, event);
+  }
+
+  if (duty * velocity >= 0 || fabsf(velocity) < cfg.mismatch_velocity) {
+    mismatchSince = 0;
+  } else if (mismatchSince == 0) {
+    mismatchSince = now;
+  } else if (now - mismatchSince >= cfg.mismatch_ms * 1000LL) {
+    return report(FAULT_DIRECTION, now, mismatchSince, duty, velocity, event);
+  }
+
+  return FAULT_NONE;
+}
+
+// Called from the comms task while the detector runs on the other core
+void fault_set_config(const fault_config_t *newConfig)
+{
+  portENTER_CRITICAL(&configMux);
+  config = *newConfig;
+  portEXIT_CRITICAL(&configMux);
+}
+
+void fault_get_config(fault_config_t *out)
+{
+  portENTER_CRITICAL(&configMux);
+  *out = config;
+  portEXIT_CRITICAL(&configMux);
+}
@@ -0,0 +1,56 @@
+#ifndef FAULT_H
+#define FAULT_H
+
+#include <Arduino.h>
+#include "encoder.h"
+
+// Drive fault detection, every control tick. Compares the duty written to
+// the motor against what the encoder reports and debounces each check.
+
+// Stall: duty applied but the wheel far slower than that duty should give
+#define FAULT_STALL_DUTY 15.0f       // duty %, below this not moving is fine
+#define FAULT_STALL_RATIO 0.1f       // measured / expected (duty / SPEED_KFF) velocity
+#define FAULT_STALL_VELOCITY 50.0f   // ticks/s, always slower than this counts as not moving
+#define FAULT_STALL_MS 40
+
+// Encoder loss: edges stop dead while the wheel was running fast. A wall
+// stop slows the edges down first; a cut wire goes from full speed to nothing.
+#define FAULT_LOSS_VELOCITY 2000.0f  // ticks/s at the last edge
+#define FAULT_LOSS_EDGES 8           // Expected edge periods without an edge
+
+// Direction mismatch: wheel turning against the duty, e.g. swapped A/B wires
+#define FAULT_MISMATCH_VELOCITY 500.0f  // ticks/s
+#define FAULT_MISMATCH_MS 100
+
+#define FAULT_NONE 0
+#define FAULT_STALL 1
+#define FAULT_ENCODER_LOSS 2
+#define FAULT_DIRECTION 3
+
+typedef struct {
+  float stall_duty;
+  float stall_ratio;
+  float stall_velocity;
+  uint32_t stall_ms;
+  float loss_velocity;
+  uint32_t loss_edges;
+  float mismatch_velocity;
+  uint32_t mismatch_ms;
+} fault_config_t;
+
+typedef struct {
+  uint8_t code;          // FAULT_*
+  float duty;            // At detection, signed %
+  float velocity;        // ticks/s
+  uint32_t duration_ms;  // How long the condition held
+} fault_event_t;
+
+void fault_init();
+void fault_reset();
+uint8_t fault_check(int64_t now_us, const encoder_snapshot_t *enc, float duty,
+                    float velocity, fault_event_t *event);
+
+void fault_set_config(const fault_config_t *config);
+void fault_get_config(fault_config_t *config);
+
+#endif
@@ -0,0 +1,155 @@
+#include "instrument.h"
+#include <atomic>
+
+// One writer per counter: each handler runs on one core, never nested
+// with itself. The sampler diffs running totals, so nothing is reset.
+typedef struct {
+  volatile uint32_t count;
+  volatile uint32_t cycles;
+  volatile uint8_t core;
+} isr_counter_t;
+
+static isr_counter_t isrCounters[ISR_COUNT];
+
+// Sampler state, telemetry task only
+static uint32_t lastCount[ISR_COUNT];
+static uint32_t lastCycles[ISR_COUNT];
+static int64_t windowStart = 0;
+
+#if configGENERATE_RUN_TIME_STATS && configUSE_TRACE_FACILITY
+#define INSTRUMENT_MAX_TASKS 32
+static TaskStatus_t taskStatus[INSTRUMENT_MAX_TASKS];
+static uint32_t lastIdle[2];
+static uint32_t lastTotal = 0;
+#endif
+
+static instrument_report_t report;
+static portMUX_TYPE reportMux = portMUX_INITIALIZER_UNLOCKED;
+static std::atomic<bool> stream(true);
+
+#if INSTRUMENT_ISR
+void IRAM_ATTR instrument_isr(uint8_t id, uint32_t start_cycles)
+{
+  isr_counter_t *c = &isrCounters[id];
+  c->cycles += ESP.getCycleCount() - start_cycles;
+  c->count++;
+  c->core = xPortGetCoreID();
+}
+#endif
+
+// part / whole in 0.01 %, saturating
+static uint16_t share(uint64_t part, uint64_t whole)
+{
+  if (whole == 0) return 0;
+  uint64_t v = part * 10000 / whole;
+  return v > 10000 ? 10000 : (uint16_t)v;
+}
+
+// Idle task run time per core -> busy share. The run time counter is the
+// esp_timer microsecond clock.
+static void sample_cores(instrument_report_t *r)
+{
+#if configGENERATE_RUN_TIME_STATS && configUSE_TRACE_FACILITY
+  uint32_t total = 0;
+  UBaseType_t n = uxTaskGetSystemState(taskStatus, INSTRUMENT_MAX_TASKS, &total);
+  uint32_t span = total - lastTotal;
+  lastTotal = total;
+
+  for (uint8_t core = 0; core < 2; core++) {
+    TaskHandle_t idle = xTaskGetIdleTaskHandleForCPU(core);
+    for (UBaseType_t i = 0; i < n; i++) {
+      if (taskStatus[i].xHandle != idle) continue;
+      uint32_t idleTime = taskStatus[i].ulRunTimeCounter - lastIdle[core];
+      lastIdle[core] = taskStatus[i].ulRunTimeCounter;
+      r->cores[core].load = 10000 - share(idleTime, span);
+    }
+  }
+#else
+  for (uint8_t core = 0; core < 2; core++) {
+    r->cores[core].load = INSTRUMENT_LOAD_UNKNOWN;
+  }
+#endif
+}
+
+void instrument_init()
+{
+  windowStart = esp_timer_get_time();
+  for (uint8_t i = 0; i < ISR_COUNT; i++) {
+    lastCount[i] = isrCounters[i].count;
+    lastCycles[i] = isrCounters[i].cycles;
+  }
+  for (uint8_t i = 0; i < TASK_COUNT; i++) {
+    sched_window_t discard;
+    scheduler_take_window((sched_task_id_t)i, &discard);
+  }
+  instrument_report_t empty = {};
+  sample_cores(&empty);  // Run time baseline
+}
+
+bool instrument_update(int64_t now_us)
+{
+  if (now_us - windowStart < INSTRUMENT_WINDOW_MS * 1000LL) return false;
+
+  instrument_report_t r = {};
+  r.window_us = (uint32_t)(now_us - windowStart);
+  windowStart = now_us;
+  uint64_t windowCycles = (uint64_t)r.window_us * getCpuFreqMHz();
+  uint32_t coreUsed[2] = { 0, 0 };  // 0.01 % accounted for per core
+
+  for (uint8_t i = 0; i < TASK_COUNT; i++) {
+    sched_window_t w;
+    scheduler_take_window((sched_task_id_t)i, &w);
+    task_load_t *t = &r.tasks[i];
+    t->core = scheduler_core((sched_task_id_t)i);
+    t->cpu = share(w.busy_us, r.window_us);
+    t->jitter_us = w.jitter_us > 0xFFFF ? 0xFFFF : w.jitter_us;
+    uint32_t stack = scheduler_stack_free((sched_task_id_t)i);
+    t->stack_free = stack > 0xFFFF ? 0xFFFF : stack;
+    coreUsed[t->core & 1] += t->cpu;
+  }
+
+  for (uint8_t i = 0; i < ISR_COUNT; i++) {
+    uint32_t count = isrCounters[i].count;
+    uint32_t cycles = isrCounters[i].cycles;
+    isr_load_t *l = &r.isrs[i];
+    l->count = count - lastCount[i];
+    l->load = share(cycles - lastCycles[i], windowCycles);
+    l->core = isrCounters[i].core;
+    lastCount[i] = count;
+    lastCycles[i] = cycles;
+    coreUsed[l->core & 1] += l->load;
+  }
+
+  sample_cores(&r);
+  for (uint8_t core = 0; core < 2; core++) {
+    core_load_t *c = &r.cores[core];
+    if (c->load == INSTRUMENT_LOAD_UNKNOWN) {
+      c->other = INSTRUMENT_LOAD_UNKNOWN;
+    } else {
+      c->other = c->load > coreUsed[core] ? c->load - coreUsed[core] : 0;
+    }
+  }
+
+  portENTER_CRITICAL(&reportMux);
+  report = r;
+  portEXIT_CRITICAL(&reportMux);
+  return true;
+}
+
+void instrument_get(instrument_report_t *out)
+{
+  portENTER_CRITICAL(&reportMux);
+  *out = report;
+  portEXIT_CRITICAL(&reportMux);
+}
+
+// Unsolicited LOAD frames after every window
+void instrument_set_stream(bool on)
+{
+  stream.store(on);
+}
+
+bool instrument_get_stream()
+{
+  return stream.load();
+}
@@ -0,0 +1,88 @@
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+#include <Arduino.h>
+#include "scheduler.h"
+
+// Runtime load figures, sampled over fixed windows by the telemetry task:
+// CPU share, period jitter and stack headroom of each scheduler task,
+// count and time of the firmware's own interrupt handlers, and, when
+// FreeRTOS run time stats are compiled in, total load per core (everything
+// else on it: USB CDC, the esp_timer task, ESP32Servo, the GPIO interrupt
+// dispatch). Loads are 0.01 % of one core.
+
+#define INSTRUMENT_WINDOW_MS 1000
+
+// Counted interrupt handlers
+#define ISR_ENCODER_EDGE 0  // encoderISR()
+#define ISR_PCNT_LIMIT 1    // PCNT counter fold (PCNT backend only)
+#define ISR_COUNT 2
+
+// Cycle counter around ISR bodies, a few cycles each. Off in the native
+// build, which has no cycle counter; -DINSTRUMENT_ISR=0 drops it on the
+// board too.
+#ifndef INSTRUMENT_ISR
+#ifdef HAL_SIM
+#define INSTRUMENT_ISR 0
+#else
+#define INSTRUMENT_ISR 1
+#endif
+#endif
+
+#define INSTRUMENT_LOAD_UNKNOWN 0xFFFF  // Core load without run time stats
+
+typedef struct {
+  uint16_t cpu;         // Run time share of its core
+  uint16_t jitter_us;   // Worst start-to-start deviation from the period
+  uint16_t stack_free;  // Bytes never used
+  uint8_t core;
+} task_load_t;
+
+typedef struct {
+  uint32_t count;  // Calls in the window
+  uint16_t load;   // Handler time share of its core
+  uint8_t core;
+} isr_load_t;
+
+typedef struct {
+  uint16_t load;   // Busy share of the core, INSTRUMENT_LOAD_UNKNOWN if not measured
+  uint16_t other;  // Part of load not from the tasks and handlers above
+} core_load_t;
+
+typedef struct {
+  uint32_t window_us;  // Length of the window these figures cover, 0 before the first
+  task_load_t tasks[TASK_COUNT];
+  isr_load_t isrs[ISR_COUNT];
+  core_load_t cores[2];
+} instrument_report_t;
+
+#if INSTRUMENT_ISR
+static inline uint32_t IRAM_ATTR instrument_cycles()
+{
+  return ESP.getCycleCount();
+}
+
+void instrument_isr(uint8_t id, uint32_t start_cycles);
+#else
+static inline uint32_t instrument_cycles()
+{
+  return 0;
+}
+
+static inline void instrument_isr(uint8_t id, uint32_t start_cycles)
+{
+}
+#endif
+
+void instrument_init();
+
+// Telemetry task: closes the window when it is due, returns true if it did
+bool instrument_update(int64_t now_us);
+
+// Latest complete window, from any task
+void instrument_get(instrument_report_t *report);
+
+void instrument_set_stream(bool on);
+bool instrument_get_stream();
+
+#endif
@@ -1,40 +1,643 @@
 #include <Arduino.h>
 #include "motor.h"
 #include "steering.h"
+#include "protocol.h"
+#include "control.h"
+#include "scheduler.h"
+#include "speed_control.h"
+#include "telemetry.h"
+#include "watchdog.h"
+#include "trajectory.h"
+#include "odometry.h"
+#include "motion_profile.h"
+#include "calibration.h"
+#include "move.h"
+#include "fault.h"
+#include "trigger.h"
+#include "instrument.h"
+
+static uint32_t reportedMisses[TASK_COUNT];
+
+static void send_sched_stats(uint8_t seq, sched_task_id_t id)
+{
+  sched_stats_t stats;
+  scheduler_get_stats(id, &stats);
+
+  uint8_t reply[8] = {0};
+  reply[0] = id;
+  uint32_t max_us = stats.max_us > 0xFFFF ? 0xFFFF : stats.max_us;
+  proto_put_i16(reply + 2, (int16_t)max_us);
+  proto_put_i32(reply + 4, (int32_t)stats.misses);
+  protocol_send(MSG_SCHED_STATS, seq, reply, sizeof(reply));
+}
+
+static void send_status(uint8_t seq)
+{
+  uint8_t reply[4];
+  proto_put_i32(reply, encoder_read());
+  protocol_send(MSG_STATUS, seq, reply, sizeof(reply));
+}
+
+static void handle_drive(const proto_frame_t *frame, uint32_t arrival_us)
+{
+  control_command_t cmd;
+  cmd.arrival_us = arrival_us;
+  cmd.mode = CONTROL_MODE_OPEN_LOOP;
+  cmd.speed = proto_get_i16(frame->payload);
+  cmd.steer_cdeg = proto_get_i16(frame->payload + 2);
+  cmd.seq = frame->seq;
+  cmd.trace = (uint16_t)proto_get_i16(frame->payload + 4);
+  control_submit(&cmd);
+  send_status(frame->seq);
+}
+
+static void handle_velocity(const proto_frame_t *frame, uint32_t arrival_us)
+{
+  control_command_t cmd;
+  cmd.arrival_us = arrival_us;
+  cmd.mode = CONTROL_MODE_VELOCITY;
+  cmd.speed = proto_get_i32(frame->payload);
+  cmd.steer_cdeg = proto_get_i16(frame->payload + 4);
+  cmd.seq = frame->seq;
+  cmd.trace = (uint16_t)proto_get_i16(frame->payload + 6);
+  control_submit(&cmd);
+  send_status(frame->seq);
+}
+
+static void handle_move(const proto_frame_t *frame, uint32_t arrival_us)
+{
+  control_command_t cmd;
+  cmd.arrival_us = arrival_us;
+  cmd.mode = CONTROL_MODE_MOVE;
+  cmd.distance = proto_get_i32(frame->payload);
+  cmd.speed = (uint16_t)proto_get_i16(frame->payload + 4);
+  cmd.steer_cdeg = proto_get_i16(frame->payload + 6);
+  cmd.seq = frame->seq;
+  cmd.trace = 0;
+  control_submit(&cmd);
+  send_status(frame->seq);
+}
+
+static void send_move_done(const move_event_t *event)
+{
+  uint8_t reply[8] = {0};
+  reply[0] = event->result;
+  proto_put_i32(reply + 4, event->error);
+  protocol_send(MSG_MOVE_DONE, event->seq, reply, sizeof(reply));
+}
+
+static void send_trace(const control_trace_t *trace)
+{
+  uint32_t apply_us = trace->applied_us - trace->arrival_us;
+  uint32_t held_us = (uint32_t)esp_timer_get_time() - trace->applied_us;
+  uint8_t reply[8] = {0};
+  proto_put_i16(reply, (int16_t)trace->trace);
+  proto_put_i16(reply + 2, (int16_t)(apply_us > 0xFFFF ? 0xFFFF : apply_us));
+  proto_put_i16(reply + 4, (int16_t)(held_us > 0xFFFF ? 0xFFFF : held_us));
+  reply[6] = trace->flags;
+  protocol_send(MSG_TRACE, trace->seq, reply, sizeof(reply));
+}
+
+static void send_trigger_status(uint8_t seq, bool accepted)
+{
+  uint8_t reply[2];
+  reply[0] = accepted;
+  reply[1] = trigger_armed();
+  protocol_send(MSG_TRIGGER_STATUS, seq, reply, sizeof(reply));
+}
+
+static void handle_trigger_set(const proto_frame_t *frame)
+{
+  const uint8_t *p = frame->payload;
+  bool ok = trigger_set(frame->seq, p[0], proto_get_i32(p + 2), p[1], proto_get_i16(p + 6));
+  send_trigger_status(frame->seq, ok);
+}
+
+static void handle_trigger_ctrl(const proto_frame_t *frame)
+{
+  bool ok = true;
+  switch (frame->payload[0])
+  {
+    case TRIGGER_OP_QUERY: break;
+    case TRIGGER_OP_CLEAR: ok = trigger_clear(frame->payload[1]); break;
+    case TRIGGER_OP_CLEAR_ALL: trigger_clear_all(); break;
+    default: ok = false; break;
+  }
+  send_trigger_status(frame->seq, ok);
+}
+
+static void send_trigger_fired(const trigger_event_t *event)
+{
+  uint8_t reply[8];
+  reply[0] = event->id;
+  reply[1] = event->action;
+  uint32_t delay_us = event->delay_us > 0xFFFF ? 0xFFFF : event->delay_us;
+  proto_put_i16(reply + 2, (int16_t)delay_us);
+  proto_put_i32(reply + 4, event->count);
+  protocol_send(MSG_TRIGGER_FIRED, event->seq, reply, sizeof(reply));
+}
+
+static bool profile_param_get(uint8_t id, float *value)
+{
+  profile_config_t cfg;
+  motion_profile_get_config(&cfg);
+
+  switch (id)
+  {
+    case PARAM_DUTY_ACCEL: *value = cfg.duty.accel; return true;
+    case PARAM_DUTY_DECEL: *value = cfg.duty.decel; return true;
+    case PARAM_DUTY_JERK: *value = cfg.duty.jerk; return true;
+    case PARAM_VEL_ACCEL: *value = cfg.velocity.accel; return true;
+    case PARAM_VEL_DECEL: *value = cfg.velocity.decel; return true;
+    case PARAM_VEL_JERK: *value = cfg.velocity.jerk; return true;
+    case PARAM_BRAKE_VELOCITY: *value = cfg.brake_velocity; return true;
+    case PARAM_BRAKE_TIMEOUT_MS: *value = cfg.brake_timeout_ms; return true;
+    default: return false;
+  }
+}
+
+static bool profile_param_set(uint8_t id, float value)
+{
+  profile_config_t cfg;
+  motion_profile_get_config(&cfg);
+
+  if (value < 0) return false;
+  switch (id)
+  {
+    case PARAM_DUTY_ACCEL: cfg.duty.accel = value; break;
+    case PARAM_DUTY_DECEL: cfg.duty.decel = value; break;
+    case PARAM_DUTY_JERK: cfg.duty.jerk = value; break;
+    case PARAM_VEL_ACCEL: cfg.velocity.accel = value; break;
+    case PARAM_VEL_DECEL: cfg.velocity.decel = value; break;
+    case PARAM_VEL_JERK: cfg.velocity.jerk = value; break;
+    case PARAM_BRAKE_VELOCITY: cfg.brake_velocity = value; break;
+    case PARAM_BRAKE_TIMEOUT_MS: cfg.brake_timeout_ms = (uint32_t)value; break;
+    default: return false;
+  }
+  motion_profile_set_config(&cfg);
+  return true;
+}
+
+static bool calibration_param_get(uint8_t id, float *value)
+{
+  const calibration_t *cal = calibration_get();
+  steering_cal_t steer;
+  steering_get_cal(&steer);
+
+  switch (id)
+  {
+    case PARAM_STEER_CENTER: *value = steer.center; return true;
+    case PARAM_STEER_LEFT: *value = steer.left; return true;
+    case PARAM_STEER_RIGHT: *value = steer.right; return true;
+    case PARAM_STEER_PULSE_MIN: *value = steer.pulse_min_us; return true;
+    case PARAM_STEER_PULSE_MAX: *value = steer.pulse_max_us; return true;
+    case PARAM_ENCODER_PIN_A: *value = cal->encoder_a; return true;
+    case PARAM_ENCODER_PIN_B: *value = cal->encoder_b; return true;
+    case PARAM_ENCODER_FILTER: *value = cal->encoder_filter; return true;
+    case PARAM_RACE_MODE: *value = cal->race_mode; return true;
+    default: return false;
+  }
+}
+
+static bool calibration_param_set(uint8_t id, float value)
+{
+  calibration_t *cal = calibration_get();
+  steering_cal_t steer;
+  steering_get_cal(&steer);
+
+  if (value < 0) return false;
+  switch (id)
+  {
+    case PARAM_STEER_CENTER: steer.center = (int16_t)value; break;
+    case PARAM_STEER_LEFT: steer.left = (int16_t)value; break;
+    case PARAM_STEER_RIGHT: steer.right = (int16_t)value; break;
+    case PARAM_STEER_PULSE_MIN: steer.pulse_min_us = (uint16_t)value; break;
+    case PARAM_STEER_PULSE_MAX: steer.pulse_max_us = (uint16_t)value; break;
+    case PARAM_ENCODER_PIN_A: cal->encoder_a = (uint8_t)value; return true;
+    case PARAM_ENCODER_PIN_B: cal->encoder_b = (uint8_t)value; return true;
+    case PARAM_ENCODER_FILTER:
+      if (value > ENCODER_FILTER_MAX) return false;
+      cal->encoder_filter = (uint16_t)value;
+      return true;
+    case PARAM_RACE_MODE: cal->race_mode = value != 0; return true;
+    default: return false;
+  }
+  return steering_set_cal(&steer);
+}
+
+static bool move_param_get(uint8_t id, float *value)
+{
+  move_config_t cfg;
+  move_get_config(&cfg);
+
+  switch (id)
+  {
+    case PARAM_MOVE_DECEL: *value = cfg.decel; return true;
+    case PARAM_MOVE_MIN_SPEED: *value = cfg.min_speed; return true;
+    default: return false;
+  }
+}
+
+static bool move_param_set(uint8_t id, float value)
+{
+  move_config_t cfg;
+  move_get_config(&cfg);
+
+  switch (id)
+  {
+    case PARAM_MOVE_DECEL:
+      if (value <= 0) return false;
+      cfg.decel = value;
+      break;
+    case PARAM_MOVE_MIN_SPEED:
+      if (value < 0) return false;
+      cfg.min_speed = value;
+      break;
+    default:
+      return false;
+  }
+  move_set_config(&cfg);
+  return true;
+}
+
+static bool fault_param_get(uint8_t id, float *value)
+{
+  fault_config_t cfg;
+  fault_get_config(&cfg);
+
+  switch (id)
+  {
+    case PARAM_FAULT_STALL_DUTY: *value = cfg.stall_duty; return true;
+    case PARAM_FAULT_STALL_RATIO: *value = cfg.stall_ratio; return true;
+    case PARAM_FAULT_STALL_VELOCITY: *value = cfg.stall_velocity; return true;
+    case PARAM_FAULT_STALL_MS: *value = cfg.stall_ms; return true;
+    case PARAM_FAULT_LOSS_VELOCITY: *value = cfg.loss_velocity; return true;
+    case PARAM_FAULT_LOSS_EDGES: *value = cfg.loss_edges; return true;
+    case PARAM_FAULT_MISMATCH_VELOCITY: *value = cfg.mismatch_velocity; return true;
+    case PARAM_FAULT_MISMATCH_MS: *value = cfg.mismatch_ms; return true;
+    default: return false;
+  }
+}
+
+static bool fault_param_set(uint8_t id, float value)
+{
+  fault_config_t cfg;
+  fault_get_config(&cfg);
+
+  if (value < 0) return false;
+  switch (id)
+  {
+    case PARAM_FAULT_STALL_DUTY: cfg.stall_duty = value; break;
+    case PARAM_FAULT_STALL_RATIO: cfg.stall_ratio = value; break;
+    case PARAM_FAULT_STALL_VELOCITY: cfg.stall_velocity = value; break;
+    case PARAM_FAULT_STALL_MS: cfg.stall_ms = (uint32_t)value; break;
+    case PARAM_FAULT_LOSS_VELOCITY: cfg.loss_velocity = value; break;
+    case PARAM_FAULT_LOSS_EDGES: cfg.loss_edges = (uint32_t)value; break;
+    case PARAM_FAULT_MISMATCH_VELOCITY: cfg.mismatch_velocity = value; break;
+    case PARAM_FAULT_MISMATCH_MS: cfg.mismatch_ms = (uint32_t)value; break;
+    default: return false;
+  }
+  fault_set_config(&cfg);
+  return true;
+}
+
+static bool param_get(uint8_t id, float *value)
+{
+  speed_gains_t gains;
+  speed_control_get_gains(&gains);
+
+  switch (id)
+  {
+    case PARAM_SPEED_KP: *value = gains.kp; return true;
+    case PARAM_SPEED_KI: *value = gains.ki; return true;
+    case PARAM_SPEED_KD: *value = gains.kd; return true;
+    case PARAM_SPEED_KFF: *value = gains.kff; return true;
+    case PARAM_WATCHDOG_MS: *value = watchdog_get_deadline_ms(); return true;
+    case PARAM_MOTOR_PWM_HZ: *value = motor_get_pwm_freq(); return true;
+    case PARAM_MOTOR_DECAY: *value = motor_get_decay(); return true;
+    case PARAM_LOAD_STREAM: *value = instrument_get_stream(); return true;
+    default:
+      return profile_param_get(id, value) || move_param_get(id, value) ||
+             fault_param_get(id, value) || calibration_param_get(id, value);
+  }
+}
+
+static bool param_set(uint8_t id, float value)
+{
+  speed_gains_t gains;
+  speed_control_get_gains(&gains);
+
+  switch (id)
+  {
+    case PARAM_SPEED_KP: gains.kp = value; break;
+    case PARAM_SPEED_KI: gains.ki = value; break;
+    case PARAM_SPEED_KD: gains.kd = value; break;
+    case PARAM_SPEED_KFF: gains.kff = value; break;
+    case PARAM_WATCHDOG_MS:
+      if (value < 1) return false;
+      watchdog_set_deadline_ms((uint32_t)value);
+      return true;
+    case PARAM_MOTOR_PWM_HZ:
+      return motor_set_pwm((uint32_t)value, motor_get_decay());
+    case PARAM_MOTOR_DECAY:
+      return motor_set_pwm(motor_get_pwm_freq(), (uint8_t)value);
+    case PARAM_LOAD_STREAM:
+      instrument_set_stream(value != 0);
+      return true;
+    default:
+      return profile_param_set(id, value) || move_param_set(id, value) ||
+             fault_param_set(id, value) || calibration_param_set(id, value);
+  }
+  speed_control_set_gains(&gains);
+  return true;
+}
+
+static void handle_param(const proto_frame_t *frame)
+{
+  uint8_t id = frame->payload[0];
+  if (frame->type == MSG_SET_PARAM) {
+    param_set(id, proto_get_f32(frame->payload + 4));
+  }
+
+  float value;
+  if (!param_get(id, &value)) return;
+
+  uint8_t reply[8] = {0};
+  reply[0] = id;
+  proto_put_f32(reply + 4, value);
+  protocol_send(MSG_PARAM, frame->seq, reply, sizeof(reply));
+}
+
+// Answers with one MSG_HIST frame per bin, optionally clearing afterwards
+static void handle_get_hist(const proto_frame_t *frame)
+{
+  uint8_t hist = frame->payload[0];
+  if (hist >= HIST_COUNT) return;
+
+  for (uint8_t bin = 0; bin < WATCHDOG_HIST_BINS; bin++) {
+    uint8_t reply[8] = {0};
+    reply[0] = hist;
+    reply[1] = bin;
+    proto_put_i32(reply + 4, (int32_t)watchdog_hist_bin(hist, bin));
+    protocol_send(MSG_HIST, frame->seq, reply, sizeof(reply));
+  }
+
+  if (frame->payload[1]) {
+    watchdog_hist_clear();
+  }
+}
+
+// One MSG_LOAD frame per task, handler and core, from the latest window
+static void send_load(uint8_t seq)
+{
+  instrument_report_t r;
+  instrument_get(&r);
+  if (r.window_us == 0) return;  // First window still running
+
+  for (uint8_t i = 0; i < TASK_COUNT; i++) {
+    uint8_t reply[8];
+    reply[0] = LOAD_KIND_TASK;
+    reply[1] = i;
+    proto_put_i16(reply + 2, (int16_t)r.tasks[i].cpu);
+    proto_put_i16(reply + 4, (int16_t)r.tasks[i].jitter_us);
+    proto_put_i16(reply + 6, (int16_t)r.tasks[i].stack_free);
+    protocol_send(MSG_LOAD, seq, reply, sizeof(reply));
+  }
+  for (uint8_t i = 0; i < ISR_COUNT; i++) {
+    uint8_t reply[8];
+    reply[0] = LOAD_KIND_ISR;
+    reply[1] = i;
+    proto_put_i16(reply + 2, (int16_t)r.isrs[i].load);
+    proto_put_i32(reply + 4, (int32_t)r.isrs[i].count);
+    protocol_send(MSG_LOAD, seq, reply, sizeof(reply));
+  }
+  for (uint8_t i = 0; i < 2; i++) {
+    uint8_t reply[8] = {0};
+    reply[0] = LOAD_KIND_CORE;
+    reply[1] = i;
+    proto_put_i16(reply + 2, (int16_t)r.cores[i].load);
+    proto_put_i16(reply + 4, (int16_t)r.cores[i].other);
+    protocol_send(MSG_LOAD, seq, reply, sizeof(reply));
+  }
+}
+
+static void send_traj_status(uint8_t seq, bool accepted)
+{
+  uint16_t queued = trajectory_queued();
+  uint8_t reply[6];
+  reply[0] = accepted;
+  reply[1] = trajectory_active();
+  proto_put_i16(reply + 2, (int16_t)queued);
+  proto_put_i16(reply + 4, (int16_t)(TRAJ_CAPACITY - queued));
+  protocol_send(MSG_TRAJ_STATUS, seq, reply, sizeof(reply));
+}
+
+static void handle_traj_point(const proto_frame_t *frame)
+{
+  traj_point_t point;
+  point.key = proto_get_i32(frame->payload);
+  point.speed = proto_get_i16(frame->payload + 4);
+  point.steer_cdeg = proto_get_i16(frame->payload + 6);
+  send_traj_status(frame->seq, trajectory_push(&point));
+}
+
+static void handle_traj_ctrl(const proto_frame_t *frame)
+{
+  bool ok = true;
+  switch (frame->payload[0])
+  {
+    case TRAJ_OP_START:
+      if (frame->payload[1] > TRAJ_BY_DISTANCE || frame->payload[2] > CONTROL_MODE_VELOCITY) {
+        ok = false;
+        break;
+      }
+      trajectory_start(frame->payload[1], frame->payload[2]);
+      break;
+    case TRAJ_OP_STOP:
+      trajectory_stop();
+      break;
+    case TRAJ_OP_CLEAR:
+      trajectory_clear();
+      break;
+    case TRAJ_OP_QUERY:
+      break;
+    default:
+      ok = false;
+      break;
+  }
+  send_traj_status(frame->seq, ok);
+}
+
+static void handle_calibration(const proto_frame_t *frame)
+{
+  uint8_t op = frame->payload[0];
+  bool ok = true;
+  switch (op)
+  {
+    case CAL_OP_QUERY: break;
+    case CAL_OP_SAVE: ok = calibration_save(); break;
+    case CAL_OP_RELOAD: ok = calibration_reload(); break;
+    case CAL_OP_DEFAULTS: calibration_defaults(); break;
+    default: ok = false; break;
+  }
+
+  uint8_t reply[8] = {0};
+  reply[0] = op;
+  reply[1] = ok;
+  reply[2] = calibration_source();
+  proto_put_i16(reply + 4, CALIBRATION_VERSION);
+  proto_put_i16(reply + 6, sizeof(calibration_t));
+  protocol_send(MSG_CAL_STATUS, frame->seq, reply, sizeof(reply));
+}
+
+static void handle_frame(const proto_frame_t *frame)
+{
+  uint32_t arrival_us = (uint32_t)esp_timer_get_time();
+
+  switch (frame->type)
+  {
+    case MSG_DRIVE:
+      watchdog_feed(arrival_us);
+      handle_drive(frame, arrival_us);
+      break;
+    case MSG_VELOCITY:
+      watchdog_feed(arrival_us);
+      handle_velocity(frame, arrival_us);
+      break;
+    case MSG_TRAJ_POINT:
+      watchdog_feed(arrival_us);
+      handle_traj_point(frame);
+      break;
+    case MSG_TRAJ_CTRL:
+      watchdog_feed(arrival_us);
+      handle_traj_ctrl(frame);
+      break;
+    case MSG_ODOM_RESET:
+      odometry_reset();
+      send_status(frame->seq);
+      break;
+    case MSG_CALIBRATION:
+      handle_calibration(frame);
+      break;
+    case MSG_MOVE:
+      watchdog_feed(arrival_us);
+      handle_move(frame, arrival_us);
+      break;
+    case MSG_TRIGGER_SET:
+      handle_trigger_set(frame);
+      break;
+    case MSG_TRIGGER_CTRL:
+      handle_trigger_ctrl(frame);
+      break;
+    case MSG_GET_HIST:
+      handle_get_hist(frame);
+      break;
+    case MSG_SET_PARAM:
+    case MSG_GET_PARAM:
+      handle_param(frame);
+      break;
+    case MSG_GET_LOAD:
+      send_load(frame->seq);
+      break;
+    case MSG_GET_SCHED:
+      for (int i = 0; i < TASK_COUNT; i++) {
+        send_sched_stats(frame->seq, (sched_task_id_t)i);
+      }
+      break;
+    default:
+      break;  // Unknown message, ignore
+  }
+}
+
+// Comms task: drain every frame already sitting in the RX buffer
+static void comms_update()
+{
+  proto_frame_t frame;
+  while (protocol_poll(&frame)) {
+    handle_frame(&frame);
+  }
+
+  move_event_t event;
+  while (move_poll_event(&event)) {
+    send_move_done(&event);
+  }
+
+  trigger_event_t fired;
+  while (trigger_poll_event(&fired)) {
+    send_trigger_fired(&fired);
+  }
+
+  control_trace_t trace;
+  while (control_poll_trace(&trace)) {
+    send_trace(&trace);
+  }
+}
+
+// Telemetry task: low priority reporting that must never delay control
+static void telemetry_update()
+{
+  telemetry_drain();
+
+  if (instrument_update(esp_timer_get_time()) && instrument_get_stream()) {
+    send_load(0);
+  }
+
+  // Push scheduler stats whenever a task missed a deadline
+  for (int i = 0; i < TASK_COUNT; i++) {
+    sched_stats_t stats;
+    scheduler_get_stats((sched_task_id_t)i, &stats);
+    if (stats.misses != reportedMisses[i]) {
+      reportedMisses[i] = stats.misses;
+      send_sched_stats(0, (sched_task_id_t)i);
+    }
+  }
+}
 
 void setup()
 {
   Serial.begin(115200);
 
-  // Wait for serial connection
-  unsigned long startWait = millis();
-  while (!Serial && (millis() - startWait < 3000)) {
-    delay(100);
-  }
+  // Tunables first, they decide how the rest boots
+  calibration_init();
+  bool race = calibration_get()->race_mode;
 
-  Serial.println("ESP32-S3 Robot Controller Starting...");
+  // Wait for serial connection. Race mode starts straight away, the Pi
+  // opens the port whenever it is ready and nobody reads the boot log.
+  if (!race) {
+    unsigned long startWait = millis();
+    while (!Serial && (millis() - startWait < 3000)) {
+      delay(100);
+    }
+    Serial.println("ESP32-S3 Robot Controller Starting...");
+    Serial.println("Initializing motor...");
+  }
 
   // Initialize motor
-  Serial.println("Initializing motor...");
   motor_init();
 
   // Initialize steering servo
-  Serial.println("Initializing steering servo...");
-  steering_init();
+  if (!race) Serial.println("Initializing steering servo...");
+  steering_init(!race);
+
+  protocol_init();
+  telemetry_init();
+  watchdog_init();
+  control_init();
 
-  Serial.println("Setup complete. Waiting for commands from Raspberry Pi...");
+  scheduler_add(TASK_CONTROL, "control", control_update,
+                CONTROL_RATE_HZ, CONTROL_CORE, CONTROL_PRIORITY, 4096);
+  scheduler_add(TASK_COMMS, "comms", comms_update,
+                COMMS_RATE_HZ, COMMS_CORE, COMMS_PRIORITY, 4096);
+  scheduler_add(TASK_TELEMETRY, "telemetry", telemetry_update,
+                TELEMETRY_RATE_HZ, TELEMETRY_CORE, TELEMETRY_PRIORITY, 4096);
+  instrument_init();
+  scheduler_start();
+
+  if (!race) Serial.println("Setup complete. Waiting for commands from Raspberry Pi...");
 }
 
 void loop()
 {
-  // TODO: Implement communication protocol with Raspberry Pi
-  // TODO: Implement watchdog - stop motors if no command received
-
-  // Check for motor stall
-  if (check_stall()) {
-    Serial.println("STALL DETECTED - stopping motor!");
-    motor_stop();
-  }
-
-  delay(10);
+  // All work runs in scheduler tasks, the Arduino loop task is not needed
+  vTaskDelete(NULL);
 }
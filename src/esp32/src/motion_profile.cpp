@@ -0,0 +1,111 @@
+#include "motion_profile.h"
+#include "control.h"
+
+static profile_config_t config = {
+  { PROFILE_DUTY_ACCEL, PROFILE_DUTY_DECEL, PROFILE_DUTY_JERK },
+  { PROFILE_VEL_ACCEL, PROFILE_VEL_DECEL, PROFILE_VEL_JERK },
+  PROFILE_BRAKE_VELOCITY,
+  PROFILE_BRAKE_TIMEOUT_MS
+};
+static portMUX_TYPE configMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Profile state, control task only
+static uint8_t mode = CONTROL_MODE_OPEN_LOOP;
+static float value = 0;       // Shaped setpoint
+static float rate = 0;        // Its rate of change (per s)
+static float brakeTime = 0;   // s spent braking for the current reversal
+static bool braking = false;
+
+void motion_profile_init()
+{
+  motion_profile_reset(CONTROL_MODE_OPEN_LOOP, 0);
+}
+
+// Restart from value, e.g. the current duty or measured velocity on a
+// mode switch, or zero after a failsafe stop
+void motion_profile_reset(uint8_t newMode, float newValue)
+{
+  mode = newMode;
+  value = newValue;
+  rate = 0;
+  brakeTime = 0;
+  braking = false;
+}
+
+// One step towards target. velocity is the measured wheel speed in
+// ticks/s, used to hold off a reversal until the wheel has slowed down.
+float motion_profile_step(float target, float velocity, float dt)
+{
+  profile_config_t cfg;
+  portENTER_CRITICAL(&configMux);
+  cfg = config;
+  portEXIT_CRITICAL(&configMux);
+  const profile_limits_t *lim = mode == CONTROL_MODE_VELOCITY ? &cfg.velocity : &cfg.duty;
+
+  // A sign change always goes through zero first
+  float goal = value * target < 0 ? 0 : target;
+
+  // At zero, about to drive against a wheel still turning the other way
+  bool reversing = value == 0 && velocity * target < 0 && fabsf(velocity) > cfg.brake_velocity;
+  if (!reversing) brakeTime = 0;
+  braking = reversing && brakeTime < cfg.brake_timeout_ms * 1e-3f;
+  if (braking) {
+    brakeTime += dt;
+    rate = 0;
+    return 0;
+  }
+
+  float error = goal - value;
+  if (error == 0) {
+    rate = 0;
+    return value;
+  }
+
+  bool speedingUp = fabsf(goal) > fabsf(value);
+  float limit = speedingUp ? lim->accel : lim->decel;
+  if (limit <= 0) {
+    value = goal;
+    rate = 0;
+    return value;
+  }
+
+  float want = error > 0 ? limit : -limit;
+  if (lim->jerk > 0) {
+    // Fastest rate that the jerk limit can still bring to zero at the goal
+    float ease = sqrtf(2 * lim->jerk * fabsf(error));
+    if (fabsf(want) > ease) want = error > 0 ? ease : -ease;
+    float step = lim->jerk * dt;
+    rate += constrain(want - rate, -step, step);
+  } else {
+    rate = want;
+  }
+
+  float next = value + rate * dt;
+  if ((goal - next) * error <= 0) {
+    next = goal;  // Would pass the goal this tick
+    rate = 0;
+  }
+  value = next;
+  return value;
+}
+
+// True while the last step held the drive off for a reversal
+bool motion_profile_braking()
+{
+  return braking;
+}
+
+// Called from the comms task while the profile runs on the other core
+void motion_profile_set_config(const profile_config_t *newConfig)
+{
+  portENTER_CRITICAL(&configMux);
+  config = *newConfig;
+  portEXIT_CRITICAL(&configMux);
+}
+
+void motion_profile_get_config(profile_config_t *out)
+{
+  portENTER_CRITICAL(&configMux);
+  *out = config;
+  portEXIT_CRITICAL(&configMux);
+}
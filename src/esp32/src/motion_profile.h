@@ -0,0 +1,48 @@
+#ifndef MOTION_PROFILE_H
+#define MOTION_PROFILE_H
+
+#include <Arduino.h>
+
+// Setpoint shaping between the commanded speed and the motor. Each
+// control tick moves the setpoint towards the command within the
+// acceleration limit of the active mode. With a jerk limit the rate itself
+// ramps too (S-curve), without one the ramp is trapezoidal. A limit of 0
+// turns that part off.
+
+// Open loop, in duty % (0 -> 100 % in 250 ms)
+#define PROFILE_DUTY_ACCEL 400.0f   // duty %/s while speeding up
+#define PROFILE_DUTY_DECEL 800.0f   // duty %/s while slowing down
+#define PROFILE_DUTY_JERK 0.0f      // duty %/s^2
+
+// Velocity mode, in encoder ticks (20000 ticks/s ~ 1 m/s)
+#define PROFILE_VEL_ACCEL 60000.0f  // ticks/s^2 while speeding up
+#define PROFILE_VEL_DECEL 100000.0f // ticks/s^2 while slowing down
+#define PROFILE_VEL_JERK 0.0f       // ticks/s^3
+
+// Direction reversal: once the setpoint is down to zero the drive stays
+// off until the wheel is slower than this, or the timeout runs out
+#define PROFILE_BRAKE_VELOCITY 200.0f  // ticks/s
+#define PROFILE_BRAKE_TIMEOUT_MS 300
+
+typedef struct {
+  float accel;
+  float decel;
+  float jerk;
+} profile_limits_t;
+
+typedef struct {
+  profile_limits_t duty;
+  profile_limits_t velocity;
+  float brake_velocity;
+  uint32_t brake_timeout_ms;
+} profile_config_t;
+
+void motion_profile_init();
+void motion_profile_reset(uint8_t mode, float value);
+float motion_profile_step(float target, float velocity, float dt);
+bool motion_profile_braking();
+
+void motion_profile_set_config(const profile_config_t *config);
+void motion_profile_get_config(profile_config_t *config);
+
+#endif
@@ -1,88 +1,143 @@
 #include "motor.h"
-#include "driver/mcpwm.h"
+#include <atomic>
 
-// Encoder variables
-volatile long encoderCount = 0;
-volatile int lastEncoded = 0;
-static long lastEncoderCheck = 0;
-static unsigned long lastCheckTime = 0;
+#ifdef MOTOR_BACKEND_MCPWM
+#include "driver/mcpwm.h"
+#else
+#include "sim/plant.h"
+#endif
 
 // Motor state
-bool motorRunning = false;
+static std::atomic<bool> motorRunning(false);  // Read from other tasks
+static float currentDuty = 0;  // Signed percent, as last written
+
+// PWM setup. Requested from any task, applied by the next motor write so
+// the timer is only ever touched from the task driving the motor.
+static std::atomic<uint32_t> pwmFreq(MOTOR_PWM_FREQ_HZ);
+static std::atomic<uint8_t> pwmDecay(MOTOR_DECAY);
+static std::atomic<bool> pwmPending(false);
+static uint32_t periodTicks = 0;
+static uint8_t decay = MOTOR_DECAY;
+
+// Timer clock as fast as the 16-bit period allows, so duty steps are as
+// fine as the hardware can make them at this frequency
+static uint32_t timer_resolution(uint32_t freq)
+{
+  uint32_t prescale = (MOTOR_PWM_GROUP_HZ + (uint64_t)freq * MOTOR_PWM_MAX_PERIOD - 1) /
+                      ((uint64_t)freq * MOTOR_PWM_MAX_PERIOD);
+  if (prescale < 1) prescale = 1;
+  return MOTOR_PWM_GROUP_HZ / prescale;
+}
+
+#ifdef MOTOR_BACKEND_MCPWM
 
-// Encoder interrupt handler
-void IRAM_ATTR encoderISR()
+// Returns timer ticks per period
+static uint32_t backend_setup(uint32_t freq)
 {
-  int MSB = digitalRead(ENCODER_A);
-  int LSB = digitalRead(ENCODER_B);
-  int encoded = (MSB << 1) | LSB;
-  int sum = (lastEncoded << 2) | encoded;
+  uint32_t resolution = timer_resolution(freq);
+
+  mcpwm_group_set_resolution(MCPWM_UNIT_0, MOTOR_PWM_GROUP_HZ);
+  mcpwm_timer_set_resolution(MCPWM_UNIT_0, MCPWM_TIMER_0, resolution);
 
-  if (sum == 0b1101 || sum == 0b0100 || sum == 0b0010 || sum == 0b1011) encoderCount++;
-  if (sum == 0b1110 || sum == 0b0111 || sum == 0b0001 || sum == 0b1000) encoderCount--;
+  mcpwm_config_t pwm_config;
+  pwm_config.frequency = freq;
+  pwm_config.cmpr_a = 0;
+  pwm_config.cmpr_b = 0;
+  pwm_config.counter_mode = MCPWM_UP_COUNTER;
+  pwm_config.duty_mode = MCPWM_DUTY_MODE_0;
+  mcpwm_init(MCPWM_UNIT_0, MCPWM_TIMER_0, &pwm_config);
 
-  lastEncoded = encoded;
+  return resolution / freq;
 }
 
-void encoder_init()
+static void backend_init()
 {
-  pinMode(ENCODER_A, INPUT_PULLUP);
-  pinMode(ENCODER_B, INPUT_PULLUP);
-  attachInterrupt(digitalPinToInterrupt(ENCODER_A), encoderISR, CHANGE);
-  attachInterrupt(digitalPinToInterrupt(ENCODER_B), encoderISR, CHANGE);
+  // First set pins to LOW to prevent motor from running during init
+  pinMode(MOTOR_EN, OUTPUT);
+  pinMode(MOTOR_PN, OUTPUT);
+  digitalWrite(MOTOR_EN, LOW);
+  digitalWrite(MOTOR_PN, LOW);
+
+  mcpwm_gpio_init(MCPWM_UNIT_0, MCPWM0A, MOTOR_EN);
+  mcpwm_gpio_init(MCPWM_UNIT_0, MCPWM0B, MOTOR_PN);
 }
 
-long encoder_read()
+// Slow decay: direction on GEN_B, PWM duty (percent) on GEN_A. Fast decay:
+// GEN_A held high and GEN_B switches direction every cycle, its duty
+// setting the average (50 % = standstill).
+static void backend_drive(bool reverse, float duty, uint8_t decayMode)
 {
-  return encoderCount;
+  if (decayMode == MOTOR_DECAY_FAST) {
+    float high = reverse ? 50 + duty / 2 : 50 - duty / 2;  // GEN_B high = reverse
+    mcpwm_set_signal_high(MCPWM_UNIT_0, MCPWM_TIMER_0, MCPWM_GEN_A);
+    mcpwm_set_duty_type(MCPWM_UNIT_0, MCPWM_TIMER_0, MCPWM_GEN_B, MCPWM_DUTY_MODE_0);
+    mcpwm_set_duty(MCPWM_UNIT_0, MCPWM_TIMER_0, MCPWM_GEN_B, high);
+    return;
+  }
+
+  if (reverse) {
+    mcpwm_set_signal_high(MCPWM_UNIT_0, MCPWM_TIMER_0, MCPWM_GEN_B);  // Swapped
+  } else {
+    mcpwm_set_signal_low(MCPWM_UNIT_0, MCPWM_TIMER_0, MCPWM_GEN_B);  // Swapped
+  }
+  mcpwm_set_duty_type(MCPWM_UNIT_0, MCPWM_TIMER_0, MCPWM_GEN_A, MCPWM_DUTY_MODE_0);
+  mcpwm_set_duty(MCPWM_UNIT_0, MCPWM_TIMER_0, MCPWM_GEN_A, duty);
 }
 
-void encoder_reset()
+static void backend_stop()
 {
-  encoderCount = 0;
+  mcpwm_set_signal_low(MCPWM_UNIT_0, MCPWM_TIMER_0, MCPWM_GEN_A);
+  mcpwm_set_signal_low(MCPWM_UNIT_0, MCPWM_TIMER_0, MCPWM_GEN_B);
 }
 
-bool check_stall()
-{
-  if (!motorRunning) {
-    return false;  // Motor not running, no stall possible
-  }
+#else  // MOTOR_BACKEND_SIM
 
-  if (millis() - lastCheckTime < 200) {
-    return false;  // Check every 200ms
-  }
+// Same period as the hardware, so duty resolution matches
+static uint32_t backend_setup(uint32_t freq)
+{
+  return timer_resolution(freq) / freq;
+}
 
-  lastCheckTime = millis();
-  long currentCount = encoderCount;
+static void backend_init()
+{
+}
 
-  if (currentCount == lastEncoderCheck) {
-    // Motor should be moving but encoder shows no change
-    lastEncoderCheck = currentCount;
-    return true;  // Stall detected
-  }
+// Duty quantized to timer ticks like the real compare register
+static void backend_drive(bool reverse, float duty, uint8_t decayMode)
+{
+  float ticks = roundf(duty * periodTicks / 100);
+  float applied = ticks * 100 / periodTicks;
+  plant_set_motor(reverse ? -applied : applied, decayMode);
+}
 
-  lastEncoderCheck = currentCount;
-  return false;
+static void backend_stop()
+{
+  plant_set_motor(0, MOTOR_DECAY_SLOW);
 }
 
-void motor_init()
+#endif
+
+static void pwm_setup()
 {
-  // First set pins to LOW to prevent motor from running during init
-  pinMode(MOTOR_EN, OUTPUT);
-  pinMode(MOTOR_PN, OUTPUT);
-  digitalWrite(MOTOR_EN, LOW);
-  digitalWrite(MOTOR_PN, LOW);
+  pwmPending.store(false);
+  periodTicks = backend_setup(pwmFreq.load());
+  decay = pwmDecay.load();
+}
 
-  mcpwm_config_t pwm_config;
-  pwm_config.frequency = 1000;
-  pwm_config.cmpr_a = 0;
-  pwm_config.cmpr_b = 0;
-  pwm_config.counter_mode = MCPWM_UP_COUNTER;
-  pwm_config.duty_mode = MCPWM_DUTY_MODE_0;
+// Re-runs the timer setup if motor_set_pwm() changed something, with the
+// outputs low meanwhile. Returns true if it did.
+static bool apply_pending_pwm()
+{
+  if (!pwmPending.load()) return false;
+  backend_stop();
+  pwm_setup();
+  return true;
+}
 
-  mcpwm_gpio_init(MCPWM_UNIT_0, MCPWM0A, MOTOR_EN);
-  mcpwm_gpio_init(MCPWM_UNIT_0, MCPWM0B, MOTOR_PN);
-  mcpwm_init(MCPWM_UNIT_0, MCPWM_TIMER_0, &pwm_config);
+void motor_init()
+{
+  backend_init();
+  pwm_setup();
 
   // Ensure motor is stopped after init
   motor_stop();
@@ -90,27 +145,30 @@ void motor_init()
   encoder_init();
 }
 
-void motor_forward(uint8_t speed)
+static void motor_drive(bool reverse, float duty)
 {
+  apply_pending_pwm();
   motorRunning = true;
-  mcpwm_set_signal_low(MCPWM_UNIT_0, MCPWM_TIMER_0, MCPWM_GEN_B);  // Swapped
-  mcpwm_set_duty_type(MCPWM_UNIT_0, MCPWM_TIMER_0, MCPWM_GEN_A, MCPWM_DUTY_MODE_0);
-  mcpwm_set_duty(MCPWM_UNIT_0, MCPWM_TIMER_0, MCPWM_GEN_A, speed);
+  currentDuty = reverse ? -duty : duty;
+  backend_drive(reverse, duty, decay);
+}
+
+void motor_forward(uint8_t speed)
+{
+  motor_drive(false, speed);
 }
 
 void motor_backward(uint8_t speed)
 {
-  motorRunning = true;
-  mcpwm_set_signal_high(MCPWM_UNIT_0, MCPWM_TIMER_0, MCPWM_GEN_B);  // Swapped
-  mcpwm_set_duty_type(MCPWM_UNIT_0, MCPWM_TIMER_0, MCPWM_GEN_A, MCPWM_DUTY_MODE_0);
-  mcpwm_set_duty(MCPWM_UNIT_0, MCPWM_TIMER_0, MCPWM_GEN_A, speed);
+  motor_drive(true, speed);
 }
 
 void motor_stop()
 {
+  apply_pending_pwm();
   motorRunning = false;
-  mcpwm_set_signal_low(MCPWM_UNIT_0, MCPWM_TIMER_0, MCPWM_GEN_A);
-  mcpwm_set_signal_low(MCPWM_UNIT_0, MCPWM_TIMER_0, MCPWM_GEN_B);
+  currentDuty = 0;
+  backend_stop();
 }
 
 void motor_set(int8_t direction, uint8_t speed)
@@ -129,3 +187,60 @@ void motor_set(int8_t direction, uint8_t speed)
       break;
   }
 }
+
+// Signed duty percent (-100..100) with sub-percent resolution
+void motor_set_output(float duty)
+{
+  if (duty > 0) {
+    motor_drive(false, duty);
+  } else if (duty < 0) {
+    motor_drive(true, -duty);
+  } else {
+    motor_stop();
+  }
+}
+
+// Signed duty, MOTOR_DUTY16_MAX = full forward. The hardware resolves
+// motor_get_period_ticks() steps of this range.
+void motor_set_duty16(int32_t duty)
+{
+  duty = constrain(duty, -MOTOR_DUTY16_MAX, MOTOR_DUTY16_MAX);
+  motor_set_output(duty * (100.0f / MOTOR_DUTY16_MAX));
+}
+
+float motor_get_output()
+{
+  return currentDuty;
+}
+
+bool motor_running()
+{
+  return motorRunning;
+}
+
+// Takes effect with the next motor_set_*() or motor_stop() call
+bool motor_set_pwm(uint32_t freq_hz, uint8_t newDecay)
+{
+  if (freq_hz < MOTOR_PWM_MIN_HZ || freq_hz > MOTOR_PWM_MAX_HZ) return false;
+  if (newDecay != MOTOR_DECAY_SLOW && newDecay != MOTOR_DECAY_FAST) return false;
+  pwmFreq.store(freq_hz);
+  pwmDecay.store(newDecay);
+  pwmPending.store(true);
+  return true;
+}
+
+uint32_t motor_get_pwm_freq()
+{
+  return pwmFreq.load();
+}
+
+uint8_t motor_get_decay()
+{
+  return pwmDecay.load();
+}
+
+// Timer ticks per PWM period, i.e. distinct duty steps
+uint32_t motor_get_period_ticks()
+{
+  return periodTicks;
+}
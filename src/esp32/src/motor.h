@@ -2,35 +2,58 @@
 #define MOTOR_H
 
 #include <Arduino.h>
+#include "encoder.h"
 
 // Motor pins (M1 on Romeo ESP32-S3)
 #define MOTOR_EN 12
 #define MOTOR_PN 13
 
-// Encoder pins (on IO header)
-#define ENCODER_A 44  // Green wire
-#define ENCODER_B 43  // Yellow wire
+// Motor backend: MCPWM on the board, the simulated plant in the native
+// build (-DHAL_SIM)
+#ifdef HAL_SIM
+#define MOTOR_BACKEND_SIM
+#else
+#define MOTOR_BACKEND_MCPWM
+#endif
+
+// PWM drive. The default frequency is above hearing; override with
+// -DMOTOR_PWM_FREQ_HZ=... or change it at runtime (motor_set_pwm()).
+#ifndef MOTOR_PWM_FREQ_HZ
+#define MOTOR_PWM_FREQ_HZ 20000
+#endif
+#define MOTOR_PWM_MIN_HZ 100
+#define MOTOR_PWM_MAX_HZ 100000
+#define MOTOR_PWM_GROUP_HZ 160000000UL  // MCPWM group clock, undivided
+#define MOTOR_PWM_MAX_PERIOD 65535      // 16-bit timer period register
+
+// Decay mode, override with -DMOTOR_DECAY=MOTOR_DECAY_FAST
+#define MOTOR_DECAY_SLOW 0  // PWM on EN, PH holds direction (sign-magnitude)
+#define MOTOR_DECAY_FAST 1  // EN held on, PWM on PH around 50 % (locked anti-phase)
+#ifndef MOTOR_DECAY
+#define MOTOR_DECAY MOTOR_DECAY_SLOW
+#endif
+
+// Full scale of the 16-bit duty interface
+#define MOTOR_DUTY16_MAX 65535
 
 // Direction definitions
 #define FORWARD 1
 #define BACKWARD 2
 #define STOP 0
 
-// Encoder data
-extern volatile long encoderCount;
-extern volatile int lastEncoded;
-extern bool motorRunning;
-
 void motor_init();
 void motor_forward(uint8_t speed);
 void motor_backward(uint8_t speed);
 void motor_stop();
 void motor_set(int8_t direction, uint8_t speed);
-
-// Encoder functions
-void encoder_init();
-long encoder_read();
-void encoder_reset();
-bool check_stall();
+void motor_set_output(float duty);
+void motor_set_duty16(int32_t duty);
+float motor_get_output();
+bool motor_running();
+
+bool motor_set_pwm(uint32_t freq_hz, uint8_t decay);
+uint32_t motor_get_pwm_freq();
+uint8_t motor_get_decay();
+uint32_t motor_get_period_ticks();
 
 #endif
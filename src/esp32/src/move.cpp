@@ -0,0 +1,110 @@
+#include "move.h"
+
+static move_config_t config = { MOVE_DECEL, MOVE_MIN_SPEED };
+static portMUX_TYPE configMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Completed moves, control task -> comms task
+static QueueHandle_t eventQueue = NULL;
+
+#define STATE_IDLE 0
+#define STATE_DRIVING 1
+#define STATE_SETTLING 2
+
+// Control task only
+static uint8_t state = STATE_IDLE;
+static uint8_t moveSeq = 0;
+static int64_t targetCount = 0;
+static int8_t direction = 1;
+static float cruise = 0;
+static int64_t settleStart = 0;
+
+void move_init()
+{
+  if (!eventQueue) {
+    eventQueue = xQueueCreate(MOVE_EVENT_QUEUE, sizeof(move_event_t));
+  }
+  state = STATE_IDLE;
+}
+
+void move_start(uint8_t seq, int64_t count, int32_t distance, float speed)
+{
+  if (state != STATE_IDLE) move_finish(MOVE_RESULT_ABORTED, count);
+
+  moveSeq = seq;
+  targetCount = count + distance;
+  direction = distance < 0 ? -1 : 1;
+  cruise = fabsf(speed);
+  state = STATE_DRIVING;
+
+  if (cruise == 0) move_finish(MOVE_RESULT_INVALID, count);
+}
+
+// Speed limited so the decel ramp ends at the target:
+// v = sqrt(2 * decel * remaining), never above the cruise speed
+uint8_t move_sample(int64_t now_us, int64_t count, float velocity, float *target)
+{
+  if (state == STATE_IDLE) return MOVE_STEP_IDLE;
+
+  move_config_t cfg;
+  portENTER_CRITICAL(&configMux);
+  cfg = config;
+  portEXIT_CRITICAL(&configMux);
+
+  int64_t remaining = (targetCount - count) * direction;
+
+  if (state == STATE_DRIVING) {
+    if (remaining > MOVE_TOLERANCE) {
+      float v = sqrtf(2 * cfg.decel * (float)remaining);
+      if (v > cruise) v = cruise;
+      if (v < cfg.min_speed) v = cfg.min_speed;
+      *target = v * direction;
+      return MOVE_STEP_DRIVE;
+    }
+    state = STATE_SETTLING;
+    settleStart = now_us;
+  }
+
+  if (fabsf(velocity) < MOVE_STOP_VELOCITY || now_us - settleStart > MOVE_SETTLE_MS * 1000LL) {
+    move_finish(MOVE_RESULT_REACHED, count);
+    return MOVE_STEP_IDLE;
+  }
+  return MOVE_STEP_BRAKE;
+}
+
+// Ends the running move (if any) and queues its completion event
+void move_finish(uint8_t result, int64_t count)
+{
+  if (state == STATE_IDLE) return;
+  state = STATE_IDLE;
+
+  move_event_t event;
+  event.seq = moveSeq;
+  event.result = result;
+  event.error = (int32_t)((count - targetCount) * direction);
+  xQueueSend(eventQueue, &event, 0);  // Pi gets nothing if it let 4 pile up
+}
+
+bool move_active()
+{
+  return state != STATE_IDLE;
+}
+
+bool move_poll_event(move_event_t *event)
+{
+  return xQueueReceive(eventQueue, event, 0) == pdTRUE;
+}
+
+// Called from the comms task while a move runs on the other core
+void move_set_config(const move_config_t *newConfig)
+{
+  portENTER_CRITICAL(&configMux);
+  config = *newConfig;
+  portEXIT_CRITICAL(&configMux);
+}
+
+void move_get_config(move_config_t *out)
+{
+  portENTER_CRITICAL(&configMux);
+  *out = config;
+  portEXIT_CRITICAL(&configMux);
+}
@@ -0,0 +1,56 @@
+#ifndef MOVE_H
+#define MOVE_H
+
+#include <Arduino.h>
+
+// Distance move: drive a given number of encoder ticks in velocity mode,
+// slowing down on a ramp computed from the distance left, then brake and
+// report where the car came to rest. Runs entirely in the control task.
+
+#define MOVE_DECEL 40000.0f      // ticks/s^2 of the stopping ramp
+#define MOVE_MIN_SPEED 300.0f    // ticks/s crawl so the last ticks still get covered
+#define MOVE_TOLERANCE 20        // ticks from the target that count as arrived
+#define MOVE_SETTLE_MS 200       // Longest wait for the wheel to stop after braking
+#define MOVE_STOP_VELOCITY 50.0f // ticks/s, slower than this counts as stopped
+
+#define MOVE_EVENT_QUEUE 4
+
+// How a move ended
+#define MOVE_RESULT_REACHED 1
+#define MOVE_RESULT_ABORTED 2   // Replaced by another command
+#define MOVE_RESULT_STALLED 3
+#define MOVE_RESULT_FAILSAFE 4
+#define MOVE_RESULT_INVALID 5   // Zero speed
+#define MOVE_RESULT_FAULT 6     // Encoder loss or direction mismatch
+
+// What the control task should do this tick
+#define MOVE_STEP_IDLE 0   // No move running
+#define MOVE_STEP_DRIVE 1  // Velocity setpoint in *target
+#define MOVE_STEP_BRAKE 2  // Arrived, stopped and waiting for the wheel
+
+typedef struct {
+  float decel;
+  float min_speed;
+} move_config_t;
+
+typedef struct {
+  uint8_t seq;     // Of the MOVE command
+  uint8_t result;  // MOVE_RESULT_*
+  int32_t error;   // Resting position minus target, in the move direction (+ = overshoot)
+} move_event_t;
+
+void move_init();
+
+// Control task
+void move_start(uint8_t seq, int64_t count, int32_t distance, float speed);
+uint8_t move_sample(int64_t now_us, int64_t count, float velocity, float *target);
+void move_finish(uint8_t result, int64_t count);
+bool move_active();
+
+// Comms task
+bool move_poll_event(move_event_t *event);
+
+void move_set_config(const move_config_t *config);
+void move_get_config(move_config_t *config);
+
+#endif
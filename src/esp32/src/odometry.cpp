@@ -0,0 +1,59 @@
+#include "odometry.h"
+#include "steering.h"
+#include <atomic>
+
+// Kinematic bicycle model integrated once per control tick. Rear axle
+// reference point, steering angle from the last commanded servo position.
+static odom_pose_t pose;
+static int64_t lastCount = 0;
+static bool haveCount = false;
+static std::atomic<bool> resetRequested(false);
+
+void odometry_init()
+{
+  memset(&pose, 0, sizeof(pose));
+  haveCount = false;
+}
+
+// Safe from any task, applied on the next control tick
+void odometry_reset()
+{
+  resetRequested.store(true);
+}
+
+void odometry_update(uint32_t now_us, int64_t count, int32_t steer_cdeg)
+{
+  if (resetRequested.exchange(false)) {
+    memset(&pose, 0, sizeof(pose));
+  }
+
+  float dt = haveCount ? (now_us - pose.time_us) * 1e-6f : 0;
+  float ds = haveCount ? (count - lastCount) * ODOM_MM_PER_TICK : 0;
+  lastCount = count;
+  haveCount = true;
+  pose.time_us = now_us;
+
+  steering_cal_t steer;
+  steering_get_cal(&steer);
+  // Servo angles below center steer left (STEERING_LEFT < STEERING_CENTER),
+  // which is a positive, counter-clockwise wheel angle
+  float wheelAngle = (steer.center * 100 - steer_cdeg) * 0.01f * ODOM_STEER_RATIO * (float)DEG_TO_RAD;
+  float dHeading = ds * tanf(wheelAngle) / ODOM_WHEELBASE_MM;
+
+  // Midpoint heading for the position step
+  float mid = pose.heading + dHeading * 0.5f;
+  pose.x_mm += ds * cosf(mid);
+  pose.y_mm += ds * sinf(mid);
+  pose.distance_mm += fabsf(ds);
+
+  pose.heading += dHeading;
+  if (pose.heading > PI) pose.heading -= 2 * PI;
+  if (pose.heading < -PI) pose.heading += 2 * PI;
+  pose.yaw_rate = dt > 0 ? dHeading / dt : 0;
+}
+
+// Control task only, other tasks get the pose through telemetry
+void odometry_get(odom_pose_t *out)
+{
+  *out = pose;
+}
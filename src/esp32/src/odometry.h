@@ -0,0 +1,26 @@
+#ifndef ODOMETRY_H
+#define ODOMETRY_H
+
+#include <Arduino.h>
+
+// Vehicle geometry, measure on the car
+#define ODOM_WHEELBASE_MM 145.0f    // Front to rear axle
+#define ODOM_MM_PER_TICK 0.05f      // Wheel travel per encoder tick
+#define ODOM_STEER_RATIO 0.35f      // Front wheel degrees per servo degree from center
+                                    // (servo below center = left = counter-clockwise)
+
+typedef struct {
+  float x_mm;         // Start pose is the origin, x along the initial heading
+  float y_mm;
+  float heading;      // rad, counter-clockwise, wrapped to -pi..pi
+  float yaw_rate;     // rad/s
+  float distance_mm;  // Total path length, always increasing
+  uint32_t time_us;   // Control tick the pose belongs to
+} odom_pose_t;
+
+void odometry_init();
+void odometry_reset();
+void odometry_update(uint32_t now_us, int64_t count, int32_t steer_cdeg);
+void odometry_get(odom_pose_t *pose);
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <Arduino.h>
+
+// Binary frame protocol between Raspberry Pi and ESP32.
+//
+// Every frame has the same fixed size in both directions:
+//
+//   [0]     PROTO_SYNC
+//   [1]     message type (MSG_*)
+//   [2]     sequence number (echoed in replies)
+//   [3..10] payload, little-endian, unused bytes are zero
+//   [11]    CRC-8 (poly 0x07) over bytes [1..10]
+
+#define PROTO_SYNC 0xA5
+#define PROTO_FRAME_SIZE 12
+#define PROTO_PAYLOAD_SIZE 8
+
+// Pi -> ESP32
+#define MSG_DRIVE 0x01      // int16 speed (-100..100), int16 steering (0.01 deg), uint16 trace id
+#define MSG_GET_SCHED 0x02  // no payload, answered with one MSG_SCHED_STATS per task
+#define MSG_VELOCITY 0x03   // int32 target ticks/s, int16 steering (0.01 deg), uint16 trace id
+#define MSG_SET_PARAM 0x04  // uint8 param id, pad, float32 value
+#define MSG_GET_PARAM 0x05  // uint8 param id, answered with MSG_PARAM
+#define MSG_GET_HIST 0x06   // uint8 histogram id, uint8 clear after read
+#define MSG_TRAJ_POINT 0x07 // int32 key, int16 speed, int16 steering (0.01 deg)
+#define MSG_TRAJ_CTRL 0x08  // uint8 TRAJ_OP_*, uint8 TRAJ_BY_*, uint8 CONTROL_MODE_*
+#define MSG_ODOM_RESET 0x09 // no payload, pose back to the origin
+#define MSG_CALIBRATION 0x0A // uint8 CAL_OP_*, answered with MSG_CAL_STATUS
+#define MSG_MOVE 0x0B       // int32 distance ticks, uint16 speed ticks/s, int16 steering (0.01 deg)
+#define MSG_TRIGGER_SET 0x0C  // uint8 slot, uint8 TRIGGER_ACTION_*, int32 position ticks, int16 value
+#define MSG_TRIGGER_CTRL 0x0D // uint8 TRIGGER_OP_*, uint8 slot
+#define MSG_GET_LOAD 0x0E   // no payload, answered with MSG_LOAD frames
+
+// ESP32 -> Pi
+#define MSG_STATUS 0x81       // int32 encoder count
+#define MSG_SCHED_STATS 0x82  // uint8 task id, pad, uint16 max run us, uint32 deadline misses
+#define MSG_PARAM 0x83        // uint8 param id, pad, float32 value
+#define MSG_HIST 0x84         // uint8 histogram id, uint8 bin, pad, uint32 count
+#define MSG_TRAJ_STATUS 0x85  // uint8 accepted, uint8 active, uint16 queued, uint16 free
+#define MSG_CAL_STATUS 0x86   // uint8 op, uint8 ok, uint8 source, pad, uint16 version, uint16 size
+#define MSG_MOVE_DONE 0x87    // uint8 MOVE_RESULT_*, pad, int32 final error ticks (seq of the MOVE)
+#define MSG_TRIGGER_STATUS 0x88 // uint8 accepted, uint8 armed slot mask
+#define MSG_TRIGGER_FIRED 0x89  // uint8 slot, uint8 action, uint16 delay us, int32 count (seq of the SET)
+#define MSG_LOAD 0x8A           // uint8 LOAD_KIND_*, uint8 index, uint16 load 0.01 %, 4 bytes by kind
+#define MSG_TRACE 0x8B          // uint16 trace id, uint16 arrival -> PWM us, uint16 PWM -> reply us, uint8 TRACE_FLAG_* (seq of the command)
+
+// A DRIVE / VELOCITY with a non-zero trace id (the Pi uses the camera
+// frame it acted on) gets a MSG_TRACE once the control task has written
+// the output of the tick that took it; TRACE_FLAG_* (control.h) say when
+// that output was not, or not all, the command's. Both times are
+// durations on the ESP32 clock, so the Pi can place them on its own
+// timeline from the command's round trip without syncing clocks.
+
+// MSG_TRAJ_CTRL operations
+#define TRAJ_OP_START 0x01
+#define TRAJ_OP_STOP 0x02
+#define TRAJ_OP_CLEAR 0x03
+#define TRAJ_OP_QUERY 0x04
+
+// MSG_TRIGGER_CTRL operations
+#define TRIGGER_OP_QUERY 0x00
+#define TRIGGER_OP_CLEAR 0x01
+#define TRIGGER_OP_CLEAR_ALL 0x02
+
+// MSG_LOAD kinds and their last 4 bytes
+#define LOAD_KIND_TASK 0x00  // Scheduler task: uint16 jitter us, uint16 stack free bytes
+#define LOAD_KIND_ISR 0x01   // ISR_*: uint32 calls in the window
+#define LOAD_KIND_CORE 0x02  // CPU core: uint16 load not from tasks/ISRs above, pad
+
+// MSG_CALIBRATION operations
+#define CAL_OP_QUERY 0x00
+#define CAL_OP_SAVE 0x01      // Write the live values to flash
+#define CAL_OP_RELOAD 0x02    // Back to the values in flash
+#define CAL_OP_DEFAULTS 0x03  // Back to the compiled-in defaults (not saved)
+
+// Runtime parameters for MSG_SET_PARAM / MSG_GET_PARAM
+#define PARAM_SPEED_KP 0x01
+#define PARAM_SPEED_KI 0x02
+#define PARAM_SPEED_KD 0x03
+#define PARAM_SPEED_KFF 0x04
+#define PARAM_WATCHDOG_MS 0x10
+#define PARAM_DUTY_ACCEL 0x20     // duty %/s, 0 = no limit
+#define PARAM_DUTY_DECEL 0x21
+#define PARAM_DUTY_JERK 0x22      // duty %/s^2, 0 = trapezoidal
+#define PARAM_VEL_ACCEL 0x23      // ticks/s^2, 0 = no limit
+#define PARAM_VEL_DECEL 0x24
+#define PARAM_VEL_JERK 0x25       // ticks/s^3, 0 = trapezoidal
+#define PARAM_BRAKE_VELOCITY 0x26 // ticks/s
+#define PARAM_BRAKE_TIMEOUT_MS 0x27
+#define PARAM_MOVE_DECEL 0x28     // ticks/s^2, distance move stopping ramp
+#define PARAM_MOVE_MIN_SPEED 0x29 // ticks/s, distance move crawl speed
+#define PARAM_MOTOR_PWM_HZ 0x30   // PWM frequency, Hz
+#define PARAM_MOTOR_DECAY 0x31    // MOTOR_DECAY_SLOW / MOTOR_DECAY_FAST
+#define PARAM_STEER_CENTER 0x40   // deg
+#define PARAM_STEER_LEFT 0x41
+#define PARAM_STEER_RIGHT 0x42
+#define PARAM_STEER_PULSE_MIN 0x43 // us at 0 deg
+#define PARAM_STEER_PULSE_MAX 0x44 // us at 180 deg
+#define PARAM_ENCODER_PIN_A 0x48  // Boot only: saved, used after a restart
+#define PARAM_ENCODER_PIN_B 0x49
+#define PARAM_ENCODER_FILTER 0x4A // PCNT glitch filter, APB cycles
+#define PARAM_RACE_MODE 0x50      // Boot only: 1 = no serial wait, no init delays
+#define PARAM_FAULT_STALL_DUTY 0x60     // duty %
+#define PARAM_FAULT_STALL_RATIO 0x61    // measured / expected velocity
+#define PARAM_FAULT_STALL_VELOCITY 0x62 // ticks/s
+#define PARAM_FAULT_STALL_MS 0x63
+#define PARAM_FAULT_LOSS_VELOCITY 0x64  // ticks/s
+#define PARAM_FAULT_LOSS_EDGES 0x65     // edge periods
+#define PARAM_FAULT_MISMATCH_VELOCITY 0x66 // ticks/s
+#define PARAM_FAULT_MISMATCH_MS 0x67
+#define PARAM_LOAD_STREAM 0x70    // 1 = MSG_LOAD frames after every sampling window
+
+typedef struct {
+  uint8_t type;
+  uint8_t seq;
+  uint8_t payload[PROTO_PAYLOAD_SIZE];
+} proto_frame_t;
+
+void protocol_init();
+bool protocol_poll(proto_frame_t *frame);
+void protocol_send(uint8_t type, uint8_t seq, const uint8_t *payload, size_t len);
+void protocol_write(const uint8_t *data, size_t len);
+
+uint8_t proto_crc8(const uint8_t *data, size_t len);
+
+// Little-endian payload helpers
+static inline int16_t proto_get_i16(const uint8_t *p)
+{
+  return (int16_t)(p[0] | (p[1] << 8));
+}
+
+static inline int32_t proto_get_i32(const uint8_t *p)
+{
+  return (int32_t)((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+
+static inline float proto_get_f32(const uint8_t *p)
+{
+  float v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline void proto_put_i16(uint8_t *p, int16_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void proto_put_i32(uint8_t *p, int32_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static inline void proto_put_f32(uint8_t *p, float v)
+{
+  memcpy(p, &v, sizeof(v));
+}
+
+#endif
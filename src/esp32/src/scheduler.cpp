@@ -0,0 +1,134 @@
+#include "scheduler.h"
+
+// Each task blocks on its notification value. A periodic esp_timer gives
+// the notification, so periods are set in microseconds rather than
+// FreeRTOS ticks, and releases that pile up while a task is still running
+// show up as a notification count above one.
+
+typedef struct {
+  const char *name;
+  sched_fn_t fn;
+  uint32_t period_us;
+  uint8_t core;
+  uint8_t priority;
+  uint32_t stack_size;
+  TaskHandle_t handle;
+  esp_timer_handle_t timer;
+  sched_stats_t stats;
+  sched_window_t window;  // Since the last scheduler_take_window()
+  int64_t lastStart;
+} sched_task_t;
+
+static sched_task_t tasks[TASK_COUNT];
+static portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+
+static void timer_callback(void *arg)
+{
+  sched_task_t *task = (sched_task_t *)arg;
+  if (task->handle) {
+    xTaskNotifyGive(task->handle);
+  }
+}
+
+static void task_body(void *arg)
+{
+  sched_task_t *task = (sched_task_t *)arg;
+
+  while (true) {
+    uint32_t released = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    int64_t start = esp_timer_get_time();
+    task->fn();
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
+
+    int64_t interval = task->lastStart ? start - task->lastStart : task->period_us;
+    task->lastStart = start;
+    uint32_t jitter = (uint32_t)llabs(interval - (int64_t)task->period_us);
+
+    portENTER_CRITICAL(&statsMux);
+    sched_stats_t *s = &task->stats;
+    s->runs++;
+    if (released > 1) s->misses += released - 1;
+    if (elapsed > task->period_us) s->misses++;
+    s->last_us = elapsed;
+    if (elapsed > s->max_us) s->max_us = elapsed;
+    task->window.busy_us += elapsed;
+    task->window.runs++;
+    if (jitter > task->window.jitter_us) task->window.jitter_us = jitter;
+    portEXIT_CRITICAL(&statsMux);
+  }
+}
+
+void scheduler_add(sched_task_id_t id, const char *name, sched_fn_t fn,
+                   uint32_t rate_hz, uint8_t core, uint8_t priority, uint32_t stack_size)
+{
+  sched_task_t *task = &tasks[id];
+  memset(task, 0, sizeof(*task));
+  task->name = name;
+  task->fn = fn;
+  task->period_us = 1000000UL / rate_hz;
+  task->core = core;
+  task->priority = priority;
+  task->stack_size = stack_size;
+  task->stats.period_us = task->period_us;
+}
+
+void scheduler_start()
+{
+  for (int i = 0; i < TASK_COUNT; i++) {
+    sched_task_t *task = &tasks[i];
+    if (!task->fn) continue;
+
+    xTaskCreatePinnedToCore(task_body, task->name, task->stack_size, task,
+                            task->priority, &task->handle, task->core);
+
+    esp_timer_create_args_t args = {};
+    args.callback = timer_callback;
+    args.arg = task;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = task->name;
+    esp_timer_create(&args, &task->timer);
+    esp_timer_start_periodic(task->timer, task->period_us);
+  }
+}
+
+void scheduler_set_rate(sched_task_id_t id, uint32_t rate_hz)
+{
+  sched_task_t *task = &tasks[id];
+  if (!task->timer || rate_hz == 0) return;
+
+  uint32_t period = 1000000UL / rate_hz;
+  esp_timer_stop(task->timer);
+  portENTER_CRITICAL(&statsMux);
+  task->period_us = period;
+  task->stats.period_us = period;
+  portEXIT_CRITICAL(&statsMux);
+  esp_timer_start_periodic(task->timer, period);
+}
+
+void scheduler_get_stats(sched_task_id_t id, sched_stats_t *stats)
+{
+  portENTER_CRITICAL(&statsMux);
+  *stats = tasks[id].stats;
+  portEXIT_CRITICAL(&statsMux);
+}
+
+void scheduler_take_window(sched_task_id_t id, sched_window_t *window)
+{
+  portENTER_CRITICAL(&statsMux);
+  *window = tasks[id].window;
+  memset(&tasks[id].window, 0, sizeof(tasks[id].window));
+  portEXIT_CRITICAL(&statsMux);
+}
+
+// Bytes of stack the task has never touched
+uint32_t scheduler_stack_free(sched_task_id_t id)
+{
+  if (!tasks[id].handle) return 0;
+  return uxTaskGetStackHighWaterMark(tasks[id].handle);  // Bytes on ESP32
+}
+
+uint8_t scheduler_core(sched_task_id_t id)
+{
+  return tasks[id].core;
+}
@@ -0,0 +1,54 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+
+// Task rates (Hz), can be changed at runtime with scheduler_set_rate()
+#define CONTROL_RATE_HZ 1000
+#define COMMS_RATE_HZ 1000
+#define TELEMETRY_RATE_HZ 50
+
+// Core placement: control gets core 1 to itself, everything else on core 0
+#define CONTROL_CORE 1
+#define COMMS_CORE 0
+#define TELEMETRY_CORE 0
+
+// FreeRTOS priorities (esp_timer task runs at 22)
+#define CONTROL_PRIORITY 20
+#define COMMS_PRIORITY 10
+#define TELEMETRY_PRIORITY 2
+
+typedef enum {
+  TASK_CONTROL = 0,
+  TASK_COMMS,
+  TASK_TELEMETRY,
+  TASK_COUNT
+} sched_task_id_t;
+
+typedef void (*sched_fn_t)();
+
+typedef struct {
+  uint32_t runs;
+  uint32_t misses;     // Skipped releases + runs longer than the period
+  uint32_t last_us;    // Run time of the latest iteration
+  uint32_t max_us;     // Worst run time since start
+  uint32_t period_us;
+} sched_stats_t;
+
+// Load sampling, see instrument.h
+typedef struct {
+  uint32_t busy_us;    // Run time
+  uint32_t jitter_us;  // Worst start-to-start deviation from the period
+  uint32_t runs;
+} sched_window_t;
+
+void scheduler_add(sched_task_id_t id, const char *name, sched_fn_t fn,
+                   uint32_t rate_hz, uint8_t core, uint8_t priority, uint32_t stack_size);
+void scheduler_start();
+void scheduler_set_rate(sched_task_id_t id, uint32_t rate_hz);
+void scheduler_get_stats(sched_task_id_t id, sched_stats_t *stats);
+void scheduler_take_window(sched_task_id_t id, sched_window_t *window);
+uint32_t scheduler_stack_free(sched_task_id_t id);
+uint8_t scheduler_core(sched_task_id_t id);
+
+#endif
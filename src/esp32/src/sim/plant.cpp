@@ -0,0 +1,91 @@
+#include "plant.h"
+#include "steering.h"
+#include "encoder.h"
+
+static plant_config_t config = {
+  PLANT_GAIN, PLANT_TAU_S, PLANT_DEADBAND, PLANT_SERVO_RATE, 0
+};
+
+static plant_state_t state;
+static int64_t emitted = 0;     // Ticks handed to the encoder so far
+static float servoTarget = STEERING_CENTER;
+
+void plant_init(const plant_config_t *newConfig)
+{
+  if (newConfig) config = *newConfig;
+  memset(&state, 0, sizeof(state));
+  state.servo_deg = STEERING_CENTER;
+  servoTarget = STEERING_CENTER;
+  emitted = 0;
+}
+
+void plant_get_config(plant_config_t *out)
+{
+  *out = config;
+}
+
+// First-order wheel speed towards gain * (duty - deadband). With zero duty
+// (slow decay brake or stopped driver) it spins down on the same time
+// constant. Fast decay gives the same average drive, so it is not modelled
+// separately.
+static void step(float dt)
+{
+  float drive = 0;
+  if (state.duty > config.deadband) drive = state.duty - config.deadband;
+  if (state.duty < -config.deadband) drive = state.duty + config.deadband;
+
+  state.velocity += (config.gain * drive - state.velocity) * dt / config.tau_s;
+  state.position += state.velocity * dt;
+
+  if (config.wall_ticks != 0) {
+    bool past = config.wall_ticks > 0 ? state.position >= config.wall_ticks
+                                      : state.position <= config.wall_ticks;
+    if (past) {
+      state.position = config.wall_ticks;
+      state.velocity = 0;
+    }
+  }
+
+  float servoStep = config.servo_rate * dt;
+  float servoError = servoTarget - state.servo_deg;
+  state.servo_deg += constrain(servoError, -servoStep, servoStep);
+}
+
+// Advances the clock in substeps and emits every tick crossed on the way,
+// timestamped at the substep it happened in
+void plant_advance(uint32_t us)
+{
+  while (us > 0) {
+    uint32_t sub = us < PLANT_SUBSTEP_US ? us : PLANT_SUBSTEP_US;
+    us -= sub;
+    sim_advance_us(sub);
+    step(sub * 1e-6f);
+
+    int64_t ticks = (int64_t)floorf(state.position);
+    while (emitted < ticks) {
+      emitted++;
+      encoder_sim_step(1);
+    }
+    while (emitted > ticks) {
+      emitted--;
+      encoder_sim_step(-1);
+    }
+  }
+}
+
+void plant_get_state(plant_state_t *out)
+{
+  *out = state;
+}
+
+void plant_set_motor(float duty, uint8_t decay)
+{
+  state.duty = constrain(duty, -100.0f, 100.0f);
+}
+
+// Same pulse to angle mapping as the default servo calibration
+void plant_set_servo_us(uint16_t pulse_us)
+{
+  servoTarget = (float)(pulse_us - STEERING_PULSE_MIN_US) * (STEERING_MAX - STEERING_MIN)
+                / (STEERING_PULSE_MAX_US - STEERING_PULSE_MIN_US) + STEERING_MIN;
+}
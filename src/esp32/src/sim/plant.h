@@ -0,0 +1,43 @@
+#ifndef SIM_PLANT_H
+#define SIM_PLANT_H
+
+#include <Arduino.h>
+
+// Simulated drivetrain for the native build. The motor and steering
+// backends write into it, it feeds ticks back through encoder_sim_step()
+// and owns the simulation clock.
+
+#define PLANT_SUBSTEP_US 20  // Integration step, also the edge timestamp resolution
+
+// Defaults roughly match the car: 100 % duty spins the wheel at about
+// 10000 ticks/s free running (SPEED_KFF = 0.01)
+#define PLANT_GAIN 100.0f         // Free running ticks/s per duty %
+#define PLANT_TAU_S 0.08f         // Mechanical time constant
+#define PLANT_DEADBAND 4.0f       // duty % lost to static friction
+#define PLANT_SERVO_RATE 600.0f   // deg/s, about 0.1 s per 60 deg
+
+typedef struct {
+  float gain;
+  float tau_s;
+  float deadband;
+  float servo_rate;
+  float wall_ticks;   // Wheel blocked once it has gone this far (0 = no wall)
+} plant_config_t;
+
+typedef struct {
+  float position;     // ticks, as travelled by the wheel
+  float velocity;     // ticks/s
+  float duty;         // Signed %, as applied
+  float servo_deg;    // Actual servo angle
+} plant_state_t;
+
+void plant_init(const plant_config_t *config);
+void plant_get_config(plant_config_t *config);
+void plant_advance(uint32_t us);
+void plant_get_state(plant_state_t *state);
+
+// Backends
+void plant_set_motor(float duty, uint8_t decay);
+void plant_set_servo_us(uint16_t pulse_us);
+
+#endif
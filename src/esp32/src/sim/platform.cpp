@@ -0,0 +1,96 @@
+#include <Arduino.h>
+#include <deque>
+#include <vector>
+
+SimSerial Serial;
+
+static int64_t simTime = 0;
+
+int64_t esp_timer_get_time()
+{
+  return simTime;
+}
+
+void sim_advance_us(uint32_t us)
+{
+  simTime += us;
+}
+
+// Back to boot, so every simulation run sees the same timestamps
+void sim_reset_clock()
+{
+  simTime = 0;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+void digitalWrite(uint8_t pin, uint8_t value) {}
+int digitalRead(uint8_t pin) { return LOW; }
+
+// Nothing else runs meanwhile, so waiting is just skipping ahead
+void delay(uint32_t ms)
+{
+  simTime += ms * 1000LL;
+}
+
+unsigned long millis()
+{
+  return (unsigned long)(simTime / 1000);
+}
+
+unsigned long micros()
+{
+  return (unsigned long)simTime;
+}
+
+struct sim_queue {
+  size_t length;
+  size_t itemSize;
+  std::deque<std::vector<uint8_t>> items;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+  return new sim_queue{ length, itemSize, {} };
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t wait)
+{
+  if (q->items.size() >= q->length) return pdFALSE;
+  const uint8_t *p = (const uint8_t *)item;
+  q->items.emplace_back(p, p + q->itemSize);
+  return pdTRUE;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t q, const void *item, BaseType_t *woken)
+{
+  return xQueueSend(q, item, 0);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t q, const void *item)
+{
+  q->items.clear();
+  return xQueueSend(q, item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t wait)
+{
+  if (q->items.empty()) return pdFALSE;
+  memcpy(item, q->items.front().data(), q->itemSize);
+  q->items.pop_front();
+  return pdTRUE;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+  return new sim_queue{ 1, 0, {} };
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t wait)
+{
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+  return pdTRUE;
+}
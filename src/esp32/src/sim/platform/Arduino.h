@@ -0,0 +1,90 @@
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+// Just enough of the Arduino core, FreeRTOS and esp_timer for the control
+// code to build on a workstation. Single threaded: critical sections are
+// no-ops and queues never block. Time only moves when the simulation
+// advances it.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <stdio.h>
+
+#define IRAM_ATTR
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#define PI 3.1415926535897932384626433832795
+#define DEG_TO_RAD 0.017453292519943295
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+void delay(uint32_t ms);
+unsigned long millis();
+unsigned long micros();
+
+// esp_timer, driven by the simulation
+int64_t esp_timer_get_time();
+void sim_advance_us(uint32_t us);
+void sim_reset_clock();
+
+// FreeRTOS
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef struct sim_queue *QueueHandle_t;
+typedef struct sim_queue *SemaphoreHandle_t;
+typedef struct { int unused; } portMUX_TYPE;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define portMAX_DELAY 0xFFFFFFFFu
+#define portMUX_INITIALIZER_UNLOCKED { 0 }
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+#define portENTER_CRITICAL_ISR(mux) ((void)(mux))
+#define portEXIT_CRITICAL_ISR(mux) ((void)(mux))
+#define portENTER_CRITICAL_SAFE(mux) ((void)(mux))
+#define portEXIT_CRITICAL_SAFE(mux) ((void)(mux))
+#define portYIELD_FROM_ISR(woken) ((void)(woken))
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait);
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *woken);
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait);
+SemaphoreHandle_t xSemaphoreCreateMutex();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t wait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+
+// Serial: output goes to sink (if set) and is otherwise dropped, nothing
+// ever arrives
+class SimSerial {
+public:
+  void begin(unsigned long baud) {}
+  int available() { return 0; }
+  size_t read(uint8_t *buf, size_t len) { return 0; }
+  int availableForWrite() { return 4096; }
+  size_t write(const uint8_t *buf, size_t len)
+  {
+    written += len;
+    if (sink) sink(buf, len);
+    return len;
+  }
+  void println(const char *s) {}
+  explicit operator bool() const { return true; }
+  uint64_t written = 0;
+  void (*sink)(const uint8_t *buf, size_t len) = nullptr;
+};
+
+extern SimSerial Serial;
+
+#endif
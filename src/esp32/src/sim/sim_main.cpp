@@ -0,0 +1,414 @@
+// Host simulation, built by [env:native] instead of main.cpp.
+//
+// Runs the real control task code (profiles, PID, moves, fault detection)
+// against the plant in plant.cpp, 1 kHz control ticks on a simulated clock,
+// as fast as the workstation allows. Every run prints one JSON object per
+// line with its parameters and step response metrics; --csv writes a
+// per-tick trace of the last run.
+//
+//   program --scenario step --speed 8000 --sweep kp=0.01:0.05:0.01 --sweep ki=0.1:0.4:0.1
+//
+// Options:
+//   --scenario step|open|reverse|move|stall   (default step)
+//   --speed N     ticks/s (step, reverse, move, stall) or duty % (open)
+//   --distance N  ticks for move, wall position for stall
+//   --time S      simulated seconds per run
+//   --steer DEG   servo angle, below STEERING_CENTER turns left (default center)
+//
+// Speed, distance and time default per scenario (scenarioDefaults), so
+// each one runs to its end: the move arrives, the stall hits its wall.
+//   --set NAME=V  fix a parameter
+//   --sweep NAME=FROM:TO:STEP   run every value, several sweeps form a grid
+//   --csv FILE    trace of the last run
+//   --list        print the parameter names
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "plant.h"
+#include "motor.h"
+#include "steering.h"
+#include "encoder.h"
+#include "control.h"
+#include "speed_control.h"
+#include "motion_profile.h"
+#include "move.h"
+#include "fault.h"
+#include "protocol.h"
+#include "telemetry.h"
+#include "watchdog.h"
+#include "odometry.h"
+
+#define SIM_TICK_US 1000
+#define SIM_TELEMETRY_TICKS 20  // Telemetry task rate, 50 Hz
+
+#define SCENARIO_STEP 0
+#define SCENARIO_OPEN 1
+#define SCENARIO_REVERSE 2
+#define SCENARIO_MOVE 3
+#define SCENARIO_STALL 4
+
+static const char *scenarioNames[] = { "step", "open", "reverse", "move", "stall" };
+
+typedef struct {
+  float speed;
+  float distance;
+  float duration_s;
+} scenario_defaults_t;
+
+// In scenario order
+static const scenario_defaults_t scenarioDefaults[] = {
+  { 8000, 0, 2 },      // step
+  { 50, 0, 2 },        // open, duty %
+  { 8000, 0, 2 },      // reverse, halfway through
+  { 8000, 10000, 3 },  // move, about 1.5 s of cruise
+  { 3000, 3000, 2 },   // stall, wall reached after about 1 s
+};
+
+// Everything a run can be configured with, applied to the modules before it
+typedef struct {
+  speed_gains_t gains;
+  profile_config_t profile;
+  move_config_t move;
+  fault_config_t fault;
+  plant_config_t plant;
+} sim_params_t;
+
+typedef struct {
+  const char *name;
+  float *(*field)(sim_params_t *p);
+} sim_param_t;
+
+#define PARAM(n, expr) { n, [](sim_params_t *p) -> float * { return &p->expr; } }
+
+static const sim_param_t paramTable[] = {
+  PARAM("kp", gains.kp),
+  PARAM("ki", gains.ki),
+  PARAM("kd", gains.kd),
+  PARAM("kff", gains.kff),
+  PARAM("duty_accel", profile.duty.accel),
+  PARAM("duty_decel", profile.duty.decel),
+  PARAM("duty_jerk", profile.duty.jerk),
+  PARAM("vel_accel", profile.velocity.accel),
+  PARAM("vel_decel", profile.velocity.decel),
+  PARAM("vel_jerk", profile.velocity.jerk),
+  PARAM("brake_velocity", profile.brake_velocity),
+  PARAM("move_decel", move.decel),
+  PARAM("move_min_speed", move.min_speed),
+  PARAM("stall_duty", fault.stall_duty),
+  PARAM("stall_ratio", fault.stall_ratio),
+  PARAM("plant_gain", plant.gain),
+  PARAM("plant_tau", plant.tau_s),
+  PARAM("plant_deadband", plant.deadband),
+  PARAM("servo_rate", plant.servo_rate),
+};
+#define PARAM_COUNT (sizeof(paramTable) / sizeof(paramTable[0]))
+
+typedef struct {
+  const sim_param_t *param;
+  float from;
+  float to;
+  float step;
+} sim_sweep_t;
+
+// Step response figures against the final commanded speed
+typedef struct {
+  float rise_ms;        // 10 % -> 90 % of the step, -1 if never reached
+  float overshoot;      // % of the step
+  float settle_ms;      // Last time outside a 2 % band, from the step
+  float iae;            // Integral of |error|, ticks
+  float final_error;    // ticks/s at the end
+  float peak_duty;      // %
+  uint8_t move_result;  // Distance move only
+  int32_t move_error;
+  uint8_t fault;        // First fault code seen
+  float fault_ms;
+  odom_pose_t pose;     // Odometry at the end of the run
+} sim_metrics_t;
+
+// NAN until given, then filled from scenarioDefaults
+static uint8_t scenario = SCENARIO_STEP;
+static float speedArg = NAN;
+static float distanceArg = NAN;
+static float durationS = NAN;
+static float steerArg = STEERING_CENTER;
+static const char *csvPath = NULL;
+
+// First TELEM_FAULT of the current run, picked out of the telemetry stream
+static telemetry_record_t firstFault;
+static bool faultSeen = false;
+
+// Serial sink. telemetry_drain() only ever writes whole frames.
+static void capture(const uint8_t *buf, size_t len)
+{
+  for (size_t i = 0; i + TELEMETRY_FRAME_SIZE <= len; i += TELEMETRY_FRAME_SIZE) {
+    if (buf[i] != TELEMETRY_SYNC) continue;
+    telemetry_record_t record;
+    memcpy(&record, buf + i + 1, sizeof(record));
+    if (record.type == TELEM_FAULT && !faultSeen) {
+      firstFault = record;
+      faultSeen = true;
+    }
+  }
+}
+
+static const sim_param_t *find_param(const char *name)
+{
+  for (size_t i = 0; i < PARAM_COUNT; i++) {
+    if (strcmp(paramTable[i].name, name) == 0) return &paramTable[i];
+  }
+  fprintf(stderr, "unknown parameter '%s', see --list\n", name);
+  exit(2);
+}
+
+static void defaults(sim_params_t *p)
+{
+  speed_control_get_gains(&p->gains);
+  motion_profile_get_config(&p->profile);
+  move_get_config(&p->move);
+  fault_get_config(&p->fault);
+  plant_get_config(&p->plant);
+}
+
+static void submit(uint8_t mode, int32_t speed, int32_t distance)
+{
+  control_command_t cmd = {};
+  cmd.arrival_us = (uint32_t)esp_timer_get_time();
+  cmd.mode = mode;
+  cmd.speed = speed;
+  cmd.distance = distance;
+  cmd.steer_cdeg = (int32_t)(steerArg * 100);
+  control_submit(&cmd);
+}
+
+static void run(const sim_params_t *p, FILE *csv, sim_metrics_t *m)
+{
+  sim_params_t params = *p;
+  if (scenario == SCENARIO_STALL) params.plant.wall_ticks = distanceArg;
+
+  // Same order as setup(), minus the parts that need the board
+  sim_reset_clock();
+  plant_init(&params.plant);
+  speed_control_set_gains(&params.gains);
+  motion_profile_set_config(&params.profile);
+  move_set_config(&params.move);
+  fault_set_config(&params.fault);
+  motor_init();
+  steering_init(false);
+  protocol_init();
+  telemetry_init();
+  watchdog_init();
+  control_init();
+
+  memset(m, 0, sizeof(*m));
+  m->rise_ms = -1;
+  faultSeen = false;
+  int64_t start = esp_timer_get_time();
+
+  uint32_t ticks = (uint32_t)(durationS * 1e6f / SIM_TICK_US);
+  float target = scenario == SCENARIO_OPEN ? speedArg * params.plant.gain : speedArg;
+  float low = -1, high = -1;
+  float stepStart = 0;
+  move_event_t event;
+
+  if (csv) fprintf(csv, "t_ms,target,velocity,duty,position,servo_deg,flags\n");
+
+  for (uint32_t i = 0; i < ticks; i++) {
+    float t = i * SIM_TICK_US * 1e-3f;
+
+    if (i == 0) {
+      switch (scenario) {
+        case SCENARIO_OPEN: submit(CONTROL_MODE_OPEN_LOOP, (int32_t)speedArg, 0); break;
+        case SCENARIO_MOVE: submit(CONTROL_MODE_MOVE, (int32_t)speedArg, (int32_t)distanceArg); break;
+        default: submit(CONTROL_MODE_VELOCITY, (int32_t)speedArg, 0); break;
+      }
+    }
+    if (scenario == SCENARIO_REVERSE && i == ticks / 2) {
+      submit(CONTROL_MODE_VELOCITY, -(int32_t)speedArg, 0);
+      target = -speedArg;
+      stepStart = t;
+      low = high = -1;
+    }
+
+    watchdog_feed((uint32_t)esp_timer_get_time());  // The Pi never goes quiet here
+    control_update();
+    if (i % SIM_TELEMETRY_TICKS == 0) telemetry_drain();
+
+    plant_state_t s;
+    plant_get_state(&s);
+    float from = scenario == SCENARIO_REVERSE && stepStart > 0 ? -target : 0;
+    float progress = (target - from) != 0 ? (s.velocity - from) / (target - from) : 0;
+    if (low < 0 && progress >= 0.1f) low = t;
+    if (high < 0 && progress >= 0.9f) high = t;
+    if (progress - 1 > m->overshoot / 100) m->overshoot = (progress - 1) * 100;
+    if (fabsf(progress - 1) > 0.02f) m->settle_ms = t - stepStart;
+    m->iae += fabsf(target - s.velocity) * SIM_TICK_US * 1e-6f;
+    if (fabsf(s.duty) > m->peak_duty) m->peak_duty = fabsf(s.duty);
+    m->final_error = target - s.velocity;
+
+    if (move_poll_event(&event)) {
+      m->move_result = event.result;
+      m->move_error = event.error;
+    }
+
+    if (csv) {
+      fprintf(csv, "%.1f,%.0f,%.1f,%.2f,%.0f,%.2f,%u\n", t, target, s.velocity, s.duty,
+              s.position, s.servo_deg, motion_profile_braking() ? TELEM_FLAG_BRAKING : 0);
+    }
+    plant_advance(SIM_TICK_US);
+  }
+  telemetry_drain();
+
+  if (faultSeen) {
+    m->fault = firstFault.fault.code;
+    m->fault_ms = (int64_t)(firstFault.time_us - (uint32_t)start) * 1e-3f;
+  }
+
+  if (low >= 0 && high >= 0) m->rise_ms = high - low;
+  odometry_get(&m->pose);
+}
+
+static void print_result(const sim_params_t *p, const sim_metrics_t *m)
+{
+  printf("{\"scenario\":\"%s\",\"speed\":%.0f", scenarioNames[scenario], speedArg);
+  for (size_t i = 0; i < PARAM_COUNT; i++) {
+    printf(",\"%s\":%g", paramTable[i].name, *paramTable[i].field((sim_params_t *)p));
+  }
+  printf(",\"rise_ms\":%.1f,\"overshoot_pct\":%.2f,\"settle_ms\":%.1f,\"iae\":%.1f,"
+         "\"final_error\":%.1f,\"peak_duty\":%.1f",
+         m->rise_ms, m->overshoot, m->settle_ms, m->iae, m->final_error, m->peak_duty);
+  if (scenario == SCENARIO_MOVE) {
+    printf(",\"move_result\":%u,\"move_error\":%d", m->move_result, (int)m->move_error);
+  }
+  printf(",\"x_mm\":%.1f,\"y_mm\":%.1f,\"heading\":%.3f",
+         m->pose.x_mm, m->pose.y_mm, m->pose.heading);
+  printf(",\"fault\":%u", m->fault);
+  if (m->fault) printf(",\"fault_ms\":%.1f", m->fault_ms);
+  printf("}\n");
+}
+
+// Walks the sweep grid depth first, then runs
+static void sweep(sim_params_t *p, const std::vector<sim_sweep_t> &sweeps, size_t level,
+                  FILE *csv, size_t *left)
+{
+  if (level == sweeps.size()) {
+    sim_metrics_t m;
+    (*left)--;
+    run(p, *left == 0 ? csv : NULL, &m);
+    print_result(p, &m);
+    return;
+  }
+
+  const sim_sweep_t &s = sweeps[level];
+  for (float v = s.from; v <= s.to + s.step * 0.5f; v += s.step) {
+    *s.param->field(p) = v;
+    sweep(p, sweeps, level + 1, csv, left);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  sim_params_t params;
+  defaults(&params);
+  std::vector<sim_sweep_t> sweeps;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+    if (arg == "--list") {
+      for (size_t j = 0; j < PARAM_COUNT; j++) {
+        printf("%s %g\n", paramTable[j].name, *paramTable[j].field(&params));
+      }
+      return 0;
+    }
+    if (!value) {
+      fprintf(stderr, "%s needs a value\n", arg.c_str());
+      return 2;
+    }
+    i++;
+
+    if (arg == "--scenario") {
+      bool found = false;
+      for (uint8_t s = 0; s < sizeof(scenarioNames) / sizeof(scenarioNames[0]); s++) {
+        if (strcmp(scenarioNames[s], value) == 0) {
+          scenario = s;
+          found = true;
+        }
+      }
+      if (!found) {
+        fprintf(stderr, "unknown scenario '%s'\n", value);
+        return 2;
+      }
+    } else if (arg == "--speed") {
+      speedArg = atof(value);
+    } else if (arg == "--distance") {
+      distanceArg = atof(value);
+    } else if (arg == "--steer") {
+      steerArg = atof(value);
+    } else if (arg == "--time") {
+      durationS = atof(value);
+    } else if (arg == "--csv") {
+      csvPath = value;
+    } else if (arg == "--set" || arg == "--sweep") {
+      std::string spec = value;
+      size_t eq = spec.find('=');
+      if (eq == std::string::npos) {
+        fprintf(stderr, "expected NAME=VALUE, got '%s'\n", value);
+        return 2;
+      }
+      const sim_param_t *param = find_param(spec.substr(0, eq).c_str());
+      std::string rest = spec.substr(eq + 1);
+      if (arg == "--set") {
+        *param->field(&params) = atof(rest.c_str());
+        continue;
+      }
+      sim_sweep_t s = { param, 0, 0, 0 };
+      if (sscanf(rest.c_str(), "%f:%f:%f", &s.from, &s.to, &s.step) != 3 || s.step <= 0) {
+        fprintf(stderr, "expected NAME=FROM:TO:STEP, got '%s'\n", value);
+        return 2;
+      }
+      sweeps.push_back(s);
+    } else {
+      fprintf(stderr, "unknown option %s\n", arg.c_str());
+      return 2;
+    }
+  }
+
+  const scenario_defaults_t *d = &scenarioDefaults[scenario];
+  if (isnan(speedArg)) speedArg = d->speed;
+  if (isnan(distanceArg)) distanceArg = d->distance;
+  if (isnan(durationS)) durationS = d->duration_s;
+
+  if (scenario == SCENARIO_OPEN && fabsf(speedArg) > 100) {
+    fprintf(stderr, "open takes --speed as duty %%, -100..100\n");
+    return 2;
+  }
+  if ((scenario == SCENARIO_MOVE || scenario == SCENARIO_STALL) && distanceArg == 0) {
+    fprintf(stderr, "%s needs a non-zero --distance\n", scenarioNames[scenario]);
+    return 2;
+  }
+  if (durationS <= 0) {
+    fprintf(stderr, "--time must be positive\n");
+    return 2;
+  }
+
+  Serial.sink = capture;
+
+  FILE *csv = NULL;
+  if (csvPath) {
+    csv = fopen(csvPath, "w");
+    if (!csv) {
+      perror(csvPath);
+      return 1;
+    }
+  }
+
+  size_t runs = 1;
+  for (const sim_sweep_t &s : sweeps) runs *= (size_t)((s.to - s.from) / s.step + 1.5f);
+  sweep(&params, sweeps, 0, csv, &runs);
+
+  if (csv) fclose(csv);
+  return 0;
+}
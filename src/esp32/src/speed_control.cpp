@@ -0,0 +1,78 @@
+#include "speed_control.h"
+#include "motor.h"
+
+static speed_gains_t gains = { SPEED_KP, SPEED_KI, SPEED_KD, SPEED_KFF };
+static portMUX_TYPE gainsMux = portMUX_INITIALIZER_UNLOCKED;
+
+static float target = 0;
+static float velocity = 0;
+static float integral = 0;
+static float lastError = 0;
+
+void speed_control_init()
+{
+  speed_control_reset();
+}
+
+// Clear controller state, e.g. after a stall or when leaving velocity mode
+void speed_control_reset()
+{
+  target = 0;
+  integral = 0;
+  lastError = 0;
+  velocity = 0;
+}
+
+void speed_control_set_target(float ticks_per_s)
+{
+  target = ticks_per_s;
+}
+
+// One controller step, called from the control task. Returns the duty
+// written to the motor.
+float speed_control_update(float dt)
+{
+  speed_gains_t g;
+  portENTER_CRITICAL(&gainsMux);
+  g = gains;
+  portEXIT_CRITICAL(&gainsMux);
+
+  velocity = encoder_velocity();
+
+  float error = target - velocity;
+  float derivative = (error - lastError) / dt;
+  lastError = error;
+
+  float unclamped = g.kff * target + g.kp * error + g.ki * integral + g.kd * derivative;
+  float output = constrain(unclamped, -SPEED_MAX_DUTY, SPEED_MAX_DUTY);
+
+  // Anti-windup: only integrate while the output is not saturated, or when
+  // the error would pull it back out of saturation
+  bool saturated = output != unclamped;
+  if (!saturated || (error > 0) != (unclamped > 0)) {
+    integral += error * dt;
+  }
+
+  motor_set_output(output);
+  return output;
+}
+
+float speed_control_velocity()
+{
+  return velocity;
+}
+
+// Called from the comms task while the controller runs on the other core
+void speed_control_set_gains(const speed_gains_t *newGains)
+{
+  portENTER_CRITICAL(&gainsMux);
+  gains = *newGains;
+  portEXIT_CRITICAL(&gainsMux);
+}
+
+void speed_control_get_gains(speed_gains_t *out)
+{
+  portENTER_CRITICAL(&gainsMux);
+  *out = gains;
+  portEXIT_CRITICAL(&gainsMux);
+}
@@ -0,0 +1,30 @@
+#ifndef SPEED_CONTROL_H
+#define SPEED_CONTROL_H
+
+#include <Arduino.h>
+
+// Default gains, output is signed duty percent (-100..100)
+#define SPEED_KP 0.02f     // duty % per tick/s of error
+#define SPEED_KI 0.2f      // duty % per tick of accumulated error
+#define SPEED_KD 0.0f      // duty % per tick/s^2
+#define SPEED_KFF 0.01f    // duty % per tick/s of target (feed-forward)
+
+#define SPEED_MAX_DUTY 100.0f
+
+typedef struct {
+  float kp;
+  float ki;
+  float kd;
+  float kff;
+} speed_gains_t;
+
+void speed_control_init();
+void speed_control_reset();
+void speed_control_set_target(float ticks_per_s);
+float speed_control_update(float dt);
+float speed_control_velocity();
+
+void speed_control_set_gains(const speed_gains_t *gains);
+void speed_control_get_gains(speed_gains_t *gains);
+
+#endif
@@ -1,43 +1,175 @@
 #include "steering.h"
+
+#ifdef STEERING_BACKEND_LEDC
+#include "driver/ledc.h"
+
+#define STEERING_LEDC_TIMER LEDC_TIMER_2  // Timers 0,1 left free for other PWM users
+#define STEERING_LEDC_CHANNEL LEDC_CHANNEL_2
+#elif defined(STEERING_BACKEND_SERVO)
 #include <ESP32Servo.h>
 
 static Servo steeringServo;
-static int currentAngle = STEERING_CENTER;
+#else
+#include "sim/plant.h"
+#endif
+
+static int32_t currentCdeg = STEERING_CENTER * 100;
+
+static steering_cal_t cal = {
+  STEERING_CENTER, STEERING_LEFT, STEERING_RIGHT, STEERING_PULSE_MIN_US, STEERING_PULSE_MAX_US
+};
+static portMUX_TYPE calMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Also taken from the encoder interrupt by steering triggers
+static inline steering_cal_t get_cal()
+{
+  portENTER_CRITICAL_SAFE(&calMux);
+  steering_cal_t c = cal;
+  portEXIT_CRITICAL_SAFE(&calMux);
+  return c;
+}
+
+#ifdef STEERING_BACKEND_LEDC
+
+static void backend_init()
+{
+  ledc_timer_config_t timer = {};
+  timer.speed_mode = LEDC_LOW_SPEED_MODE;
+  timer.duty_resolution = (ledc_timer_bit_t)STEERING_LEDC_BITS;
+  timer.timer_num = STEERING_LEDC_TIMER;
+  timer.freq_hz = STEERING_REFRESH_HZ;
+  timer.clk_cfg = LEDC_AUTO_CLK;
+  ledc_timer_config(&timer);
+
+  ledc_channel_config_t channel = {};
+  channel.gpio_num = SERVO_PIN;
+  channel.speed_mode = LEDC_LOW_SPEED_MODE;
+  channel.channel = STEERING_LEDC_CHANNEL;
+  channel.timer_sel = STEERING_LEDC_TIMER;
+  channel.duty = 0;
+  channel.hpoint = 0;
+  ledc_channel_config(&channel);
+}
+
+// Pulse width to duty ticks in integer math:
+// ticks = pulse_us * 2^bits * freq / 1e6, rounded
+static void backend_write_us(uint16_t pulse_us)
+{
+  uint32_t duty = ((uint64_t)pulse_us * STEERING_REFRESH_HZ * (1UL << STEERING_LEDC_BITS) + 500000) / 1000000;
+  ledc_set_duty(LEDC_LOW_SPEED_MODE, STEERING_LEDC_CHANNEL, duty);
+  ledc_update_duty(LEDC_LOW_SPEED_MODE, STEERING_LEDC_CHANNEL);  // Latched at the next period
+}
+
+#elif defined(STEERING_BACKEND_SERVO)
+
+static void backend_init()
+{
+  ESP32PWM::allocateTimer(2);  // Use timer 2 for servo (timers 0,1 used by motor)
+  steeringServo.setPeriodHertz(50);
+  steeringServo.attach(SERVO_PIN, STEERING_PULSE_MIN_US, STEERING_PULSE_MAX_US);
+}
+
+static void backend_write_us(uint16_t pulse_us)
+{
+  steeringServo.writeMicroseconds(pulse_us);
+}
+
+#else  // STEERING_BACKEND_SIM
+
+static void backend_init()
+{
+}
 
-void steering_init()
+static void backend_write_us(uint16_t pulse_us)
+{
+  plant_set_servo_us(pulse_us);
+}
+
+#endif
+
+// settle = give the servo time to reach center before returning. Race mode
+// boots without it, the servo gets there before the first command anyway.
+void steering_init(bool settle)
 {
   // Set pin to known state before servo takes over
   pinMode(SERVO_PIN, OUTPUT);
   digitalWrite(SERVO_PIN, LOW);
-  delay(50);
+  if (settle) delay(50);
 
-  ESP32PWM::allocateTimer(2);  // Use timer 2 for servo (timers 0,1 used by motor)
-  steeringServo.setPeriodHertz(50);
-  steeringServo.attach(SERVO_PIN, 500, 2500);  // Min/max pulse width from servo spec
-  delay(50);
+  backend_init();
+  if (settle) delay(50);
   steering_center();
-  delay(100);  // Wait for servo to reach center
+  if (settle) delay(100);  // Wait for servo to reach center
+}
+
+void steering_set_us(uint16_t pulse_us)
+{
+  steering_cal_t c = get_cal();
+  if (pulse_us < c.pulse_min_us) pulse_us = c.pulse_min_us;
+  if (pulse_us > c.pulse_max_us) pulse_us = c.pulse_max_us;
+
+  // Keep the angle readback consistent with what the servo is told
+  currentCdeg = (int32_t)(pulse_us - c.pulse_min_us) * (STEERING_MAX - STEERING_MIN) * 100
+                / (c.pulse_max_us - c.pulse_min_us) + STEERING_MIN * 100;
+  backend_write_us(pulse_us);
+}
+
+// Angle in 0.01 degree, about 0.9 us of pulse per step
+void steering_set_cdeg(int32_t cdeg)
+{
+  steering_cal_t c = get_cal();
+  if (cdeg < STEERING_MIN * 100) cdeg = STEERING_MIN * 100;
+  if (cdeg > STEERING_MAX * 100) cdeg = STEERING_MAX * 100;
+  currentCdeg = cdeg;
+
+  int32_t pulse = c.pulse_min_us
+                  + ((cdeg - STEERING_MIN * 100) * (c.pulse_max_us - c.pulse_min_us)
+                     + (STEERING_MAX - STEERING_MIN) * 50) / ((STEERING_MAX - STEERING_MIN) * 100);
+  backend_write_us(pulse);
 }
 
 void steering_set(int angle)
 {
-  if (angle < STEERING_MIN) angle = STEERING_MIN;
-  if (angle > STEERING_MAX) angle = STEERING_MAX;
-  currentAngle = angle;
-  steeringServo.write(angle);
+  steering_set_cdeg((int32_t)angle * 100);
 }
 
 void steering_left()
 {
-  steering_set(STEERING_LEFT);
+  steering_set(get_cal().left);
 }
 
 void steering_right()
 {
-  steering_set(STEERING_RIGHT);
+  steering_set(get_cal().right);
 }
 
 void steering_center()
 {
-  steering_set(STEERING_CENTER);
+  steering_set(get_cal().center);
+}
+
+int steering_get()
+{
+  return (currentCdeg + 50) / 100;
+}
+
+int32_t steering_get_cdeg()
+{
+  return currentCdeg;
+}
+
+// Called from the comms task while the control task steers on the other core
+bool steering_set_cal(const steering_cal_t *newCal)
+{
+  if (newCal->pulse_min_us >= newCal->pulse_max_us) return false;
+  if (newCal->center < STEERING_MIN || newCal->center > STEERING_MAX) return false;
+  portENTER_CRITICAL(&calMux);
+  cal = *newCal;
+  portEXIT_CRITICAL(&calMux);
+  return true;
+}
+
+void steering_get_cal(steering_cal_t *out)
+{
+  *out = get_cal();
 }
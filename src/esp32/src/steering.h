@@ -6,17 +6,52 @@
 // Servo pin
 #define SERVO_PIN 38
 
-// Steering positions
+// Default steering positions, the live values come from the calibration store
 #define STEERING_CENTER 90
 #define STEERING_LEFT 10
 #define STEERING_RIGHT 180
 #define STEERING_MIN 0
 #define STEERING_MAX 180
 
-void steering_init();
+// Default servo pulse range from servo spec, mapped linearly onto STEERING_MIN..MAX
+#define STEERING_PULSE_MIN_US 500
+#define STEERING_PULSE_MAX_US 2500
+
+// Servo backend. The native LEDC driver is the default, build with
+// -DSTEERING_BACKEND_SERVO to go through the ESP32Servo library instead.
+// The native build (-DHAL_SIM) drives the simulated servo.
+#if defined(HAL_SIM)
+#define STEERING_BACKEND_SIM
+#elif !defined(STEERING_BACKEND_SERVO)
+#define STEERING_BACKEND_LEDC
+#endif
+
+// LEDC settings. 50 Hz is safe for any servo, digital servos accept up to
+// 333 Hz (period must stay above STEERING_PULSE_MAX_US).
+#ifndef STEERING_REFRESH_HZ
+#define STEERING_REFRESH_HZ 50
+#endif
+#define STEERING_LEDC_BITS 14  // Widest duty the S3 LEDC supports
+
+typedef struct {
+  int16_t center;         // deg
+  int16_t left;
+  int16_t right;
+  uint16_t pulse_min_us;  // Pulse at STEERING_MIN
+  uint16_t pulse_max_us;  // Pulse at STEERING_MAX
+} steering_cal_t;
+
+void steering_init(bool settle);
 void steering_set(int angle);
+void steering_set_cdeg(int32_t cdeg);
+void steering_set_us(uint16_t pulse_us);
 void steering_left();
 void steering_right();
 void steering_center();
+int steering_get();
+int32_t steering_get_cdeg();
+
+bool steering_set_cal(const steering_cal_t *cal);
+void steering_get_cal(steering_cal_t *cal);
 
 #endif
@@ -0,0 +1,74 @@
+#include "telemetry.h"
+#include "protocol.h"
+#include <atomic>
+
+static_assert(sizeof(telemetry_record_t) == 24, "telemetry record layout changed");
+static_assert((TELEMETRY_RING_SIZE & (TELEMETRY_RING_SIZE - 1)) == 0, "ring size must be a power of two");
+
+// Single producer (control task) / single consumer (telemetry task).
+// Indices run freely and are masked on access, head == tail means empty.
+static telemetry_record_t ring[TELEMETRY_RING_SIZE];
+static std::atomic<uint32_t> head(0);
+static std::atomic<uint32_t> tail(0);
+static std::atomic<uint32_t> overruns(0);
+static uint8_t nextSeq = 0;
+
+static uint8_t txBuffer[TELEMETRY_BATCH * TELEMETRY_FRAME_SIZE];
+
+void telemetry_init()
+{
+  head.store(0);
+  tail.store(0);
+  overruns.store(0);
+}
+
+// Producer side, never blocks. A full ring drops the record and counts it.
+bool telemetry_push(telemetry_record_t *record)
+{
+  uint32_t h = head.load(std::memory_order_relaxed);
+  if (h - tail.load(std::memory_order_acquire) >= TELEMETRY_RING_SIZE) {
+    overruns.fetch_add(1, std::memory_order_relaxed);
+    nextSeq++;  // Keep the gap visible on the Pi
+    return false;
+  }
+
+  record->seq = nextSeq++;
+  ring[h & (TELEMETRY_RING_SIZE - 1)] = *record;
+  head.store(h + 1, std::memory_order_release);
+  return true;
+}
+
+// Consumer side: frame queued records into batches and send each batch
+// with one write. Stops early when the serial TX buffer is full, the
+// records simply stay queued for the next call.
+void telemetry_drain()
+{
+  while (true) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    uint32_t queued = head.load(std::memory_order_acquire) - t;
+    if (queued == 0) return;
+
+    uint32_t room = Serial.availableForWrite() / TELEMETRY_FRAME_SIZE;
+    uint32_t n = queued;
+    if (n > TELEMETRY_BATCH) n = TELEMETRY_BATCH;
+    if (n > room) n = room;
+    if (n == 0) return;
+
+    uint8_t *out = txBuffer;
+    for (uint32_t i = 0; i < n; i++) {
+      const telemetry_record_t *record = &ring[(t + i) & (TELEMETRY_RING_SIZE - 1)];
+      out[0] = TELEMETRY_SYNC;
+      memcpy(out + 1, record, sizeof(*record));
+      out[TELEMETRY_FRAME_SIZE - 1] = proto_crc8(out + 1, sizeof(*record));
+      out += TELEMETRY_FRAME_SIZE;
+    }
+    tail.store(t + n, std::memory_order_release);
+
+    protocol_write(txBuffer, out - txBuffer);
+  }
+}
+
+uint32_t telemetry_overruns()
+{
+  return overruns.load(std::memory_order_relaxed);
+}
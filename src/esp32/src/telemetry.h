@@ -0,0 +1,69 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <Arduino.h>
+
+// Telemetry stream, ESP32 -> Pi, interleaved with protocol frames:
+//
+//   [0]      TELEMETRY_SYNC
+//   [1..24]  telemetry_record_t, little-endian
+//   [25]     CRC-8 over bytes [1..24]
+
+#define TELEMETRY_SYNC 0x5A
+#define TELEMETRY_FRAME_SIZE (sizeof(telemetry_record_t) + 2)
+
+#define TELEMETRY_RING_SIZE 256  // Records, power of two
+#define TELEMETRY_BATCH 16       // Records per serial write
+
+// Record types
+#define TELEM_STATE 0x01
+#define TELEM_ODOM 0x02
+#define TELEM_FAULT 0x03  // One record per detected fault
+
+// Record flags
+#define TELEM_FLAG_RUNNING 0x0001   // Motor driven
+#define TELEM_FLAG_VELOCITY 0x0002  // PID velocity mode
+#define TELEM_FLAG_STALL 0x0004     // Fault detected this tick, motor stopped (see TELEM_FAULT)
+#define TELEM_FLAG_FAILSAFE 0x0008  // Command watchdog tripped, waiting for the Pi
+#define TELEM_FLAG_TRAJECTORY 0x0010  // Playing back a queued trajectory
+#define TELEM_FLAG_BRAKING 0x0020   // Drive held off before a direction reversal
+#define TELEM_FLAG_MOVE 0x0040      // Distance move running
+
+typedef struct {
+  uint32_t time_us;
+  uint8_t type;    // TELEM_*
+  uint8_t seq;     // Per record, a gap on the Pi means records were dropped
+  uint16_t flags;  // TELEM_FLAG_*
+  union {
+    struct {
+      int32_t count;       // Encoder ticks
+      int32_t velocity;    // ticks/s
+      int16_t duty;        // 0.01 % of full duty, negative = reverse
+      int16_t steer_cdeg;  // 0.01 degree
+      uint32_t overruns;   // Records dropped because the ring was full
+    } state;
+    struct {
+      int32_t x;           // 0.1 mm
+      int32_t y;           // 0.1 mm
+      int16_t heading;     // 0.0001 rad
+      int16_t yaw_rate;    // 0.001 rad/s
+      uint32_t distance;   // mm
+    } odom;
+    struct {
+      uint8_t code;        // FAULT_*
+      uint8_t pad;
+      int16_t duty;        // 0.01 % at detection
+      int32_t velocity;    // ticks/s at detection
+      uint32_t duration;   // ms the condition held
+      int32_t count;       // Encoder ticks
+    } fault;
+    uint8_t raw[16];
+  };
+} telemetry_record_t;
+
+void telemetry_init();
+bool telemetry_push(telemetry_record_t *record);
+void telemetry_drain();
+uint32_t telemetry_overruns();
+
+#endif
@@ -0,0 +1,171 @@
+#include "trajectory.h"
+#include <atomic>
+
+static_assert((TRAJ_CAPACITY & (TRAJ_CAPACITY - 1)) == 0, "capacity must be a power of two");
+
+// Single producer (comms task pushes points) / single consumer (control
+// task plays them back). Start, stop and clear are requests picked up by
+// the consumer on its next tick so the control task owns all playback state.
+static traj_point_t points[TRAJ_CAPACITY];
+static std::atomic<uint32_t> head(0);
+static std::atomic<uint32_t> tail(0);
+static int32_t lastPushedKey = INT32_MIN;
+
+// Request bits, handled in the order clear, stop, start
+#define REQ_START 0x01
+#define REQ_STOP 0x02
+#define REQ_CLEAR 0x04
+
+static std::atomic<uint8_t> requests(0);
+static std::atomic<uint32_t> clearAt(0);  // head when clear was requested
+static uint8_t requestIndex = TRAJ_BY_TIME;
+static uint8_t requestMode = 0;
+
+// Consumer state
+static bool active = false;
+static std::atomic<bool> activeFlag(false);
+static uint8_t keyIndex = TRAJ_BY_TIME;
+static uint8_t mode = 0;
+static int64_t startTime = 0;
+static int64_t startCount = 0;
+
+static inline traj_point_t *slot(uint32_t i)
+{
+  return &points[i & (TRAJ_CAPACITY - 1)];
+}
+
+void trajectory_init()
+{
+  head.store(0);
+  tail.store(0);
+  lastPushedKey = INT32_MIN;
+  requests.store(0);
+  clearAt.store(0);
+  active = false;
+  activeFlag.store(false);
+}
+
+bool trajectory_push(const traj_point_t *point)
+{
+  uint32_t h = head.load(std::memory_order_relaxed);
+  if (h - tail.load(std::memory_order_acquire) >= TRAJ_CAPACITY) {
+    return false;  // Full
+  }
+  if (point->key <= lastPushedKey) {
+    return false;  // Keys must increase
+  }
+  *slot(h) = *point;
+  lastPushedKey = point->key;
+  head.store(h + 1, std::memory_order_release);
+  return true;
+}
+
+uint16_t trajectory_queued()
+{
+  return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+}
+
+uint16_t trajectory_free()
+{
+  return TRAJ_CAPACITY - trajectory_queued();
+}
+
+void trajectory_start(uint8_t newIndex, uint8_t newMode)
+{
+  requestIndex = newIndex;
+  requestMode = newMode;
+  requests.fetch_or(REQ_START, std::memory_order_release);
+}
+
+void trajectory_stop()
+{
+  requests.fetch_or(REQ_STOP, std::memory_order_release);
+}
+
+// Drops every point queued so far. Points pushed after this call survive,
+// the consumer only advances up to the head recorded here.
+void trajectory_clear()
+{
+  lastPushedKey = INT32_MIN;
+  clearAt.store(head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  requests.fetch_or(REQ_CLEAR, std::memory_order_release);
+}
+
+static void handle_requests(int64_t now_us, int64_t count)
+{
+  uint8_t pending = requests.exchange(0, std::memory_order_acquire);
+  if (!pending) return;
+
+  if (pending & REQ_CLEAR) {
+    tail.store(clearAt.load(std::memory_order_relaxed), std::memory_order_release);
+    active = false;
+  }
+  if (pending & REQ_STOP) {
+    active = false;
+  }
+  if (pending & REQ_START) {
+    keyIndex = requestIndex;
+    mode = requestMode;
+    startTime = now_us;
+    startCount = count;
+    active = true;
+  }
+  activeFlag.store(active, std::memory_order_relaxed);
+}
+
+// Setpoint for this tick, linearly interpolated between the two points
+// around the current key. Points behind the key are consumed. Returns
+// false when no trajectory is playing.
+bool trajectory_sample(int64_t now_us, int64_t count, traj_sample_t *out)
+{
+  handle_requests(now_us, count);
+  if (!active) {
+    return false;
+  }
+
+  int64_t travelled = count - startCount;
+  int32_t key = keyIndex == TRAJ_BY_TIME ? (int32_t)((now_us - startTime) / 1000)
+                                      : (int32_t)(travelled < 0 ? -travelled : travelled);
+
+  uint32_t t = tail.load(std::memory_order_relaxed);
+  uint32_t h = head.load(std::memory_order_acquire);
+  if (h == t) {
+    active = false;  // Started on an empty queue
+    activeFlag.store(false, std::memory_order_relaxed);
+    return false;
+  }
+
+  while (h - t >= 2 && slot(t + 1)->key <= key) {
+    t++;
+  }
+  tail.store(t, std::memory_order_release);
+
+  const traj_point_t *p0 = slot(t);
+  out->mode = mode;
+  out->last = (h - t == 1);
+
+  if (out->last || key <= p0->key) {
+    out->speed = p0->speed;
+    out->steer_cdeg = p0->steer_cdeg;
+    return true;
+  }
+
+  const traj_point_t *p1 = slot(t + 1);
+  int32_t span = p1->key - p0->key;
+  int32_t along = key - p0->key;
+  out->speed = p0->speed + (int32_t)(p1->speed - p0->speed) * along / span;
+  out->steer_cdeg = p0->steer_cdeg + (int32_t)(p1->steer_cdeg - p0->steer_cdeg) * along / span;
+  return true;
+}
+
+// A direct command took over, called from the control task
+void trajectory_abort()
+{
+  active = false;
+  activeFlag.store(false, std::memory_order_relaxed);
+}
+
+bool trajectory_active()
+{
+  return activeFlag.load(std::memory_order_relaxed);
+}
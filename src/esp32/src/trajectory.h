@@ -0,0 +1,40 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <Arduino.h>
+
+#define TRAJ_CAPACITY 128  // Points, power of two
+
+// What a point's key is measured in
+#define TRAJ_BY_TIME 0      // ms since trajectory_start()
+#define TRAJ_BY_DISTANCE 1  // Encoder ticks travelled since trajectory_start()
+
+typedef struct {
+  int32_t key;         // TRAJ_BY_* units, strictly increasing
+  int16_t speed;       // As control_command_t.speed for the trajectory's mode
+  int16_t steer_cdeg;  // 0.01 degree
+} traj_point_t;
+
+typedef struct {
+  uint8_t mode;        // CONTROL_MODE_*
+  int32_t speed;
+  int32_t steer_cdeg;
+  bool last;           // Holding the final queued point
+} traj_sample_t;
+
+void trajectory_init();
+
+// Comms task
+bool trajectory_push(const traj_point_t *point);
+uint16_t trajectory_queued();
+uint16_t trajectory_free();
+void trajectory_start(uint8_t keyIndex, uint8_t mode);
+void trajectory_stop();
+void trajectory_clear();
+
+// Control task
+bool trajectory_sample(int64_t now_us, int64_t count, traj_sample_t *out);
+void trajectory_abort();
+bool trajectory_active();
+
+#endif
@@ -0,0 +1,170 @@
+#include "trigger.h"
+#include "encoder.h"
+#include "steering.h"
+#include <atomic>
+
+typedef struct {
+  int64_t position;
+  int16_t value;
+  uint8_t action;
+  uint8_t seq;
+  int8_t side;  // 1 = fires at or above position, -1 = at or below
+} trigger_t;
+
+// Written by the comms task, fired from the edge interrupt or the control
+// task. Everything under triggerMux, which both contexts can take. The
+// interrupt path (on_compare down to encoder_set_compare) is all IRAM_ATTR
+// and calls no driver, so it is safe while flash is busy, e.g. an NVS save.
+static trigger_t slots[TRIGGER_SLOTS];
+static uint8_t armed = 0;
+static portMUX_TYPE triggerMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Fired triggers -> comms task
+static QueueHandle_t eventQueue = NULL;
+
+// Steering fired in the interrupt, cdeg for the control task. The steering
+// backends go through the LEDC / servo drivers, which live in flash.
+static std::atomic<int32_t> pendingSteer(-1);
+
+static void fire_due(int64_t count, int64_t edge_us, bool isr);
+
+static void IRAM_ATTR on_compare(int64_t count, int64_t edge_us)
+{
+  fire_due(count, edge_us, true);
+}
+
+// Nearest armed position on each side of the count. Caller holds triggerMux.
+static void IRAM_ATTR update_window()
+{
+  int64_t low = INT64_MIN;
+  int64_t high = INT64_MAX;
+  for (uint8_t i = 0; i < TRIGGER_SLOTS; i++) {
+    if (!(armed & (1 << i))) continue;
+    const trigger_t *t = &slots[i];
+    if (t->side > 0 && t->position < high) high = t->position;
+    if (t->side < 0 && t->position > low) low = t->position;
+  }
+
+  if (armed) {
+    encoder_set_compare(low, high, on_compare);
+  } else {
+    encoder_clear_compare();
+  }
+}
+
+static void IRAM_ATTR apply(const trigger_t *t, bool isr)
+{
+  if (t->action != TRIGGER_ACTION_STEER) return;
+  if (isr) {
+    pendingSteer.store(t->value);
+  } else {
+    steering_set_cdeg(t->value);
+  }
+}
+
+static void IRAM_ATTR fire_due(int64_t count, int64_t edge_us, bool isr)
+{
+  trigger_t fired[TRIGGER_SLOTS];
+  uint8_t ids[TRIGGER_SLOTS];
+  uint8_t n = 0;
+
+  portENTER_CRITICAL_SAFE(&triggerMux);
+  for (uint8_t i = 0; i < TRIGGER_SLOTS; i++) {
+    if (!(armed & (1 << i))) continue;
+    const trigger_t *t = &slots[i];
+    if ((t->side > 0 && count >= t->position) || (t->side < 0 && count <= t->position)) {
+      fired[n] = *t;
+      ids[n++] = i;
+      armed &= ~(1 << i);
+    }
+  }
+  if (n) update_window();
+  portEXIT_CRITICAL_SAFE(&triggerMux);
+
+  BaseType_t woken = pdFALSE;
+  for (uint8_t i = 0; i < n; i++) {
+    apply(&fired[i], isr);
+
+    trigger_event_t event;
+    event.seq = fired[i].seq;
+    event.id = ids[i];
+    event.action = fired[i].action;
+    event.count = (int32_t)count;
+    event.delay_us = edge_us ? (uint32_t)(esp_timer_get_time() - edge_us) : 0;
+    if (isr) {
+      xQueueSendFromISR(eventQueue, &event, &woken);
+    } else {
+      xQueueSend(eventQueue, &event, 0);
+    }
+  }
+  if (isr) portYIELD_FROM_ISR(woken);
+}
+
+void trigger_init()
+{
+  if (!eventQueue) {
+    eventQueue = xQueueCreate(TRIGGER_EVENT_QUEUE, sizeof(trigger_event_t));
+  }
+  trigger_clear_all();
+}
+
+bool trigger_set(uint8_t seq, uint8_t id, int64_t position, uint8_t action, int16_t value)
+{
+  if (id >= TRIGGER_SLOTS) return false;
+  if (action != TRIGGER_ACTION_NOTIFY && action != TRIGGER_ACTION_STEER) return false;
+
+  trigger_t t;
+  t.position = position;
+  t.value = value;
+  t.action = action;
+  t.seq = seq;
+  t.side = encoder_read64() < position ? 1 : -1;
+
+  portENTER_CRITICAL(&triggerMux);
+  slots[id] = t;
+  armed |= 1 << id;
+  update_window();
+  portEXIT_CRITICAL(&triggerMux);
+  return true;
+}
+
+bool trigger_clear(uint8_t id)
+{
+  if (id >= TRIGGER_SLOTS) return false;
+  portENTER_CRITICAL(&triggerMux);
+  armed &= ~(1 << id);
+  update_window();
+  portEXIT_CRITICAL(&triggerMux);
+  return true;
+}
+
+void trigger_clear_all()
+{
+  portENTER_CRITICAL(&triggerMux);
+  armed = 0;
+  update_window();
+  portEXIT_CRITICAL(&triggerMux);
+}
+
+uint8_t trigger_armed()
+{
+  portENTER_CRITICAL(&triggerMux);
+  uint8_t mask = armed;
+  portEXIT_CRITICAL(&triggerMux);
+  return mask;
+}
+
+bool trigger_poll_event(trigger_event_t *event)
+{
+  return xQueueReceive(eventQueue, event, 0) == pdTRUE;
+}
+
+// Catches what the interrupt cannot: a trigger set exactly at the count
+// with the wheel standing still, and steering left for the task
+void trigger_update(int64_t count, int64_t edge_us)
+{
+  fire_due(count, edge_us, false);
+
+  int32_t steer = pendingSteer.exchange(-1);
+  if (steer >= 0) steering_set_cdeg(steer);
+}
@@ -0,0 +1,44 @@
+#ifndef TRIGGER_H
+#define TRIGGER_H
+
+#include <Arduino.h>
+
+// Position triggers: "at tick X, do Y" without a serial round trip. The
+// armed triggers set the encoder compare window, so they fire from the
+// edge interrupt in the tick the count gets there (one quadrature cycle
+// with PCNT, one tick with the ISR backend). The control task checks the
+// same table every tick as a backstop, and writes the steering of
+// triggers the interrupt fired, at most one control period later.
+//
+// A trigger fires once, when the count reaches its position coming from
+// the side it was on when set; setting one at the current count fires it
+// on the next check.
+
+#define TRIGGER_SLOTS 8
+#define TRIGGER_EVENT_QUEUE 16
+
+// What a trigger does when it fires. Every trigger also reports.
+#define TRIGGER_ACTION_NOTIFY 0  // Report only
+#define TRIGGER_ACTION_STEER 1   // Steering to value (0.01 deg), held until the next command
+
+typedef struct {
+  uint8_t seq;       // Of the command that set it
+  uint8_t id;
+  uint8_t action;    // TRIGGER_ACTION_*
+  int32_t count;     // Encoder ticks when it fired
+  uint32_t delay_us; // Crossing edge to action
+} trigger_event_t;
+
+void trigger_init();
+
+// Comms task
+bool trigger_set(uint8_t seq, uint8_t id, int64_t position, uint8_t action, int16_t value);
+bool trigger_clear(uint8_t id);
+void trigger_clear_all();
+uint8_t trigger_armed();  // Bit per armed slot
+bool trigger_poll_event(trigger_event_t *event);
+
+// Control task, every tick
+void trigger_update(int64_t count, int64_t edge_us);
+
+#endif
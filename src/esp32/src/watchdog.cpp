@@ -0,0 +1,114 @@
+#include "watchdog.h"
+#include <atomic>
+
+// Times are the low 32 bits of esp_timer_get_time(), differences stay
+// correct across the 71 minute wrap and 32-bit loads are never torn.
+// Each histogram has exactly one writer: gaps the comms task, actuation
+// latency the control task. lastArrival is the comms task's, lastHold is
+// stored from both (feed resets it so it is never older than the
+// command), each store is a complete timestamp so either one winning is fine.
+
+static std::atomic<uint32_t> lastArrival(0);  // Newest command, for the gap histogram
+static std::atomic<uint32_t> lastHold(0);     // Newest command or hold, for the deadline
+static std::atomic<bool> armed(false);    // Set by a command, cleared on trip
+static std::atomic<bool> tripped(false);
+static std::atomic<uint32_t> deadlineUs(WATCHDOG_DEADLINE_MS * 1000UL);
+
+static uint32_t histograms[HIST_COUNT][WATCHDOG_HIST_BINS];
+static std::atomic<bool> clearRequested(false);
+
+static inline uint8_t bin_for(uint32_t us)
+{
+  if (us == 0) return 0;
+  uint8_t bin = 31 - __builtin_clz(us);
+  return bin < WATCHDOG_HIST_BINS ? bin : WATCHDOG_HIST_BINS - 1;
+}
+
+void watchdog_init()
+{
+  armed = false;
+  tripped = false;
+  memset(histograms, 0, sizeof(histograms));
+}
+
+// Comms task: a command frame just arrived
+void watchdog_feed(uint32_t arrival_us)
+{
+  if (armed.load()) {
+    histograms[HIST_COMMAND_GAP][bin_for(arrival_us - lastArrival.load())]++;
+  }
+  lastArrival.store(arrival_us);
+  lastHold.store(arrival_us);
+  armed.store(true);
+  tripped.store(false);
+}
+
+// Control task: input that is not a fresh command but still counts as
+// the Pi being in charge (a queued trajectory). Keeps an armed watchdog
+// from tripping without touching the gap histogram.
+void watchdog_hold(uint32_t now_us)
+{
+  if (armed.load()) {
+    lastHold.store(now_us);
+  }
+}
+
+// Control task: the command stamped arrival_us has been applied
+void watchdog_actuated(uint32_t arrival_us, uint32_t now_us)
+{
+  histograms[HIST_ACTUATION][bin_for(now_us - arrival_us)]++;
+}
+
+// Control task, every tick. Returns true once when the deadline passes,
+// the caller then puts the car in failsafe.
+bool watchdog_check(uint32_t now_us)
+{
+  if (clearRequested.exchange(false)) {
+    memset(histograms[HIST_ACTUATION], 0, sizeof(histograms[HIST_ACTUATION]));
+  }
+
+  if (!armed.load()) {
+    return false;
+  }
+  // Signed: a command stamped on the other core just after now_us is not
+  // late. The later of the command and the hold counts.
+  int32_t age = (int32_t)(now_us - lastArrival.load());
+  int32_t holdAge = (int32_t)(now_us - lastHold.load());
+  if (holdAge < age) age = holdAge;
+  if (age < (int32_t)deadlineUs.load()) {
+    return false;
+  }
+
+  armed.store(false);
+  tripped.store(true);
+  return true;
+}
+
+bool watchdog_tripped()
+{
+  return tripped.load();
+}
+
+void watchdog_set_deadline_ms(uint32_t ms)
+{
+  deadlineUs.store(ms * 1000UL);
+}
+
+uint32_t watchdog_get_deadline_ms()
+{
+  return deadlineUs.load() / 1000UL;
+}
+
+uint32_t watchdog_hist_bin(uint8_t hist, uint8_t bin)
+{
+  if (hist >= HIST_COUNT || bin >= WATCHDOG_HIST_BINS) return 0;
+  return histograms[hist][bin];
+}
+
+// Comms task. The actuation histogram belongs to the control task, so it
+// is cleared there on the next tick.
+void watchdog_hist_clear()
+{
+  memset(histograms[HIST_COMMAND_GAP], 0, sizeof(histograms[HIST_COMMAND_GAP]));
+  clearRequested.store(true);
+}
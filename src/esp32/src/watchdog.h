@@ -0,0 +1,30 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <Arduino.h>
+
+// Failsafe: stop and center when no Pi command arrived for this long
+#define WATCHDOG_DEADLINE_MS 250
+
+// Histograms use log2 buckets of microseconds: bin i counts values in
+// [2^i, 2^(i+1)) us, bin 0 also takes 0, the last bin takes everything above
+#define WATCHDOG_HIST_BINS 20
+
+#define HIST_COMMAND_GAP 0   // Time between consecutive Pi commands
+#define HIST_ACTUATION 1     // Command arrival to the control task applying it
+#define HIST_COUNT 2
+
+void watchdog_init();
+void watchdog_feed(uint32_t arrival_us);
+void watchdog_hold(uint32_t now_us);
+void watchdog_actuated(uint32_t arrival_us, uint32_t now_us);
+bool watchdog_check(uint32_t now_us);
+bool watchdog_tripped();
+
+void watchdog_set_deadline_ms(uint32_t ms);
+uint32_t watchdog_get_deadline_ms();
+
+uint32_t watchdog_hist_bin(uint8_t hist, uint8_t bin);
+void watchdog_hist_clear();
+
+#endif
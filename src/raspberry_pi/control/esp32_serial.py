@@ -0,0 +1,385 @@
+"""
+ESP32 serial link - binary protocol to the motor controller.
+
+The wire format lives in esp32/src/protocol.h and telemetry.h:
+
+    Pi -> ESP32 and replies:  A5 | type | seq | 8 byte payload | CRC-8
+    Telemetry stream:         5A | 24 byte telemetry_record_t | CRC-8
+
+The work is done by native.Esp32Link (C++): its own thread, non-blocking
+reads and writes, monotonic timestamps on every frame. Commands are
+pipelined - drive() returns as soon as the frame is written and never
+waits for the STATUS reply. The latest STATUS / STATE / ODOM can be read
+at any time without a lock:
+
+    esp = Esp32Serial("/dev/ttyACM0")
+    esp.open()
+    esp.drive(40, 90.0)          # 40 % forward, servo at 90 deg - no waiting
+    snap = esp.snapshot()
+    snap["state"]["velocity"]    # ticks/s from the latest STATE record
+    snap["status"]["rtt_ns"]     # round trip of the last command
+
+    esp.set_param(PARAM_SPEED_KP, 0.8)
+    esp.get_param(PARAM_SPEED_KP)  # the one call that waits for its reply
+
+Without the native module a pyserial thread does the same job, slower
+and with GIL jitter in the timestamps.
+"""
+
+import struct
+import threading
+import time
+from collections import deque
+
+import native
+
+# ── Protocol (mirrors esp32/src/protocol.h) ─────────────────────
+
+PROTO_SYNC = 0xA5
+PROTO_FRAME_SIZE = 12
+TELEMETRY_SYNC = 0x5A
+TELEMETRY_RECORD_SIZE = 24
+
+# Pi -> ESP32
+MSG_DRIVE = 0x01
+MSG_GET_SCHED = 0x02
+MSG_VELOCITY = 0x03
+MSG_SET_PARAM = 0x04
+MSG_GET_PARAM = 0x05
+MSG_GET_HIST = 0x06
+MSG_TRAJ_POINT = 0x07
+MSG_TRAJ_CTRL = 0x08
+MSG_ODOM_RESET = 0x09
+MSG_CALIBRATION = 0x0A
+MSG_MOVE = 0x0B
+MSG_TRIGGER_SET = 0x0C
+MSG_TRIGGER_CTRL = 0x0D
+MSG_GET_LOAD = 0x0E
+
+# ESP32 -> Pi
+MSG_STATUS = 0x81
+MSG_SCHED_STATS = 0x82
+MSG_PARAM = 0x83
+MSG_HIST = 0x84
+MSG_TRAJ_STATUS = 0x85
+MSG_CAL_STATUS = 0x86
+MSG_MOVE_DONE = 0x87
+MSG_TRIGGER_STATUS = 0x88
+MSG_TRIGGER_FIRED = 0x89
+MSG_LOAD = 0x8A
+MSG_TRACE = 0x8B
+
+# Telemetry record types
+TELEM_STATE = 0x01
+TELEM_ODOM = 0x02
+TELEM_FAULT = 0x03
+
+# A few parameters (full list in protocol.h)
+PARAM_SPEED_KP = 0x01
+PARAM_SPEED_KI = 0x02
+PARAM_SPEED_KD = 0x03
+PARAM_SPEED_KFF = 0x04
+PARAM_WATCHDOG_MS = 0x10
+
+REPLY_TIMEOUT = 0.2  # s, for the calls that do wait
+
+
+def crc8(data: bytes) -> int:
+    """CRC-8, polynomial 0x07, init 0 - same as proto_crc8()."""
+    crc = 0
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def decode_record(record: bytes, rx_ns: int) -> dict:
+    """telemetry_record_t bytes -> dict, same keys as the native link."""
+    time_us, rtype, seq, flags = struct.unpack_from("<IBBH", record)
+    d = {"rx_ns": rx_ns, "time_us": time_us, "type": rtype, "seq": seq, "flags": flags}
+    if rtype == TELEM_STATE:
+        keys = ("count", "velocity", "duty", "steer_cdeg", "overruns")
+        d.update(zip(keys, struct.unpack_from("<iihhI", record, 8)))
+    elif rtype == TELEM_ODOM:
+        keys = ("x", "y", "heading", "yaw_rate", "distance")
+        d.update(zip(keys, struct.unpack_from("<iihhI", record, 8)))
+    else:
+        d["raw"] = bytes(record[8:])
+    return d
+
+
+def encode_record(record: dict) -> bytes:
+    """decode_record() the other way: dict -> the 24 telemetry_record_t bytes."""
+    head = struct.pack("<IBBH", record["time_us"], record["type"], record["seq"], record["flags"])
+    if record["type"] == TELEM_STATE:
+        keys = ("count", "velocity", "duty", "steer_cdeg", "overruns")
+    elif record["type"] == TELEM_ODOM:
+        keys = ("x", "y", "heading", "yaw_rate", "distance")
+    else:
+        return head + record["raw"]
+    return head + struct.pack("<iihhI", *(record[k] for k in keys))
+
+
+class _PySerialLink:
+    """Fallback with the native Esp32Link interface, on pyserial."""
+
+    def __init__(self):
+        self._port = None
+        self._thread = None
+        self._running = False
+        self._lock = threading.Lock()
+        self._seq = 1
+        self._sent_ns = [0] * 256
+        self._snapshot = {"status": None, "state": None, "odom": None}
+        self._events = deque(maxlen=256)
+        self._loads = deque(maxlen=256)  # Streamed unasked, kept off the reply queue
+        self._telemetry = deque(maxlen=1024)
+        self._stats = {"tx_frames": 0, "rx_frames": 0, "rx_telemetry": 0, "crc_errors": 0,
+                       "events_dropped": 0, "loads_dropped": 0}
+        self.error = ""
+        self.telemetry_sink = None  # Called with each record, on the reader thread
+
+    @property
+    def is_open(self) -> bool:
+        return self._running
+
+    def open(self, device: str, baud: int = 115200):
+        import serial
+        self._port = serial.Serial(device, baud, timeout=0.05)
+        self._port.reset_input_buffer()
+        self._running = True
+        self._thread = threading.Thread(target=self._reader, daemon=True)
+        self._thread.start()
+
+    def close(self):
+        self._running = False
+        if self._thread:
+            self._thread.join(timeout=1.0)
+            self._thread = None
+        if self._port:
+            self._port.close()
+            self._port = None
+
+    def send(self, msg_type: int, payload: bytes = b"") -> int:
+        if not self._running:
+            return -1
+        with self._lock:
+            seq = self._seq
+            self._seq = 1 if seq == 255 else seq + 1
+            body = bytes([msg_type, seq]) + payload[:8].ljust(8, b"\0")
+            self._sent_ns[seq] = time.monotonic_ns()
+            self._port.write(bytes([PROTO_SYNC]) + body + bytes([crc8(body)]))
+            self._stats["tx_frames"] += 1
+        return seq
+
+    def snapshot(self) -> dict:
+        return dict(self._snapshot)
+
+    def poll_events(self, max: int = 64) -> list:
+        out = []
+        while self._events and len(out) < max:
+            out.append(self._events.popleft())
+        return out
+
+    def poll_loads(self, max: int = 64) -> list:
+        out = []
+        while self._loads and len(out) < max:
+            out.append(self._loads.popleft())
+        return out
+
+    def read_telemetry(self, max: int = 1024) -> list:
+        out = []
+        while self._telemetry and len(out) < max:
+            out.append(self._telemetry.popleft())
+        return out
+
+    def stats(self) -> dict:
+        return dict(self._stats)
+
+    def _reader(self):
+        buf = bytearray()
+        while self._running:
+            chunk = self._port.read(self._port.in_waiting or 1)
+            if not chunk:
+                continue
+            rx_ns = time.monotonic_ns()
+            buf += chunk
+            while buf:
+                if buf[0] not in (PROTO_SYNC, TELEMETRY_SYNC):
+                    del buf[0]
+                    continue
+                size = PROTO_FRAME_SIZE if buf[0] == PROTO_SYNC else TELEMETRY_RECORD_SIZE + 2
+                if len(buf) < size:
+                    break
+                if crc8(buf[1:size - 1]) != buf[size - 1]:
+                    self._stats["crc_errors"] += 1
+                    del buf[0]
+                    continue
+                self._handle(bytes(buf[:size]), rx_ns)
+                del buf[:size]
+
+    def _handle(self, frame: bytes, rx_ns: int):
+        if frame[0] == TELEMETRY_SYNC:
+            self._stats["rx_telemetry"] += 1
+            record = decode_record(frame[1:-1], rx_ns)
+            if record["type"] == TELEM_STATE:
+                self._snapshot["state"] = record
+            elif record["type"] == TELEM_ODOM:
+                self._snapshot["odom"] = record
+            self._telemetry.append(record)
+            if self.telemetry_sink:
+                self.telemetry_sink(record)
+            return
+
+        self._stats["rx_frames"] += 1
+        msg_type, seq, payload = frame[1], frame[2], frame[3:11]
+        sent = self._sent_ns[seq] if seq else 0
+        rtt_ns = rx_ns - sent if sent else -1
+        if msg_type == MSG_STATUS:
+            count, = struct.unpack_from("<i", payload)
+            self._snapshot["status"] = {"rx_ns": rx_ns, "rtt_ns": rtt_ns,
+                                        "count": count, "seq": seq}
+            return
+        queue = self._loads if msg_type == MSG_LOAD else self._events
+        if len(queue) == queue.maxlen:
+            self._stats["loads_dropped" if msg_type == MSG_LOAD else "events_dropped"] += 1
+        queue.append((msg_type, seq, payload, rx_ns, rtt_ns))
+
+
+class Esp32Serial:
+    """
+    Talks to the ESP32. Thread safe for sending; snapshot() from any
+    thread. events() / telemetry() drain queues, so call them from one
+    place only.
+    """
+
+    def __init__(self, device: str = "/dev/ttyACM0", baud: int = 115200):
+        self.device = device
+        self.baud = baud
+        self._link = native.Esp32Link() if native.AVAILABLE else _PySerialLink()
+        self._events = deque(maxlen=256)  # Seen while waiting for a reply
+        self._traces = deque(maxlen=256)  # MSG_TRACE frames, kept apart for traces()
+        self._request_lock = threading.Lock()
+        self.command_sink = None  # Called with (type, seq, payload, t_ns) per frame sent
+
+    def open(self):
+        """Open the port and start the link thread. Raises on failure."""
+        self._link.open(self.device, self.baud)
+        print(f"ESP32 link on {self.device} "
+              f"({'native' if native.AVAILABLE else 'pyserial'})")
+
+    def close(self):
+        self._link.close()
+
+    @property
+    def is_open(self) -> bool:
+        return self._link.is_open
+
+    @property
+    def link(self):
+        """The native.Esp32Link (or fallback) underneath, for WorldModel."""
+        return self._link
+
+    # ── Commands (pipelined: return the seq, don't wait) ─────────
+
+    def send(self, msg_type: int, payload: bytes = b"") -> int:
+        """Any frame. Returns its seq, -1 if the link is down."""
+        seq = self._link.send(msg_type, payload)
+        if self.command_sink and seq >= 0:
+            self.command_sink(msg_type, seq, payload, time.monotonic_ns())
+        return seq
+
+    def drive(self, speed: int, steer_deg: float, trace: int = 0) -> int:
+        """Open-loop duty -100..100 %, steering as servo angle in degrees.
+
+        trace: non-zero to get a MSG_TRACE back once the output is applied,
+        see control/latency.py.
+        """
+        return self.send(MSG_DRIVE, struct.pack("<hhH", speed, _cdeg(steer_deg), trace))
+
+    def velocity(self, ticks_per_s: int, steer_deg: float, trace: int = 0) -> int:
+        """Closed-loop speed target. trace as for drive()."""
+        return self.send(MSG_VELOCITY,
+                         struct.pack("<ihH", ticks_per_s, _cdeg(steer_deg), trace))
+
+    def move(self, distance: int, speed: int, steer_deg: float) -> int:
+        """Drive distance ticks and stop on the ESP32. MOVE_DONE comes later as an event."""
+        return self.send(MSG_MOVE, struct.pack("<iHh", distance, speed, _cdeg(steer_deg)))
+
+    def set_param(self, param: int, value: float) -> int:
+        return self.send(MSG_SET_PARAM, struct.pack("<Bxf", param, value))
+
+    def odom_reset(self) -> int:
+        return self.send(MSG_ODOM_RESET)
+
+    # ── Queries (wait for the reply with the same seq) ───────────
+
+    def get_param(self, param: int, timeout: float = REPLY_TIMEOUT) -> float | None:
+        frame = self.request(MSG_GET_PARAM, bytes([param]), MSG_PARAM, timeout)
+        if frame is None:
+            return None
+        return struct.unpack_from("<f", frame[2], 2)[0]
+
+    def request(self, msg_type: int, payload: bytes, reply_type: int,
+                timeout: float = REPLY_TIMEOUT):
+        """Send and wait for reply_type with our seq: (type, seq, payload, rx_ns, rtt_ns).
+
+        Other events that show up meanwhile are kept for events().
+        """
+        with self._request_lock:
+            seq = self.send(msg_type, payload)
+            if seq < 0:
+                return None
+            deadline = time.monotonic() + timeout
+            while time.monotonic() < deadline:
+                for event in self._link.poll_events():
+                    if event[0] == reply_type and event[1] == seq:
+                        return event
+                    self._keep(event)
+                time.sleep(0.0005)
+            return None
+
+    def _keep(self, event):
+        (self._traces if event[0] == MSG_TRACE else self._events).append(event)
+
+    # ── Incoming ─────────────────────────────────────────────────
+
+    def snapshot(self) -> dict:
+        """Latest "status", "state" and "odom" (None until received), no locking."""
+        return self._link.snapshot()
+
+    def events(self) -> list:
+        """Replies and events (MOVE_DONE, TRIGGER_FIRED...) since the last call; not LOAD."""
+        with self._request_lock:
+            for event in self._link.poll_events():
+                self._keep(event)
+            out = list(self._events)
+            self._events.clear()
+        return out
+
+    def traces(self) -> list:
+        """MSG_TRACE frames since the last call, as events(); events() never returns them."""
+        with self._request_lock:
+            for event in self._link.poll_events():
+                self._keep(event)
+            out = list(self._traces)
+            self._traces.clear()
+        return out
+
+    def loads(self) -> list:
+        """LOAD frames since the last call, as events(). Kept apart because
+        LOAD_STREAM sends them unasked and they would crowd out replies."""
+        return self._link.poll_loads()
+
+    def telemetry(self) -> list:
+        """Every telemetry record since the last call, oldest first."""
+        return self._link.read_telemetry()
+
+    def stats(self) -> dict:
+        return self._link.stats()
+
+
+def _cdeg(deg: float) -> int:
+    """Degrees -> int16 hundredths of a degree."""
+    return max(-32768, min(32767, int(round(deg * 100))))
@@ -0,0 +1,216 @@
+"""
+Latency tracing - camera exposure to motor PWM, per stage.
+
+Every frame already carries its capture time (Camera, see
+params.camera_latency_ms). The decision code passes the id of the frame
+it acted on along with the command:
+
+    tracer = LatencyTracer(camera, esp)
+    tracer.start()
+    ...
+    tracer.decided(frame_id)                         # optional, splits decide / send
+    esp.drive(speed, steer, trace=trace_id(frame_id))
+
+The ESP32 answers a traced DRIVE / VELOCITY with MSG_TRACE once its
+control task has written the new output: how long the command waited on
+the ESP32 for that (mailbox + control tick) and how long the reply then
+waited for the comms task. The link timestamps the reply against the
+command's send time, so what is left of that round trip is the wire both
+ways, and half of it the way out. No clock sync needed.
+
+The reply's flags say whether that output was really the command's. A
+trajectory point or distance move overriding it, or a fault / failsafe
+stopping the motor, means the PWM never showed the command: those traces
+are counted as skipped and kept out of the histograms. A ramping motion
+profile only took the first step towards it, which still is the
+command reaching the motor, so those count (and are counted as ramping).
+
+Stages, each a histogram:
+
+    detect   capture -> blobs published (exposure, read, detection)
+    decide   blobs published -> decided(), or -> command sent without it
+    send     decided() -> command on the link
+    link     command sent -> ESP32 comms task has it (half the wire time)
+    actuate  ESP32 has it -> PWM / servo written by the control task
+    total    capture -> PWM
+
+snapshot() is served at /api/latency.
+"""
+
+import struct
+import threading
+import time
+from collections import OrderedDict
+
+TRACE_FRAMES = 256      # Frames remembered for a command to refer to
+TRACE_PERIOD = 0.05     # s between polls of the link
+
+# MSG_TRACE flags, as TRACE_FLAG_* in esp32/src/control.h
+TRACE_FLAG_OVERRIDDEN = 0x01
+TRACE_FLAG_STOPPED = 0x02
+TRACE_FLAG_RAMPING = 0x04
+TRACE_NOT_APPLIED = TRACE_FLAG_OVERRIDDEN | TRACE_FLAG_STOPPED
+STAGES = ("detect", "decide", "send", "link", "actuate", "total")
+
+# Histogram bin upper bounds, ms, 1-2-5 steps; the last bin is open
+HIST_BOUNDS_MS = (0.1, 0.2, 0.5, 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000)
+
+
+def trace_id(frame_id: int) -> int:
+    """Frame id -> the 1..65535 trace id sent to the ESP32 (0 means untraced)."""
+    return (frame_id - 1) % 0xFFFF + 1
+
+
+class Histogram:
+    """Counts per HIST_BOUNDS_MS bin, plus exact count / mean / max."""
+
+    def __init__(self):
+        self.bins = [0] * (len(HIST_BOUNDS_MS) + 1)
+        self.count = 0
+        self.total_ms = 0.0
+        self.max_ms = 0.0
+
+    def add(self, ms: float):
+        i = 0
+        while i < len(HIST_BOUNDS_MS) and ms > HIST_BOUNDS_MS[i]:
+            i += 1
+        self.bins[i] += 1
+        self.count += 1
+        self.total_ms += ms
+        self.max_ms = max(self.max_ms, ms)
+
+    def percentile(self, p: float) -> float:
+        """Upper bound of the bin holding the p-th percentile (max if the open bin)."""
+        if not self.count:
+            return 0.0
+        need = p / 100 * self.count
+        seen = 0
+        for i, n in enumerate(self.bins):
+            seen += n
+            if seen >= need and n:
+                return HIST_BOUNDS_MS[i] if i < len(HIST_BOUNDS_MS) else self.max_ms
+        return self.max_ms
+
+    def to_dict(self) -> dict:
+        return {
+            "count": self.count,
+            "mean_ms": self.total_ms / self.count if self.count else 0.0,
+            "p50_ms": self.percentile(50),
+            "p95_ms": self.percentile(95),
+            "p99_ms": self.percentile(99),
+            "max_ms": self.max_ms,
+            "bins": [[bound, n] for bound, n in zip(list(HIST_BOUNDS_MS) + [None], self.bins)],
+        }
+
+
+class LatencyTracer:
+    """Pairs camera frames with the MSG_TRACE replies to commands sent for them."""
+
+    def __init__(self, camera, esp):
+        self.camera = camera
+        self.esp = esp
+        self._lock = threading.Lock()
+        self._frames = OrderedDict()  # trace id -> [capture ns, published ns, decided ns]
+        self._hist = {name: Histogram() for name in STAGES}
+        self._last = None
+        self.unmatched = 0  # Traces whose frame was no longer remembered
+        self.skipped = 0    # Traces whose command never reached the PWM
+        self.ramping = 0    # Traces timed to the first step of a ramp
+        self._running = False
+        self._thread = None
+
+    @property
+    def is_running(self) -> bool:
+        return self._running
+
+    def start(self):
+        self._running = True
+        self.camera.subscribe(self._on_frame)
+        self._thread = threading.Thread(target=self._loop, daemon=True)
+        self._thread.start()
+
+    def stop(self):
+        self._running = False
+        self.camera.unsubscribe(self._on_frame)
+        if self._thread:
+            self._thread.join(timeout=1.0)
+            self._thread = None
+
+    def decided(self, frame_id: int, t_ns: int | None = None):
+        """The decision for frame_id is made (now, or at t_ns)."""
+        t_ns = time.monotonic_ns() if t_ns is None else t_ns
+        with self._lock:
+            entry = self._frames.get(trace_id(frame_id))
+            if entry is not None:
+                entry[2] = t_ns
+
+    def reset(self):
+        with self._lock:
+            self._hist = {name: Histogram() for name in STAGES}
+            self._last = None
+            self.unmatched = 0
+            self.skipped = 0
+            self.ramping = 0
+
+    def snapshot(self) -> dict:
+        """Histograms per stage, and the stages of the latest trace."""
+        with self._lock:
+            return {
+                "stages": {name: h.to_dict() for name, h in self._hist.items()},
+                "last": self._last,
+                "unmatched": self.unmatched,
+                "skipped": self.skipped,
+                "ramping": self.ramping,
+            }
+
+    # ── Internals ────────────────────────────────────────────────
+
+    def _on_frame(self, frame_id: int, t_ns: int, blobs, image):
+        """Camera thread, right after detection."""
+        now = time.monotonic_ns()
+        with self._lock:
+            self._frames[trace_id(frame_id)] = [t_ns, now, None]
+            while len(self._frames) > TRACE_FRAMES:
+                self._frames.popitem(last=False)
+
+    def _loop(self):
+        while self._running:
+            for event in self.esp.traces():
+                self.add_trace(event)
+            time.sleep(TRACE_PERIOD)
+
+    def add_trace(self, event):
+        """One MSG_TRACE event: (type, seq, payload, rx_ns, rtt_ns)."""
+        _, _, payload, rx_ns, rtt_ns = event
+        if rtt_ns < 0:
+            return
+        trace, apply_us, held_us, flags = struct.unpack_from("<HHHB", payload)
+        if flags & TRACE_NOT_APPLIED:
+            with self._lock:
+                self.skipped += 1
+            return
+        apply_ns = apply_us * 1000
+        held_ns = held_us * 1000
+        sent_ns = rx_ns - rtt_ns
+        link_ns = max(rtt_ns - apply_ns - held_ns, 0) // 2
+
+        with self._lock:
+            entry = self._frames.get(trace)
+            if entry is None:
+                self.unmatched += 1
+                return
+            capture_ns, published_ns, decided_ns = entry
+            stages = {
+                "detect": published_ns - capture_ns,
+                "decide": (decided_ns or sent_ns) - published_ns,
+                "link": link_ns,
+                "actuate": apply_ns,
+                "total": sent_ns + link_ns + apply_ns - capture_ns,
+            }
+            if decided_ns is not None:
+                stages["send"] = sent_ns - decided_ns
+            if flags & TRACE_FLAG_RAMPING:
+                self.ramping += 1
+            for name, ns in stages.items():
+                self._hist[name].add(ns / 1e6)
+            self._last = {"trace": trace, **{k + "_ms": v / 1e6 for k, v in stages.items()}}
@@ -10,19 +10,31 @@ What's new:
 
 Run:
     python main.py
+    python main.py --record runs/today.wlog   # also log the run for replay
+    python main.py --record runs/today.wlog --raw   # frames uncompressed
 
 Then open http://localhost:8080 in your browser.
 Move the sliders and watch the camera stream change in real time.
 """
 
+import argparse
 import asyncio
 
+from control.esp32_serial import Esp32Serial
+from control.latency import LatencyTracer
+from perception.fusion import WorldModel
+from recording.recorder import Recorder
 from sensors.camera import Camera
 from params import Parameters
 from server import run_server
 
 
 def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--record", metavar="LOG", help="record the run (see recording/)")
+    parser.add_argument("--raw", action="store_true", help="record raw frames, not JPEG")
+    args = parser.parse_args()
+
     # Load parameters (from params.json if it exists, else defaults)
     params = Parameters.load()
     print(f"Parameters loaded: min_area={params.min_area}")
@@ -32,9 +44,41 @@ def main():
     camera = Camera(params)
     camera.start()
 
+    # Odometry for the world model, if the ESP32 is plugged in
+    esp = Esp32Serial()
+    try:
+        esp.open()
+    except (ImportError, OSError, RuntimeError) as e:
+        print(f"ESP32 not connected ({e}), world model without odometry")
+        esp = None
+
+    world = WorldModel(camera, esp)
+    world.start()
+
+    # Frame -> PWM latency of commands sent with a trace id
+    tracer = None
+    if esp:
+        tracer = LatencyTracer(camera, esp)
+        tracer.start()
+
+    recorder = None
+    if args.record:
+        recorder = Recorder(args.record, camera, esp, params, "raw" if args.raw else "jpeg")
+        recorder.start()
+
+    def shutdown():
+        if recorder:
+            recorder.stop()
+        if tracer:
+            tracer.stop()
+        world.stop()
+        camera.stop()
+        if esp:
+            esp.close()
+
     async def run():
         # Server also gets the same params object
-        runner = await run_server(camera, params)
+        runner = await run_server(camera, params, world, tracer)
         print("Press Ctrl+C to stop")
         try:
             while True:
@@ -42,13 +86,13 @@ def main():
         except asyncio.CancelledError:
             pass
         finally:
-            camera.stop()
+            shutdown()
             await runner.cleanup()
 
     try:
         asyncio.run(run())
     except KeyboardInterrupt:
-        camera.stop()
+        shutdown()
 
 
 if __name__ == "__main__":
@@ -0,0 +1,132 @@
+"""
+Native kernels - C++ versions of the per-frame hot loops.
+
+Optional. Build once (see native/setup.py):
+
+    python native/setup.py build_ext --inplace
+
+If the extension isn't built, or WRO_NATIVE=0 is set, AVAILABLE is False
+and callers keep using their OpenCV path. The masks are the same, and so
+are blob boxes and areas: detect_blobs opens the masks and measures
+areas as Camera._find_blobs does with OpenCV. Where they can differ:
+
+  - ColorLut below 8 bits flips a few pixels on range edges
+  - detect_blobs with scale > 1 may miss a blob the coarse pass sampled
+    badly, and opens only a window around each candidate
+  - a border that touches itself (blobs joined at one corner pixel) can
+    be traced on a different path than OpenCV's, giving another area
+  - a blob inside a hole of another blob of the same colour (a green
+    pillar seen through a green ring) is reported here, while
+    cv2.RETR_EXTERNAL keeps only the outer one
+"""
+
+import os
+import time
+
+import numpy as np
+
+UNAVAILABLE_REASON = ""
+
+try:
+    if os.environ.get("WRO_NATIVE", "1") == "0":
+        raise ImportError("disabled by WRO_NATIVE=0")
+    from native import _native
+    AVAILABLE = True
+    # Only there when libjpeg-turbo was found at build time
+    JPEG_AVAILABLE = hasattr(_native, "encode_jpeg")
+except ImportError as e:
+    _native = None
+    AVAILABLE = False
+    JPEG_AVAILABLE = False
+    UNAVAILABLE_REASON = str(e)
+
+
+def classify_hsv(frame, colors):
+    """One pass over a BGR frame -> list of 0/255 masks, one per color.
+
+    colors: for each color, a list of (h_lo, s_lo, v_lo, h_hi, s_hi, v_hi)
+    ranges that are OR'ed together (red has two because hue wraps).
+    Same result as cv2.cvtColor(BGR2HSV) followed by cv2.inRange per range.
+    colors can also be a ColorLut, which classifies by table lookup.
+    """
+    return _native.classify_hsv(frame, colors)
+
+
+def detect_blobs(frame, colors, roi=None, scale=1, min_area=0):
+    """Blobs of each color inside roi, as (color_index, x, y, w, h, area).
+
+    roi is (x, y, width, height) in frame pixels, None for the whole frame.
+    x, y is the bounding box top-left. The masks are opened first (5x5
+    erode, 5x5 dilate twice) and area is cv2.contourArea of the outer
+    border, both as Camera._find_blobs; min_area applies to that. scale 2-4
+    finds candidates on a subsampled copy first and only measures those at
+    full resolution, so most of the ROI costs 1/scale^2. colors can also
+    be a ColorLut.
+    """
+    return _native.detect_blobs(frame, colors, roi, scale, min_area)
+
+
+def encode_jpeg(image, quality=80, scale=1):
+    """BGR (HxWx3) or gray (HxW) image -> JPEG bytes, via libjpeg-turbo.
+
+    scale 2-4 shrinks the image first (box filter). Runs without the GIL.
+    """
+    return _native.encode_jpeg(image, quality, scale)
+
+
+class _PyFrame:
+    """Fallback Frame: a fresh array per capture, shared (not copied) once published."""
+
+    def __init__(self, array):
+        self.array = array
+        self.id = 0
+        self.slot = -1
+
+
+class _PyFramePool:
+    """Same interface as the native FramePool, without the preallocation.
+
+    A published frame is never written again, so readers can share it
+    as-is. Memory comes back through normal garbage collection.
+    """
+
+    def __init__(self, slots, height, width, channels=3):
+        self.shape = (height, width, channels)
+        self._latest = None
+
+    def acquire(self):
+        return _PyFrame(np.empty(self.shape, np.uint8))
+
+    def publish(self, frame, id):
+        frame.id = id
+        frame.array.setflags(write=False)
+        self._latest = frame
+
+    def latest(self):
+        return self._latest
+
+
+# FramePool(slots, height, width, channels=3):
+#   acquire() -> Frame to fill (frame.array is writable), None if all held
+#   publish(frame, id) -> frame becomes the latest and read-only
+#   latest() -> newest published Frame, or None
+# A Frame's slot is reused only after the Frame and every array taken
+# from it are gone.
+FramePool = _native.FramePool if AVAILABLE else _PyFramePool
+
+# Esp32Link(): threaded serial link to the ESP32, see control/esp32_serial.py
+Esp32Link = _native.Esp32Link if AVAILABLE else None
+
+# ColorLut(bits=6): BGR -> colour bitmask table for classify_hsv /
+# detect_blobs. update(colors) rebuilds only the colours that changed, on a
+# thread, and swaps the new table in. Each channel is cut to bits, so at 6
+# a pixel is classified by the centre of its 4x4x4 cell; 8 is exact.
+ColorLut = _native.ColorLut if AVAILABLE else None
+
+# Fusion(): time-aligned odometry / camera / LIDAR, see perception/fusion.py
+Fusion = _native.Fusion if AVAILABLE else None
+
+
+def monotonic_ns():
+    """CLOCK_MONOTONIC in ns, the clock every native timestamp uses."""
+    return _native.monotonic_ns() if AVAILABLE else time.monotonic_ns()
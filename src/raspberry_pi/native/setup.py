@@ -0,0 +1,67 @@
+"""
+Build the native kernels in place, next to native/__init__.py:
+
+    cd src/raspberry_pi
+    python native/setup.py build_ext --inplace
+
+Needs a C++17 compiler and pybind11 (in requirements.txt). On the Pi the
+kernels compile for its own CPU so the inner loops use NEON.
+"""
+
+import os
+import platform
+
+from pybind11.setup_helpers import Pybind11Extension, build_ext
+from setuptools import setup
+
+# Run from src/raspberry_pi so the module lands in native/
+HERE = os.path.dirname(os.path.abspath(__file__))
+os.chdir(os.path.dirname(HERE))
+
+flags = ["-O3"]
+machine = platform.machine()
+if machine in ("aarch64", "arm64"):
+    flags.append("-mcpu=native")
+elif machine.startswith("armv7"):
+    flags += ["-mcpu=native", "-mfpu=neon-vfpv4", "-mfloat-abi=hard"]
+
+# Stream JPEG encoding needs libjpeg-turbo's TurboJPEG API
+# (apt install libturbojpeg0-dev). Without it encode_jpeg is left out and
+# the camera falls back to cv2.imencode.
+TURBOJPEG_HEADERS = ["/usr/include/turbojpeg.h", "/usr/local/include/turbojpeg.h"]
+macros = []
+libraries = []
+for header in TURBOJPEG_HEADERS:
+    if os.path.exists(header):
+        macros.append(("WRO_TURBOJPEG", "1"))
+        libraries.append("turbojpeg")
+        break
+else:
+    print("turbojpeg.h not found, building without encode_jpeg")
+
+SOURCES = [
+    "native/src/detect.cpp",
+    "native/src/esp32_link.cpp",
+    "native/src/frame_pool.cpp",
+    "native/src/fusion.cpp",
+    "native/src/jpeg.cpp",
+    "native/src/lut.cpp",
+    "native/src/module.cpp",
+    "native/src/vision.cpp",
+]
+
+setup(
+    name="wro-native",
+    ext_modules=[
+        Pybind11Extension(
+            "native._native",
+            SOURCES,
+            include_dirs=["native/src"],
+            define_macros=macros,
+            libraries=libraries,
+            cxx_std=17,
+            extra_compile_args=flags,
+        ),
+    ],
+    cmdclass={"build_ext": build_ext},
+)
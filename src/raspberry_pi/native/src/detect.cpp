@@ -0,0 +1,389 @@
+#include "detect.h"
+
+#include <string.h>
+
+namespace native {
+
+// A horizontal stretch of set pixels, end exclusive
+struct Run {
+  int x0, x1;
+  int label;
+};
+
+struct Stats {
+  int x0, y0, x1, y1;  // Inclusive
+  int area;
+  int sx, sy;          // First pixel in raster order, where the border trace starts
+};
+
+static int find_root(std::vector<int> &parent, int i)
+{
+  while (parent[i] != i) {
+    parent[i] = parent[parent[i]];
+    i = parent[i];
+  }
+  return i;
+}
+
+// Masks are mostly long stretches of 0x00 or 0xFF, so skip those 8 bytes
+// at a time
+static int skip_value(const uint8_t *row, int x, int width, uint8_t value)
+{
+  uint64_t word = value ? ~0ull : 0;
+  while (x + 8 <= width) {
+    uint64_t chunk;
+    memcpy(&chunk, row + x, 8);
+    if (chunk != word) break;
+    x += 8;
+  }
+  if (value) {
+    while (x < width && row[x]) x++;
+  } else {
+    while (x < width && !row[x]) x++;
+  }
+  return x;
+}
+
+// Neighbours counterclockwise on screen (y down), from east
+static const int DIR_X[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+static const int DIR_Y[8] = { 0, -1, -1, -1, 0, 1, 1, 1 };
+
+// cv2.contourArea of the outer border cv2.findContours traces from (sx, sy),
+// the component's first pixel (Suzuki & Abe, 8-connected): same path, and
+// the shoelace over its pixel centres. Beyond the edge counts as 0.
+static double outer_border_area(const uint8_t *mask, int width, int height, size_t stride,
+                                int sx, int sy)
+{
+  auto set = [&](int x, int y) {
+    return x >= 0 && y >= 0 && x < width && y < height && mask[y * stride + x];
+  };
+
+  // First neighbour clockwise from the west, which is 0 for a first pixel
+  int d1 = -1;
+  for (int k = 0; k < 8; k++) {
+    int d = (4 - k + 8) & 7;
+    if (set(sx + DIR_X[d], sy + DIR_Y[d])) {
+      d1 = d;
+      break;
+    }
+  }
+  if (d1 < 0) return 0;  // A lone pixel
+  int x1 = sx + DIR_X[d1], y1 = sy + DIR_Y[d1];
+
+  // Walk counterclockwise around each border pixel, starting just past
+  // the one we came from, until back at the start heading for (x1, y1)
+  int x = sx, y = sy;
+  int from = d1;  // Direction from (x, y) to the previous pixel
+  long long twice = 0;
+  while (true) {
+    int d = from;
+    for (int k = 0; k < 8; k++) {
+      d = (d + 1) & 7;
+      if (set(x + DIR_X[d], y + DIR_Y[d])) break;
+    }
+    int nx = x + DIR_X[d], ny = y + DIR_Y[d];
+    twice += (long long)x * ny - (long long)nx * y;
+    if (nx == sx && ny == sy && x == x1 && y == y1) break;
+    from = (d + 4) & 7;
+    x = nx;
+    y = ny;
+  }
+  return (twice < 0 ? -twice : twice) * 0.5;
+}
+
+void label_components(const uint8_t *mask, int width, int height, size_t stride,
+                      int min_area, int color, bool contour, std::vector<Blob> *out)
+{
+  std::vector<int> parent;
+  std::vector<Stats> stats;
+  std::vector<Run> prev, cur;
+
+  for (int y = 0; y < height; y++) {
+    const uint8_t *row = mask + y * stride;
+    cur.clear();
+    size_t j = 0;  // First run in prev that can still touch
+
+    int x = 0;
+    while (true) {
+      x = skip_value(row, x, width, 0);
+      if (x >= width) break;
+      int x0 = x;
+      x = skip_value(row, x, width, 0xFF);
+      int x1 = x;
+
+      // 8-connected: prev runs touching [x0 - 1, x1] join this one
+      while (j < prev.size() && prev[j].x1 < x0) j++;
+      int label = -1;
+      for (size_t k = j; k < prev.size() && prev[k].x0 <= x1; k++) {
+        int root = find_root(parent, prev[k].label);
+        if (label < 0) {
+          label = root;
+        } else if (root != label) {
+          // Keep the lower label as root, it was seen first
+          if (root < label) {
+            parent[label] = root;
+            label = root;
+          } else {
+            parent[root] = label;
+          }
+        }
+      }
+
+      if (label < 0) {
+        label = (int)parent.size();
+        parent.push_back(label);
+        stats.push_back({ x0, y, x1 - 1, y, 0, x0, y });
+      }
+
+      Stats &st = stats[label];
+      if (x0 < st.x0) st.x0 = x0;
+      if (x1 - 1 > st.x1) st.x1 = x1 - 1;
+      st.y1 = y;
+      st.area += x1 - x0;
+      cur.push_back({ x0, x1, label });
+    }
+    prev.swap(cur);
+  }
+
+  // Fold merged labels straight into their final roots
+  for (size_t i = 0; i < parent.size(); i++) {
+    int root = find_root(parent, (int)i);
+    if (root == (int)i) continue;
+    Stats &r = stats[root];
+    const Stats &s = stats[i];
+    if (s.x0 < r.x0) r.x0 = s.x0;
+    if (s.y0 < r.y0) r.y0 = s.y0;
+    if (s.x1 > r.x1) r.x1 = s.x1;
+    if (s.y1 > r.y1) r.y1 = s.y1;
+    r.area += s.area;
+  }
+
+  // Roots are the lowest label of their component, so their first run is
+  // the component's first in raster order and (sx, sy) its first pixel
+  for (size_t i = 0; i < parent.size(); i++) {
+    if (parent[i] != (int)i) continue;
+    const Stats &s = stats[i];
+    double area = contour ? outer_border_area(mask, width, height, stride, s.sx, s.sy) : s.area;
+    if (area < min_area) continue;
+    out->push_back({ color, s.x0, s.y0, s.x1 - s.x0 + 1, s.y1 - s.y0 + 1, (int)area });
+  }
+}
+
+// Binary square filter, separable: a row pass into tmp counting set pixels
+// in the clipped window, then a column pass back. erode keeps a pixel when
+// the whole clipped window is set, dilate when any of it is.
+static void square_filter(uint8_t *mask, int width, int height, size_t stride, int radius,
+                          bool erode)
+{
+  std::vector<uint8_t> tmp((size_t)width * height);
+  for (int y = 0; y < height; y++) {
+    const uint8_t *row = mask + y * stride;
+    uint8_t *dst = tmp.data() + (size_t)y * width;
+    int count = 0;
+    for (int x = 0; x < radius && x < width; x++) count += row[x] != 0;
+    for (int x = 0; x < width; x++) {
+      if (x + radius < width) count += row[x + radius] != 0;
+      if (x - radius - 1 >= 0) count -= row[x - radius - 1] != 0;
+      int lo = x - radius < 0 ? 0 : x - radius;
+      int hi = x + radius >= width ? width - 1 : x + radius;
+      dst[x] = (erode ? count == hi - lo + 1 : count > 0) ? 0xFF : 0;
+    }
+  }
+
+  std::vector<int> counts(width, 0);
+  for (int y = 0; y < radius && y < height; y++) {
+    const uint8_t *src = tmp.data() + (size_t)y * width;
+    for (int x = 0; x < width; x++) counts[x] += src[x] != 0;
+  }
+  for (int y = 0; y < height; y++) {
+    if (y + radius < height) {
+      const uint8_t *add = tmp.data() + (size_t)(y + radius) * width;
+      for (int x = 0; x < width; x++) counts[x] += add[x] != 0;
+    }
+    if (y - radius - 1 >= 0) {
+      const uint8_t *sub = tmp.data() + (size_t)(y - radius - 1) * width;
+      for (int x = 0; x < width; x++) counts[x] -= sub[x] != 0;
+    }
+    int lo = y - radius < 0 ? 0 : y - radius;
+    int hi = y + radius >= height ? height - 1 : y + radius;
+    int full = hi - lo + 1;
+    uint8_t *out = mask + y * stride;
+    for (int x = 0; x < width; x++) {
+      out[x] = (erode ? counts[x] == full : counts[x] > 0) ? 0xFF : 0;
+    }
+  }
+}
+
+void erode_mask(uint8_t *mask, int width, int height, size_t stride, int radius)
+{
+  square_filter(mask, width, height, stride, radius, true);
+}
+
+void dilate_mask(uint8_t *mask, int width, int height, size_t stride, int radius)
+{
+  square_filter(mask, width, height, stride, radius, false);
+}
+
+static Roi clip(Roi r, const Roi &bound)
+{
+  int x1 = r.x + r.width, y1 = r.y + r.height;
+  if (r.x < bound.x) r.x = bound.x;
+  if (r.y < bound.y) r.y = bound.y;
+  if (x1 > bound.x + bound.width) x1 = bound.x + bound.width;
+  if (y1 > bound.y + bound.height) y1 = bound.y + bound.height;
+  r.width = x1 > r.x ? x1 - r.x : 0;
+  r.height = y1 > r.y ? y1 - r.y : 0;
+  return r;
+}
+
+static bool overlaps(const Roi &a, const Roi &b)
+{
+  return a.x < b.x + b.width && b.x < a.x + a.width &&
+         a.y < b.y + b.height && b.y < a.y + a.height;
+}
+
+static Roi merge(const Roi &a, const Roi &b)
+{
+  int x0 = a.x < b.x ? a.x : b.x;
+  int y0 = a.y < b.y ? a.y : b.y;
+  int x1 = a.x + a.width > b.x + b.width ? a.x + a.width : b.x + b.width;
+  int y1 = a.y + a.height > b.y + b.height ? a.y + a.height : b.y + b.height;
+  return { x0, y0, x1 - x0, y1 - y0 };
+}
+
+// How pixels are classified: by the HSV ranges, or by a table built from
+// them, which then has the same colours
+struct Classifier {
+  const std::vector<ColorSpec> &colors;
+  const LutTable *lut;
+  std::vector<ColorSpec> one;  // Scratch for a single colour by range
+};
+
+// Classify and label one rectangle of the frame, every colour or only
+// the one given. open: at full resolution, with the opening and contour
+// areas; otherwise the coarse pass, raw masks and pixel counts.
+static void detect_full(const uint8_t *bgr, size_t bgr_stride, Classifier &cls, int only,
+                        Roi roi, int min_area, bool open, std::vector<uint8_t> &buf,
+                        std::vector<Blob> *out)
+{
+  size_t count = only >= 0 ? 1 : cls.colors.size();
+  size_t plane = (size_t)roi.width * roi.height;
+  buf.resize(plane * count);
+  uint8_t *masks[VISION_MAX_COLORS];
+  for (size_t c = 0; c < count; c++) masks[c] = buf.data() + c * plane;
+
+  const uint8_t *origin = bgr + roi.y * bgr_stride + roi.x * 3;
+  if (cls.lut) {
+    classify_lut(origin, roi.width, roi.height, bgr_stride, *cls.lut, only, masks, roi.width);
+  } else if (only >= 0) {
+    cls.one.assign(1, cls.colors[only]);
+    classify_hsv(origin, roi.width, roi.height, bgr_stride, cls.one, masks, roi.width);
+  } else {
+    classify_hsv(origin, roi.width, roi.height, bgr_stride, cls.colors, masks, roi.width);
+  }
+
+  for (size_t c = 0; c < count; c++) {
+    size_t first = out->size();
+    int color = only >= 0 ? only : (int)c;
+    if (open) {
+      erode_mask(masks[c], roi.width, roi.height, roi.width, DETECT_ERODE_RADIUS);
+      dilate_mask(masks[c], roi.width, roi.height, roi.width, DETECT_DILATE_RADIUS);
+    }
+    label_components(masks[c], roi.width, roi.height, roi.width, min_area, color, open, out);
+    for (size_t i = first; i < out->size(); i++) {
+      (*out)[i].x += roi.x;
+      (*out)[i].y += roi.y;
+    }
+  }
+}
+
+static void detect(const uint8_t *bgr, int width, int height, size_t bgr_stride,
+                   Classifier &cls, Roi roi, int scale, int min_area, std::vector<Blob> *out)
+{
+  const std::vector<ColorSpec> &colors = cls.colors;
+  roi = clip(roi, { 0, 0, width, height });
+  if (roi.width == 0 || roi.height == 0 || colors.empty()) return;
+  if (scale < 1) scale = 1;
+  if (scale > DETECT_MAX_SCALE) scale = DETECT_MAX_SCALE;
+
+  std::vector<uint8_t> buf;
+  int sw = roi.width / scale, sh = roi.height / scale;
+  if (scale == 1 || sw == 0 || sh == 0) {
+    detect_full(bgr, bgr_stride, cls, -1, roi, min_area, true, buf, out);
+    return;
+  }
+
+  // Coarse pass over every scale-th pixel of every scale-th row
+  std::vector<uint8_t> small((size_t)sw * sh * 3);
+  for (int y = 0; y < sh; y++) {
+    const uint8_t *src = bgr + (roi.y + y * scale) * bgr_stride + roi.x * 3;
+    uint8_t *dst = small.data() + (size_t)y * sw * 3;
+    for (int x = 0; x < sw; x++) {
+      dst[3 * x] = src[3 * x * scale];
+      dst[3 * x + 1] = src[3 * x * scale + 1];
+      dst[3 * x + 2] = src[3 * x * scale + 2];
+    }
+  }
+
+  // Half the scaled area, so a blob that samples unluckily still counts;
+  // the full resolution pass applies min_area exactly. No opening here, a
+  // 5x5 square at 1/scale would take out blobs the full pass keeps.
+  int coarse_area = min_area / (2 * scale * scale);
+  if (coarse_area < 1) coarse_area = 1;
+
+  Roi coarse_roi = { 0, 0, sw, sh };
+  std::vector<Blob> candidates;
+  detect_full(small.data(), (size_t)sw * 3, cls, -1, coarse_roi, coarse_area, false, buf,
+              &candidates);
+
+  // Refine each colour's candidates, merging windows that overlap so no
+  // component is counted twice
+  std::vector<Roi> windows;
+  for (size_t c = 0; c < colors.size(); c++) {
+    windows.clear();
+    for (const Blob &b : candidates) {
+      if (b.color != (int)c) continue;
+      int grow = scale + DETECT_OPEN_MARGIN;
+      Roi w = { roi.x + b.x * scale - grow, roi.y + b.y * scale - grow,
+                b.width * scale + 2 * grow, b.height * scale + 2 * grow };
+      windows.push_back(clip(w, roi));
+    }
+
+    bool merged = true;
+    while (merged) {  // A grown window can reach ones already checked
+      merged = false;
+      for (size_t i = 0; i < windows.size(); i++) {
+        for (size_t k = i + 1; k < windows.size();) {
+          if (overlaps(windows[i], windows[k])) {
+            windows[i] = merge(windows[i], windows[k]);
+            windows.erase(windows.begin() + k);
+            merged = true;
+          } else {
+            k++;
+          }
+        }
+      }
+    }
+
+    for (const Roi &w : windows) {
+      detect_full(bgr, bgr_stride, cls, (int)c, w, min_area, true, buf, out);
+    }
+  }
+}
+
+void detect_blobs(const uint8_t *bgr, int width, int height, size_t bgr_stride,
+                  const std::vector<ColorSpec> &colors, Roi roi, int scale, int min_area,
+                  std::vector<Blob> *out)
+{
+  Classifier cls = { colors, nullptr, {} };
+  detect(bgr, width, height, bgr_stride, cls, roi, scale, min_area, out);
+}
+
+void detect_blobs(const uint8_t *bgr, int width, int height, size_t bgr_stride,
+                  const LutTable &lut, Roi roi, int scale, int min_area, std::vector<Blob> *out)
+{
+  Classifier cls = { lut.colors, &lut, {} };
+  detect(bgr, width, height, bgr_stride, cls, roi, scale, min_area, out);
+}
+
+}  // namespace native
@@ -0,0 +1,77 @@
+#ifndef NATIVE_DETECT_H
+#define NATIVE_DETECT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "lut.h"
+#include "vision.h"
+
+// Blob detection: classify (vision.h), open the masks, then label
+// 8-connected components in one pass over run lengths. Only the region of
+// interest is touched, so the cost follows the ROI, not the frame.
+//
+// The opening and the area are Camera._find_blobs' OpenCV ones, so
+// min_area means the same on both paths: cv2.erode with a 5x5 square,
+// cv2.dilate with it twice, and the area of a blob is cv2.contourArea of
+// its outer border (polygon through the border pixel centres, so holes
+// count and a lone pixel or line is 0), not its pixel count. Unlike
+// cv2.RETR_EXTERNAL, a component inside a hole of another one is still
+// reported on its own.
+//
+// With scale > 1 a point-sampled copy of the ROI (every scale-th pixel
+// and row) is classified and labelled first, without the opening. Each
+// candidate's box, grown by scale plus DETECT_OPEN_MARGIN on every side,
+// is then classified, opened and labelled again at full resolution, so
+// reported boxes and areas are exact while most of the ROI is only
+// looked at once per scale^2 pixels.
+
+namespace native {
+
+// Frame pixels. Clipped to the frame; an empty ROI finds nothing.
+struct Roi {
+  int x, y;
+  int width, height;
+};
+
+// Same fields as the Python ColorBlob, less the angle
+struct Blob {
+  int color;          // Index into the colour list
+  int x, y;           // Bounding box top-left, frame pixels
+  int width, height;
+  int area;           // cv2.contourArea of the outer border, truncated
+};
+
+#define DETECT_MAX_SCALE 4
+
+// The opening: 5x5 erode, then 5x5 dilate twice (one 9x9)
+#define DETECT_ERODE_RADIUS 2
+#define DETECT_DILATE_RADIUS 4
+// Context a refined window keeps around a coarse candidate: every opened
+// pixel depends on raw pixels up to both radii away
+#define DETECT_OPEN_MARGIN (2 * (DETECT_ERODE_RADIUS + DETECT_DILATE_RADIUS))
+
+// Blobs of at least min_area, grouped by colour in list order
+void detect_blobs(const uint8_t *bgr, int width, int height, size_t bgr_stride,
+                  const std::vector<ColorSpec> &colors, Roi roi, int scale, int min_area,
+                  std::vector<Blob> *out);
+
+// The same, classifying through a table (lut.h) in the table's colours
+void detect_blobs(const uint8_t *bgr, int width, int height, size_t bgr_stride,
+                  const LutTable &lut, Roi roi, int scale, int min_area, std::vector<Blob> *out);
+
+// Components of a 0/non-zero mask, appended to out with coordinates relative
+// to the mask and the given colour index. area is the pixel count, or with
+// contour the outer border area as above; either must reach min_area.
+void label_components(const uint8_t *mask, int width, int height, size_t stride,
+                      int min_area, int color, bool contour, std::vector<Blob> *out);
+
+// cv2.erode / cv2.dilate of a 0/non-zero mask with a (2 radius + 1)
+// square, in place, to 0/0xFF. Pixels beyond the edge are ignored, as OpenCV's default border.
+void erode_mask(uint8_t *mask, int width, int height, size_t stride, int radius);
+void dilate_mask(uint8_t *mask, int width, int height, size_t stride, int radius);
+
+}  // namespace native
+
+#endif
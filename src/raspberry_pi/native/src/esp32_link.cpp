@@ -0,0 +1,348 @@
+#include "esp32_link.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace native {
+
+int64_t monotonic_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// CRC-8, polynomial 0x07, init 0x00, as on the ESP32
+uint8_t link_crc8(const uint8_t *data, size_t len)
+{
+  static uint8_t table[256];
+  static bool ready = false;
+  if (!ready) {
+    for (int i = 0; i < 256; i++) {
+      uint8_t crc = (uint8_t)i;
+      for (int b = 0; b < 8; b++) crc = (uint8_t)((crc << 1) ^ ((crc & 0x80) ? 0x07 : 0));
+      table[i] = crc;
+    }
+    ready = true;
+  }
+
+  uint8_t crc = 0;
+  while (len--) crc = table[crc ^ *data++];
+  return crc;
+}
+
+static speed_t baud_constant(int baud)
+{
+  switch (baud) {
+    case 9600: return B9600;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+#ifdef B460800
+    case 460800: return B460800;
+#endif
+#ifdef B921600
+    case 921600: return B921600;
+#endif
+#ifdef B2000000
+    case 2000000: return B2000000;
+#endif
+    default: return 0;
+  }
+}
+
+Esp32Link::Esp32Link()
+{
+  link_crc8(nullptr, 0);  // Build the table before any thread uses it
+  for (int i = 0; i < 256; i++) sentNs[i].store(0);
+}
+
+Esp32Link::~Esp32Link()
+{
+  close();
+}
+
+bool Esp32Link::open(const std::string &device, int baud)
+{
+  close();
+
+  speed_t speed = baud_constant(baud);
+  if (!speed) {
+    lastError = "unsupported baud rate";
+    return false;
+  }
+
+  fd = ::open(device.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (fd < 0) {
+    lastError = device + ": " + strerror(errno);
+    return false;
+  }
+
+  struct termios tio;
+  if (tcgetattr(fd, &tio) != 0) {
+    lastError = device + ": " + strerror(errno);
+    ::close(fd);
+    fd = -1;
+    return false;
+  }
+  cfmakeraw(&tio);
+  tio.c_cflag |= CLOCAL | CREAD;
+  tio.c_cc[VMIN] = 0;
+  tio.c_cc[VTIME] = 0;
+  cfsetispeed(&tio, speed);
+  cfsetospeed(&tio, speed);
+  tcsetattr(fd, TCSANOW, &tio);
+  tcflush(fd, TCIOFLUSH);  // Drop the boot log and anything stale
+
+  if (pipe(wakePipe) != 0) {
+    lastError = std::string("pipe: ") + strerror(errno);
+    ::close(fd);
+    fd = -1;
+    return false;
+  }
+  fcntl(wakePipe[0], F_SETFL, O_NONBLOCK);
+  fcntl(wakePipe[1], F_SETFL, O_NONBLOCK);
+
+  rxLen = 0;
+  lastTelemetrySeq = -1;
+  lastError.clear();
+  running.store(true);
+  thread = std::thread(&Esp32Link::run, this);
+  return true;
+}
+
+void Esp32Link::close()
+{
+  running.store(false);
+  if (thread.joinable()) {
+    wake();
+    thread.join();
+  }
+  if (fd >= 0) ::close(fd);
+  for (int &p : wakePipe) {
+    if (p >= 0) ::close(p);
+    p = -1;
+  }
+  fd = -1;
+  txPending.clear();
+}
+
+void Esp32Link::wake()
+{
+  uint8_t b = 1;
+  if (wakePipe[1] >= 0) (void)!write(wakePipe[1], &b, 1);
+}
+
+int Esp32Link::send(uint8_t type, const uint8_t *payload, size_t len)
+{
+  if (!running.load()) return -1;
+
+  std::lock_guard<std::mutex> lock(txMutex);
+  uint8_t seq = nextSeq;
+  nextSeq = nextSeq == 255 ? 1 : nextSeq + 1;
+
+  uint8_t frame[LINK_PROTO_FRAME_SIZE] = { 0 };
+  frame[0] = LINK_PROTO_SYNC;
+  frame[1] = type;
+  frame[2] = seq;
+  if (len > LINK_PROTO_PAYLOAD_SIZE) len = LINK_PROTO_PAYLOAD_SIZE;
+  if (len) memcpy(frame + 3, payload, len);
+  frame[LINK_PROTO_FRAME_SIZE - 1] = link_crc8(frame + 1, LINK_PROTO_FRAME_SIZE - 2);
+
+  // Stamped first so even an instant reply finds it
+  sentNs[seq].store(monotonic_ns());
+  bool wasEmpty = txPending.empty();
+  txPending.insert(txPending.end(), frame, frame + LINK_PROTO_FRAME_SIZE);
+  flush_tx();
+  txFrames.fetch_add(1);
+
+  // Whatever is left waits for POLLOUT in the thread
+  if (!txPending.empty()) {
+    txDeferred.fetch_add(1);
+    if (wasEmpty) wake();
+  }
+  return seq;
+}
+
+void Esp32Link::flush_tx()
+{
+  while (!txPending.empty()) {
+    ssize_t n = write(fd, txPending.data(), txPending.size());
+    if (n <= 0) return;  // EAGAIN: port buffer full, try again on POLLOUT
+    txPending.erase(txPending.begin(), txPending.begin() + n);
+  }
+}
+
+void Esp32Link::run()
+{
+  uint8_t buf[4096];
+  while (running.load()) {
+    bool wantWrite;
+    {
+      std::lock_guard<std::mutex> lock(txMutex);
+      wantWrite = !txPending.empty();
+    }
+
+    struct pollfd fds[2] = {
+      { fd, (short)(POLLIN | (wantWrite ? POLLOUT : 0)), 0 },
+      { wakePipe[0], POLLIN, 0 },
+    };
+    if (poll(fds, 2, 100) < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+
+    if (fds[1].revents & POLLIN) {
+      while (read(wakePipe[0], buf, sizeof(buf)) > 0) {
+      }
+    }
+
+    if (fds[0].revents & POLLIN) {
+      ssize_t n = read(fd, buf, sizeof(buf));
+      int64_t now = monotonic_ns();
+      if (n > 0) feed(buf, (size_t)n, now);
+    }
+
+    if (fds[0].revents & POLLOUT) {
+      std::lock_guard<std::mutex> lock(txMutex);
+      flush_tx();
+    }
+
+    if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+      lastError = "serial port closed";  // Unplugged, ESP32 reset
+      break;
+    }
+  }
+  running.store(false);
+}
+
+// Same resync as the firmware: on a bad CRC drop the first byte and look
+// for the next sync of either kind in what is left
+void Esp32Link::feed(const uint8_t *data, size_t len, int64_t rx_ns)
+{
+  for (size_t i = 0; i < len; i++) {
+    uint8_t b = data[i];
+    if (rxLen == 0 && b != LINK_PROTO_SYNC && b != LINK_TELEMETRY_SYNC) continue;
+    rxBuf[rxLen++] = b;
+
+    while (rxLen > 0) {
+      bool isProto = rxBuf[0] == LINK_PROTO_SYNC;
+      size_t size = isProto ? LINK_PROTO_FRAME_SIZE : LINK_TELEMETRY_FRAME_SIZE;
+      if (rxLen < size) break;
+
+      if (link_crc8(rxBuf + 1, size - 2) == rxBuf[size - 1]) {
+        if (isProto) {
+          handle_frame(rxBuf, rx_ns);
+        } else {
+          handle_telemetry(rxBuf, rx_ns);
+        }
+        rxLen = 0;
+        break;
+      }
+
+      crcErrors.fetch_add(1);
+      size_t skip = 1;
+      while (skip < rxLen && rxBuf[skip] != LINK_PROTO_SYNC && rxBuf[skip] != LINK_TELEMETRY_SYNC) {
+        skip++;
+      }
+      rxLen -= skip;
+      memmove(rxBuf, rxBuf + skip, rxLen);
+    }
+  }
+}
+
+void Esp32Link::handle_frame(const uint8_t *frame, int64_t rx_ns)
+{
+  rxFrames.fetch_add(1);
+
+  LinkFrame f;
+  f.type = frame[1];
+  f.seq = frame[2];
+  memcpy(f.payload, frame + 3, LINK_PROTO_PAYLOAD_SIZE);
+  f.rx_ns = rx_ns;
+  int64_t sent = f.seq ? sentNs[f.seq].load() : 0;
+  f.rtt_ns = sent ? rx_ns - sent : -1;
+
+  // STATUS answers every drive command: only the latest matters. It is
+  // also the one reply whose round trip is the link's, so it feeds the
+  // RTT stats (MOVE_DONE and such arrive whenever the move ends).
+  if (f.type == LINK_MSG_STATUS) {
+    if (f.rtt_ns >= 0) {
+      rttLast.store(f.rtt_ns);
+      int64_t lo = rttMin.load(), hi = rttMax.load();
+      if (lo < 0 || f.rtt_ns < lo) rttMin.store(f.rtt_ns);
+      if (f.rtt_ns > hi) rttMax.store(f.rtt_ns);
+    }
+    current.status_rx_ns = rx_ns;
+    current.status_rtt_ns = f.rtt_ns;
+    current.status_count = (int32_t)((uint32_t)f.payload[0] | ((uint32_t)f.payload[1] << 8) |
+                                     ((uint32_t)f.payload[2] << 16) | ((uint32_t)f.payload[3] << 24));
+    current.status_seq = f.seq;
+    latest.write(current);
+    return;
+  }
+
+  if (f.type == LINK_MSG_LOAD) {
+    if (!loads.push(f)) loadsDropped.fetch_add(1);
+    return;
+  }
+  if (!events.push(f)) eventsDropped.fetch_add(1);
+}
+
+// Record layout: uint32 time_us, uint8 type, uint8 seq, uint16 flags, body
+void Esp32Link::handle_telemetry(const uint8_t *frame, int64_t rx_ns)
+{
+  rxTelemetry.fetch_add(1);
+
+  LinkTelemetry t;
+  t.rx_ns = rx_ns;
+  memcpy(t.record, frame + 1, LINK_TELEMETRY_RECORD_SIZE);
+
+  uint8_t seq = t.record[5];
+  if (lastTelemetrySeq >= 0) {
+    uint8_t missing = (uint8_t)(seq - lastTelemetrySeq - 1);
+    telemetryGaps.fetch_add(missing);
+  }
+  lastTelemetrySeq = seq;
+
+  uint8_t type = t.record[4];
+  if (type == LINK_TELEM_STATE || type == LINK_TELEM_ODOM) {
+    (type == LINK_TELEM_STATE ? current.state : current.odom) = t;
+    latest.write(current);
+  }
+
+  if (!telemetry.push(t)) telemetryDropped.fetch_add(1);
+
+  std::lock_guard<std::mutex> lock(sinkMutex);
+  if (telemetrySink) telemetrySink(t);
+}
+
+void Esp32Link::set_telemetry_sink(std::function<void(const LinkTelemetry &)> sink)
+{
+  std::lock_guard<std::mutex> lock(sinkMutex);
+  telemetrySink = std::move(sink);
+}
+
+LinkStats Esp32Link::stats() const
+{
+  LinkStats s;
+  s.tx_frames = txFrames.load();
+  s.tx_deferred = txDeferred.load();
+  s.rx_frames = rxFrames.load();
+  s.rx_telemetry = rxTelemetry.load();
+  s.crc_errors = crcErrors.load();
+  s.telemetry_gaps = telemetryGaps.load();
+  s.events_dropped = eventsDropped.load();
+  s.loads_dropped = loadsDropped.load();
+  s.telemetry_dropped = telemetryDropped.load();
+  s.rtt_last_ns = rttLast.load();
+  s.rtt_min_ns = rttMin.load();
+  s.rtt_max_ns = rttMax.load();
+  return s;
+}
+
+}  // namespace native
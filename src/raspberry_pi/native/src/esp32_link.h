@@ -0,0 +1,229 @@
+#ifndef NATIVE_ESP32_LINK_H
+#define NATIVE_ESP32_LINK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Pi side of the ESP32 serial protocol (esp32/src/protocol.h and
+// telemetry.h). A dedicated thread owns the port: non-blocking reads,
+// parsing of the interleaved protocol frames and telemetry records, and
+// flushing whatever send() couldn't write straight away.
+//
+// send() never waits for the reply, so commands pipeline. Every write and
+// every read is stamped with CLOCK_MONOTONIC (same clock as Python's
+// time.monotonic_ns()). Replies carry the round trip to the request with
+// the same seq.
+//
+// The latest STATUS / STATE / ODOM live in a seqlock snapshot that any
+// thread can read without taking a lock. Other replies and events, and
+// every telemetry record, go through single-consumer rings. LOAD frames
+// stream unasked after every load window, so they get a ring of their
+// own: a slow reader of them fills that one and never costs a reply.
+
+namespace native {
+
+// Wire format, mirrors the firmware
+#define LINK_PROTO_SYNC 0xA5
+#define LINK_PROTO_FRAME_SIZE 12
+#define LINK_PROTO_PAYLOAD_SIZE 8
+#define LINK_TELEMETRY_SYNC 0x5A
+#define LINK_TELEMETRY_RECORD_SIZE 24
+#define LINK_TELEMETRY_FRAME_SIZE (LINK_TELEMETRY_RECORD_SIZE + 2)
+
+#define LINK_MSG_STATUS 0x81
+#define LINK_MSG_LOAD 0x8A
+#define LINK_TELEM_STATE 0x01
+#define LINK_TELEM_ODOM 0x02
+
+#define LINK_EVENT_RING 256      // Frames, power of two
+#define LINK_LOAD_RING 256       // LOAD frames, power of two
+#define LINK_TELEMETRY_RING 1024 // Records, power of two
+
+int64_t monotonic_ns();
+
+uint8_t link_crc8(const uint8_t *data, size_t len);
+
+// Protocol frame from the ESP32
+struct LinkFrame {
+  uint8_t type;
+  uint8_t seq;
+  uint8_t payload[LINK_PROTO_PAYLOAD_SIZE];
+  int64_t rx_ns;
+  int64_t rtt_ns;  // rx_ns minus the write of the request with this seq, -1 if none
+};
+
+// Raw telemetry_record_t bytes
+struct LinkTelemetry {
+  int64_t rx_ns;  // 0 = none yet
+  uint8_t record[LINK_TELEMETRY_RECORD_SIZE];
+};
+
+struct LinkSnapshot {
+  int64_t status_rx_ns;  // 0 = no STATUS yet
+  int64_t status_rtt_ns;
+  int32_t status_count;  // Encoder ticks from the last STATUS reply
+  uint32_t status_seq;
+  LinkTelemetry state;
+  LinkTelemetry odom;
+};
+
+struct LinkStats {
+  uint64_t tx_frames;
+  uint64_t tx_deferred;      // Frames send() couldn't write at once, left to the thread
+  uint64_t rx_frames;
+  uint64_t rx_telemetry;
+  uint64_t crc_errors;
+  uint64_t telemetry_gaps;   // Records missing by the ESP32's per-record seq
+  uint64_t events_dropped;   // Rings full, consumer too slow
+  uint64_t loads_dropped;
+  uint64_t telemetry_dropped;
+  int64_t rtt_last_ns;       // STATUS replies only, -1 before the first
+  int64_t rtt_min_ns;
+  int64_t rtt_max_ns;
+};
+
+// Single producer (the link thread), single consumer
+template <typename T, uint32_t N>
+class SpscRing {
+public:
+  bool push(const T &item)
+  {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) == N) return false;
+    items[h & (N - 1)] = item;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T *item)
+  {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) return false;
+    *item = items[t & (N - 1)];
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  T items[N];
+  std::atomic<uint32_t> head{ 0 };
+  std::atomic<uint32_t> tail{ 0 };
+};
+
+// One writer, any number of readers, nobody blocks. The value is kept as
+// atomic words so a torn read is detected by the sequence, not UB.
+template <typename T>
+class Seqlock {
+  static_assert(sizeof(T) % 8 == 0, "Seqlock value must be whole 64-bit words");
+
+public:
+  void write(const T &value)
+  {
+    uint64_t words[WORDS];
+    memcpy(words, &value, sizeof(T));
+    uint32_t s = seq.load(std::memory_order_relaxed);
+    seq.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < WORDS; i++) data[i].store(words[i], std::memory_order_relaxed);
+    seq.store(s + 2, std::memory_order_release);
+  }
+
+  T read() const
+  {
+    uint64_t words[WORDS];
+    uint32_t before, after;
+    do {
+      before = seq.load(std::memory_order_acquire);
+      for (size_t i = 0; i < WORDS; i++) words[i] = data[i].load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      after = seq.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+    T value;
+    memcpy(&value, words, sizeof(T));
+    return value;
+  }
+
+private:
+  static const size_t WORDS = sizeof(T) / 8;
+  std::atomic<uint32_t> seq{ 0 };
+  std::atomic<uint64_t> data[WORDS] = {};
+};
+
+class Esp32Link {
+public:
+  Esp32Link();
+  ~Esp32Link();
+  Esp32Link(const Esp32Link &) = delete;
+  Esp32Link &operator=(const Esp32Link &) = delete;
+
+  // Raw 8N1 at baud, starts the thread. false with error() set on failure.
+  bool open(const std::string &device, int baud);
+  void close();
+  bool is_open() const { return running.load(); }
+  const std::string &error() const { return lastError; }  // Once is_open() is false
+
+  // Queue one frame, seq assigned from 1-255 (0 is left to the ESP32's
+  // unsolicited frames). Writes immediately when the port has room.
+  // Returns the seq, -1 if closed.
+  int send(uint8_t type, const uint8_t *payload, size_t len);
+
+  LinkSnapshot snapshot() const { return latest.read(); }
+  bool poll_event(LinkFrame *frame) { return events.pop(frame); }  // Everything but LOAD
+  bool poll_load(LinkFrame *frame) { return loads.pop(frame); }
+  bool poll_telemetry(LinkTelemetry *record) { return telemetry.pop(record); }
+  LinkStats stats() const;
+
+  // Also hands every telemetry record to sink, on the link thread, as it
+  // arrives (the ring still gets it). Keep it short; empty to remove.
+  void set_telemetry_sink(std::function<void(const LinkTelemetry &)> sink);
+
+private:
+  void run();
+  void flush_tx();  // Caller holds txMutex
+  void feed(const uint8_t *data, size_t len, int64_t rx_ns);
+  void handle_frame(const uint8_t *frame, int64_t rx_ns);
+  void handle_telemetry(const uint8_t *frame, int64_t rx_ns);
+  void wake();
+
+  int fd = -1;
+  int wakePipe[2] = { -1, -1 };
+  std::thread thread;
+  std::atomic<bool> running{ false };
+  std::string lastError;
+
+  // TX: send() appends and writes what it can, the thread writes the rest
+  std::mutex txMutex;
+  std::vector<uint8_t> txPending;
+  uint8_t nextSeq = 1;
+  std::atomic<int64_t> sentNs[256];
+
+  // RX parser, link thread only
+  uint8_t rxBuf[LINK_TELEMETRY_FRAME_SIZE];
+  size_t rxLen = 0;
+  int lastTelemetrySeq = -1;
+  LinkSnapshot current = {};
+
+  std::mutex sinkMutex;
+  std::function<void(const LinkTelemetry &)> telemetrySink;
+
+  Seqlock<LinkSnapshot> latest;
+  SpscRing<LinkFrame, LINK_EVENT_RING> events;
+  SpscRing<LinkFrame, LINK_LOAD_RING> loads;
+  SpscRing<LinkTelemetry, LINK_TELEMETRY_RING> telemetry;
+
+  std::atomic<uint64_t> txFrames{ 0 }, txDeferred{ 0 }, rxFrames{ 0 }, rxTelemetry{ 0 };
+  std::atomic<uint64_t> crcErrors{ 0 }, telemetryGaps{ 0 };
+  std::atomic<uint64_t> eventsDropped{ 0 }, loadsDropped{ 0 }, telemetryDropped{ 0 };
+  std::atomic<int64_t> rttLast{ -1 }, rttMin{ -1 }, rttMax{ -1 };
+};
+
+}  // namespace native
+
+#endif
@@ -0,0 +1,69 @@
+#include "frame_pool.h"
+
+namespace native {
+
+FramePool::FramePool(int slots, int height, int width, int channels)
+  : slots(slots), height(height), width(width), channels(channels),
+    frameBytes((size_t)height * width * channels),
+    storage(new uint8_t[(size_t)slots * height * width * channels]),
+    refs(new std::atomic<int>[slots]),
+    ids(slots, 0)
+{
+  for (int i = 0; i < slots; i++) refs[i].store(0);
+}
+
+// Only acquire() takes a slot from zero, and only under the mutex, so a
+// zero seen here stays zero until it is claimed
+int FramePool::acquire()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  for (int n = 0; n < slots; n++) {
+    int slot = (next + n) % slots;
+    if (refs[slot].load() != 0) continue;
+    refs[slot].store(1);
+    next = (slot + 1) % slots;
+    return slot;
+  }
+  return -1;
+}
+
+void FramePool::publish(int slot, uint64_t id)
+{
+  int previous;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    retain(slot);
+    ids[slot] = id;
+    previous = current;
+    current = slot;
+  }
+  if (previous >= 0) release(previous);
+}
+
+int FramePool::latest(uint64_t *id)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  if (current < 0) return -1;
+  retain(current);
+  if (id) *id = ids[current];
+  return current;
+}
+
+void FramePool::retain(int slot)
+{
+  refs[slot].fetch_add(1);
+}
+
+void FramePool::release(int slot)
+{
+  refs[slot].fetch_sub(1);
+}
+
+int FramePool::held() const
+{
+  int count = 0;
+  for (int i = 0; i < slots; i++) count += refs[i].load() != 0;
+  return count;
+}
+
+}  // namespace native
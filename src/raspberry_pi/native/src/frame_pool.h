@@ -0,0 +1,57 @@
+#ifndef NATIVE_FRAME_POOL_H
+#define NATIVE_FRAME_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Fixed set of preallocated frame buffers shared by reference count.
+// Capture fills a free slot and publishes it; every reader (detection,
+// each stream client) holds a reference to the same bytes instead of a
+// copy. A slot is reused only once nobody holds it, so a published frame
+// never changes under a reader.
+
+namespace native {
+
+#define FRAME_POOL_MAX_SLOTS 16
+
+class FramePool {
+public:
+  FramePool(int slots, int height, int width, int channels);
+
+  // Free slot with one reference for the writer, or -1 if every slot is
+  // still held
+  int acquire();
+
+  // Makes slot the latest frame. The pool keeps its own reference until
+  // the next publish; the caller's reference is untouched.
+  void publish(int slot, uint64_t id);
+
+  // Latest slot with a new reference, or -1 before the first publish
+  int latest(uint64_t *id);
+
+  void retain(int slot);
+  void release(int slot);  // Any thread
+
+  uint8_t *data(int slot) { return storage.get() + (size_t)slot * frameBytes; }
+  uint64_t id(int slot) const { return ids[slot]; }
+  int held() const;  // Slots with at least one reference
+
+  const int slots, height, width, channels;
+
+private:
+  size_t frameBytes;
+  std::unique_ptr<uint8_t[]> storage;
+  std::unique_ptr<std::atomic<int>[]> refs;
+  std::vector<uint64_t> ids;
+  std::mutex mutex;  // acquire / publish / latest
+  int current = -1;
+  int next = 0;  // Round robin start for acquire
+};
+
+}  // namespace native
+
+#endif
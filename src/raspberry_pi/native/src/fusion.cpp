@@ -0,0 +1,246 @@
+#include "fusion.h"
+
+#include <math.h>
+#include <time.h>
+
+#include <algorithm>
+
+namespace native {
+
+static double wrap_angle(double a)
+{
+  while (a > M_PI) a -= 2 * M_PI;
+  while (a < -M_PI) a += 2 * M_PI;
+  return a;
+}
+
+template <typename T>
+static T get_le(const uint8_t *p)
+{
+  T value;
+  memcpy(&value, p, sizeof(T));  // The Pi is little-endian, like the ESP32
+  return value;
+}
+
+int64_t ClockSync::update(uint32_t remote_us, int64_t rx_ns, bool *restarted)
+{
+  *restarted = false;
+  int32_t step = (int32_t)(remote_us - lastUs);
+  if (started && step < -1000000) {
+    started = false;  // More than 1 s back: the ESP32 rebooted
+    *restarted = true;
+  }
+
+  if (!started) {
+    started = true;
+    remoteNs = (int64_t)remote_us * 1000;
+    offset = rx_ns - remoteNs;
+  } else {
+    // uint32 time_us wraps every 71 minutes, the delta doesn't
+    remoteNs += (int64_t)std::max(step, 0) * 1000;
+    int64_t drift = (rx_ns - lastRx) * FUSION_CLOCK_DRIFT_PPM / 1000000;
+    offset = std::min(offset + std::max(drift, (int64_t)0), rx_ns - remoteNs);
+  }
+  lastUs = remote_us;
+  lastRx = rx_ns;
+  return remoteNs;
+}
+
+Fusion::~Fusion()
+{
+  stop();
+}
+
+void Fusion::start(double rate_hz)
+{
+  stop();
+  periodNs = (int64_t)(1e9 / rate_hz);
+  running.store(true);
+  thread = std::thread(&Fusion::run, this);
+}
+
+void Fusion::stop()
+{
+  running.store(false);
+  if (thread.joinable()) thread.join();
+}
+
+// Absolute deadlines so the rate doesn't drift with the work. After a
+// stall skip ahead instead of publishing a burst.
+void Fusion::run()
+{
+  int64_t next = monotonic_ns();
+  while (running.load()) {
+    next += periodNs;
+    struct timespec ts = { (time_t)(next / 1000000000), (long)(next % 1000000000) };
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+
+    int64_t now = monotonic_ns();
+    if (now - next > periodNs) next = now;
+    publish(now);
+  }
+}
+
+void Fusion::add_odom(uint32_t time_us, int64_t rx_ns, const Pose &pose)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  bool restarted;
+  Pose p = pose;
+  p.t_ns = clock.update(time_us, rx_ns, &restarted);
+  if (restarted) odom.clear();
+
+  p.speed = 0;
+  if (odom.size()) {
+    const Pose &prev = odom.back();
+    int64_t dt = p.t_ns - prev.t_ns;
+    if (dt <= 0) return;  // Same control tick twice
+    // Signed: displacement along the heading, so reversing is negative
+    double dx = p.x - prev.x, dy = p.y - prev.y;
+    p.speed = (dx * cos(p.heading) + dy * sin(p.heading)) * 1e9 / dt;
+  }
+  odom.push(p);
+}
+
+// ODOM body: int32 x, y (0.1 mm), int16 heading (1e-4 rad),
+// int16 yaw_rate (1e-3 rad/s), uint32 distance (mm)
+void Fusion::add_telemetry(const LinkTelemetry &record)
+{
+  const uint8_t *r = record.record;
+  if (r[4] != LINK_TELEM_ODOM) return;
+
+  const uint8_t *b = r + 8;
+  Pose pose = {};
+  pose.x = get_le<int32_t>(b) * 0.1;
+  pose.y = get_le<int32_t>(b + 4) * 0.1;
+  pose.heading = get_le<int16_t>(b + 8) * 1e-4;
+  pose.yaw_rate = get_le<int16_t>(b + 10) * 1e-3;
+  pose.distance = get_le<uint32_t>(b + 12);
+  add_odom(get_le<uint32_t>(r), record.rx_ns, pose);
+}
+
+void Fusion::add_camera(const CameraFrame &frame)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  camera.push(frame);
+}
+
+void Fusion::add_lidar(const LidarPoint *points, size_t count)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  for (size_t i = 0; i < count; i++) lidar.push(points[i]);
+}
+
+void Fusion::reset()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  odom.clear();
+}
+
+void Fusion::set_link_latency(int64_t ns)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  clock.latency = std::max(ns, (int64_t)0);
+}
+
+bool Fusion::pose_at(int64_t t_ns, Pose *pose, bool *interpolated) const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return pose_at_locked(t_ns, pose, interpolated);
+}
+
+// The history stays on the ESP32 clock and is mapped with the current
+// offset, so a better offset estimate corrects old samples too
+bool Fusion::pose_at_locked(int64_t t_ns, Pose *pose, bool *interpolated) const
+{
+  if (!odom.size()) return false;
+  int64_t t = clock.to_remote(t_ns);
+  auto key = [](const Pose &p) { return p.t_ns; };
+  long i = odom.floor(t, key);
+  if (i < 0) return false;
+
+  const Pose &a = odom[i];
+  if ((size_t)i + 1 < odom.size()) {
+    const Pose &b = odom[i + 1];
+    double f = (double)(t - a.t_ns) / (double)(b.t_ns - a.t_ns);
+    pose->x = a.x + (b.x - a.x) * f;
+    pose->y = a.y + (b.y - a.y) * f;
+    pose->heading = wrap_angle(a.heading + wrap_angle(b.heading - a.heading) * f);
+    pose->yaw_rate = a.yaw_rate + (b.yaw_rate - a.yaw_rate) * f;
+    pose->speed = b.speed;
+    pose->distance = a.distance + (b.distance - a.distance) * f;
+    *interpolated = true;
+  } else {
+    // Newer than any sample: carry on along the arc at the last speed
+    int64_t ahead = t - a.t_ns;
+    if (ahead > FUSION_MAX_EXTRAPOLATE_NS) return false;
+    double dt = ahead * 1e-9;
+    double mid = a.heading + a.yaw_rate * dt / 2;
+    pose->x = a.x + a.speed * dt * cos(mid);
+    pose->y = a.y + a.speed * dt * sin(mid);
+    pose->heading = wrap_angle(a.heading + a.yaw_rate * dt);
+    pose->yaw_rate = a.yaw_rate;
+    pose->speed = a.speed;
+    pose->distance = a.distance + fabs(a.speed) * dt;
+    *interpolated = false;
+  }
+  pose->t_ns = t_ns;
+  return true;
+}
+
+void Fusion::publish(int64_t now_ns)
+{
+  auto state = std::make_shared<WorldState>();
+  WorldState &w = *state;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    w.t_ns = now_ns;
+    w.pose_valid = pose_at_locked(now_ns, &w.pose, &w.pose_interpolated);
+    w.odom_age_ns = odom.size() ? now_ns - clock.to_local(odom.back().t_ns) : -1;
+    w.clock_offset_ns = clock.offset_ns() - clock.latency;
+
+    // Blobs are bearings from where the car was at capture; turned into
+    // world bearings there, then back against the heading it has now
+    w.frame_valid = false;
+    if (camera.size()) {
+      const CameraFrame &frame = camera.back();
+      w.frame_id = frame.frame_id;
+      w.frame_t_ns = frame.t_ns;
+      w.frame_valid = pose_at_locked(frame.t_ns, &w.frame_pose, &w.frame_interpolated);
+      if (w.frame_valid) {
+        for (const CameraBlob &blob : frame.blobs) {
+          Landmark l;
+          l.blob = blob;
+          l.bearing = wrap_angle(w.frame_pose.heading + blob.angle);
+          l.relative = w.pose_valid ? wrap_angle(l.bearing - w.pose.heading) : blob.angle;
+          w.landmarks.push_back(l);
+        }
+      }
+    }
+
+    // Each point with the pose at its own time, so a scan taken while
+    // turning isn't smeared
+    auto key = [](const LidarPoint &p) { return p.t_ns; };
+    long first = lidar.floor(now_ns - FUSION_LIDAR_WINDOW_NS, key) + 1;
+    for (size_t i = (size_t)first; i < lidar.size(); i++) {
+      const LidarPoint &p = lidar[i];
+      Pose at;
+      bool interpolated;
+      if (!pose_at_locked(p.t_ns, &at, &interpolated)) continue;
+      double a = at.heading + p.angle;
+      WorldPoint point = { (float)(at.x + p.distance * cos(a)), (float)(at.y + p.distance * sin(a)) };
+      w.lidar.push_back(point);
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(worldMutex);
+  w.seq = ++publishes;
+  latest = state;
+}
+
+std::shared_ptr<const WorldState> Fusion::world() const
+{
+  std::lock_guard<std::mutex> lock(worldMutex);
+  return latest;
+}
+
+}  // namespace native
@@ -0,0 +1,213 @@
+#ifndef NATIVE_FUSION_H
+#define NATIVE_FUSION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "esp32_link.h"
+
+// Sensor fusion on one clock. Every stream (ESP32 odometry, camera
+// frames, LIDAR points) goes into its own ring indexed by time on the
+// Pi's CLOCK_MONOTONIC, so a measurement can be matched with the pose the
+// car had when it was taken rather than the pose when it got here.
+//
+// Odometry is stamped by the ESP32's own clock. ClockSync maps that onto
+// the Pi's: the smallest (arrival - ESP32 time) seen is the link's fixed
+// latency, anything above it is batching and USB jitter. The offset is
+// allowed to creep up by the worst-case crystal drift so it follows the
+// clocks apart. The fixed part can't be seen from one side; pass half
+// the link's best round trip to set_link_latency().
+//
+// A thread publishes a WorldState at a fixed rate: the current pose, the
+// latest camera frame's blobs turned into world bearings with the pose at
+// the frame's capture time, and the recent LIDAR points in world
+// coordinates, each with the pose at its own time.
+
+namespace native {
+
+#define FUSION_ODOM_HISTORY 2048    // Samples, 2 s at the 1 kHz control rate
+#define FUSION_CAMERA_HISTORY 8     // Frames
+#define FUSION_LIDAR_HISTORY 4096   // Points, about 5 revolutions
+#define FUSION_LIDAR_WINDOW_NS 100000000     // Points in the world state: last 100 ms
+#define FUSION_MAX_EXTRAPOLATE_NS 100000000  // Past the newest odometry
+#define FUSION_CLOCK_DRIFT_PPM 100
+#define FUSION_MAX_BLOBS 32
+
+// Pose on the odometry frame: origin and x axis where the ESP32 was last reset
+struct Pose {
+  int64_t t_ns;     // Pi clock
+  double x, y;      // mm
+  double heading;   // rad, counter-clockwise, -pi..pi
+  double yaw_rate;  // rad/s
+  double speed;     // mm/s along the heading, negative in reverse
+  double distance;  // mm of path, always increasing
+};
+
+struct CameraBlob {
+  uint8_t color;   // Index into the caller's colour list
+  float angle;     // rad from the optical axis, counter-clockwise (left) positive
+  int32_t x, y, width, height, area;  // Pixels, x / y the centre
+};
+
+struct CameraFrame {
+  int64_t t_ns;  // Capture time, Pi clock
+  uint64_t frame_id;
+  std::vector<CameraBlob> blobs;
+};
+
+struct LidarPoint {
+  int64_t t_ns;
+  float angle;     // rad, counter-clockwise from the car's forward axis
+  float distance;  // mm
+};
+
+struct Landmark {
+  CameraBlob blob;
+  double bearing;   // World direction, rad
+  double relative;  // bearing against the current heading: where to look now
+};
+
+struct WorldPoint {
+  float x, y;  // mm
+};
+
+struct WorldState {
+  uint64_t seq;  // Counts publishes
+  int64_t t_ns;
+
+  bool pose_valid;
+  bool pose_interpolated;  // false = extrapolated past the newest odometry
+  Pose pose;
+  int64_t odom_age_ns;      // t_ns minus the newest odometry sample's time, -1 if none
+  int64_t clock_offset_ns;  // Pi clock minus ESP32 clock, link latency included
+
+  bool frame_valid;  // Latest frame and a pose for it
+  bool frame_interpolated;
+  uint64_t frame_id;
+  int64_t frame_t_ns;
+  Pose frame_pose;
+  std::vector<Landmark> landmarks;
+
+  std::vector<WorldPoint> lidar;
+};
+
+// Fixed-capacity history, oldest dropped, kept sorted by push order
+template <typename T, size_t N>
+class TimeRing {
+public:
+  void push(const T &item)
+  {
+    items[(start + count) % N] = item;
+    if (count < N) {
+      count++;
+    } else {
+      start = (start + 1) % N;
+    }
+  }
+
+  void clear() { start = count = 0; }
+  size_t size() const { return count; }
+  const T &operator[](size_t i) const { return items[(start + i) % N]; }  // 0 = oldest
+  const T &back() const { return (*this)[count - 1]; }
+
+  // Index of the newest item with t <= time, -1 if all are newer
+  template <typename Key>
+  long floor(int64_t time, Key key) const
+  {
+    long lo = 0, hi = (long)count;
+    while (lo < hi) {
+      long mid = (lo + hi) / 2;
+      if (key((*this)[mid]) <= time) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return lo - 1;
+  }
+
+private:
+  T items[N];
+  size_t start = 0, count = 0;
+};
+
+class ClockSync {
+public:
+  // One ESP32 record: its time_us and when it arrived. Returns the ESP32
+  // time unwrapped to 64-bit ns. restarted is set when the ESP32 clock
+  // jumped back (reset), which also restarts the sync.
+  int64_t update(uint32_t remote_us, int64_t rx_ns, bool *restarted);
+
+  bool valid() const { return started; }
+  int64_t offset_ns() const { return offset; }
+  int64_t to_local(int64_t remote_ns) const { return remote_ns + offset - latency; }
+  int64_t to_remote(int64_t local_ns) const { return local_ns - offset + latency; }
+  void reset() { started = false; }
+
+  int64_t latency = 0;  // One-way link delay, taken off every arrival
+
+private:
+  bool started = false;
+  uint32_t lastUs = 0;
+  int64_t remoteNs = 0;
+  int64_t lastRx = 0;
+  int64_t offset = 0;
+};
+
+class Fusion {
+public:
+  Fusion() = default;
+  ~Fusion();
+  Fusion(const Fusion &) = delete;
+  Fusion &operator=(const Fusion &) = delete;
+
+  // Publish thread at rate_hz. world() is only updated while it runs,
+  // or by calling publish() yourself (replays).
+  void start(double rate_hz);
+  void stop();
+  bool is_running() const { return running.load(); }
+
+  // One odometry sample in mm / rad; pose.t_ns and speed are filled in here
+  void add_odom(uint32_t time_us, int64_t rx_ns, const Pose &pose);
+  // A raw telemetry record from Esp32Link; only ODOM is used
+  void add_telemetry(const LinkTelemetry &record);
+  void add_camera(const CameraFrame &frame);
+  void add_lidar(const LidarPoint *points, size_t count);
+  void reset();  // Odometry was reset: drop the history
+  void set_link_latency(int64_t ns);
+
+  // Pose at a Pi time: interpolated between odometry samples, or
+  // extrapolated up to FUSION_MAX_EXTRAPOLATE_NS past the newest. false
+  // if t_ns is outside the history.
+  bool pose_at(int64_t t_ns, Pose *pose, bool *interpolated) const;
+
+  void publish(int64_t now_ns);
+  std::shared_ptr<const WorldState> world() const;
+
+private:
+  bool pose_at_locked(int64_t t_ns, Pose *pose, bool *interpolated) const;
+  void run();
+
+  mutable std::mutex mutex;  // Rings and clock
+  ClockSync clock;
+  TimeRing<Pose, FUSION_ODOM_HISTORY> odom;  // t_ns on the ESP32 clock
+  TimeRing<CameraFrame, FUSION_CAMERA_HISTORY> camera;
+  TimeRing<LidarPoint, FUSION_LIDAR_HISTORY> lidar;
+
+  mutable std::mutex worldMutex;
+  std::shared_ptr<const WorldState> latest;
+  uint64_t publishes = 0;
+
+  std::thread thread;
+  std::atomic<bool> running{ false };
+  int64_t periodNs = 0;
+};
+
+}  // namespace native
+
+#endif
@@ -0,0 +1,66 @@
+#include "jpeg.h"
+
+#ifdef WRO_TURBOJPEG
+#include <turbojpeg.h>
+#endif
+
+namespace native {
+
+void downscale(const uint8_t *src, int width, int height, size_t stride, int channels,
+               int factor, std::vector<uint8_t> *out)
+{
+  int ow = width / factor, oh = height / factor;
+  size_t orow = (size_t)ow * channels;
+  out->resize(orow * oh);
+  int area = factor * factor;
+
+  for (int y = 0; y < oh; y++) {
+    const uint8_t *row = src + (size_t)y * factor * stride;
+    uint8_t *dst = out->data() + y * orow;
+    for (int x = 0; x < ow; x++) {
+      const uint8_t *p = row + (size_t)x * factor * channels;
+      for (int c = 0; c < channels; c++) {
+        int sum = 0;
+        for (int dy = 0; dy < factor; dy++) {
+          for (int dx = 0; dx < factor; dx++) sum += p[dy * stride + dx * channels + c];
+        }
+        dst[x * channels + c] = (uint8_t)((sum + area / 2) / area);
+      }
+    }
+  }
+}
+
+#ifdef WRO_TURBOJPEG
+
+JpegEncoder::JpegEncoder() : handle(tjInitCompress())
+{
+}
+
+JpegEncoder::~JpegEncoder()
+{
+  if (handle) tjDestroy((tjhandle)handle);
+}
+
+// Output buffer sized for the worst case up front, so TurboJPEG writes in
+// place and never allocates
+bool JpegEncoder::encode(const uint8_t *pixels, int width, int height, size_t stride,
+                         int channels, int quality, std::vector<uint8_t> *out)
+{
+  if (!handle || (channels != 1 && channels != 3)) return false;
+
+  int format = channels == 3 ? TJPF_BGR : TJPF_GRAY;
+  int subsamp = channels == 3 ? TJSAMP_420 : TJSAMP_GRAY;
+  out->resize(tjBufSize(width, height, subsamp));
+
+  unsigned char *buf = out->data();
+  unsigned long size = out->size();
+  int err = tjCompress2((tjhandle)handle, pixels, width, (int)stride, height, format, &buf,
+                        &size, subsamp, quality, TJFLAG_NOREALLOC | TJFLAG_FASTDCT);
+  if (err != 0) return false;
+  out->resize(size);
+  return true;
+}
+
+#endif
+
+}  // namespace native
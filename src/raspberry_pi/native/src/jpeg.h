@@ -0,0 +1,42 @@
+#ifndef NATIVE_JPEG_H
+#define NATIVE_JPEG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Stream encoding: optional integer downscale, then JPEG through
+// libjpeg-turbo's TurboJPEG API (built with WRO_TURBOJPEG, see setup.py).
+
+namespace native {
+
+#define JPEG_MAX_SCALE 4
+
+// Box-filter shrink of a BGR (3 channel) or gray (1 channel) image by
+// factor 1-4. out gets (width / factor) x (height / factor) packed pixels.
+void downscale(const uint8_t *src, int width, int height, size_t stride, int channels,
+               int factor, std::vector<uint8_t> *out);
+
+#ifdef WRO_TURBOJPEG
+
+// A TurboJPEG handle isn't thread safe, so keep one per thread
+class JpegEncoder {
+public:
+  JpegEncoder();
+  ~JpegEncoder();
+  JpegEncoder(const JpegEncoder &) = delete;
+  JpegEncoder &operator=(const JpegEncoder &) = delete;
+
+  // channels 3 = BGR (4:2:0), 1 = gray. Replaces out; false on failure.
+  bool encode(const uint8_t *pixels, int width, int height, size_t stride, int channels,
+              int quality, std::vector<uint8_t> *out);
+
+private:
+  void *handle;
+};
+
+#endif
+
+}  // namespace native
+
+#endif
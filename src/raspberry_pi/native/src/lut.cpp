@@ -0,0 +1,170 @@
+#include "lut.h"
+
+namespace native {
+
+// Cells are classified this many at a time through classify_hsv
+#define BUILD_CHUNK 4096
+
+static bool same_spec(const ColorSpec &a, const ColorSpec &b)
+{
+  if (a.size() != b.size()) return false;
+  for (size_t i = 0; i < a.size(); i++) {
+    for (int k = 0; k < 3; k++) {
+      if (a[i].lo[k] != b[i].lo[k] || a[i].hi[k] != b[i].hi[k]) return false;
+    }
+  }
+  return true;
+}
+
+ColorLut::ColorLut(int bits) : bits(bits)
+{
+  thread = std::thread(&ColorLut::run, this);
+}
+
+ColorLut::~ColorLut()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  thread.join();
+}
+
+void ColorLut::update(const std::vector<ColorSpec> &colors)
+{
+  if (!table()) {
+    std::shared_ptr<const LutTable> first = build(nullptr, colors);
+    std::atomic_store(&current, first);
+    std::lock_guard<std::mutex> lock(mutex);
+    buildCount++;
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending = colors;  // Only the newest matters
+    hasPending = true;
+  }
+  wake.notify_all();
+}
+
+std::shared_ptr<const LutTable> ColorLut::table() const
+{
+  return std::atomic_load(&current);
+}
+
+void ColorLut::wait_idle()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  idle.wait(lock, [this] { return !hasPending && !building; });
+}
+
+uint64_t ColorLut::builds() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return buildCount;
+}
+
+void ColorLut::run()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    wake.wait(lock, [this] { return hasPending || stopping; });
+    if (stopping) return;
+
+    std::vector<ColorSpec> colors;
+    colors.swap(pending);
+    hasPending = false;
+    building = true;
+    lock.unlock();
+
+    std::shared_ptr<const LutTable> next = build(table(), colors);
+    if (next) std::atomic_store(&current, next);
+
+    lock.lock();
+    if (next) buildCount++;
+    building = false;
+    idle.notify_all();
+  }
+}
+
+// Colours whose ranges are unchanged keep their bits from old; the rest
+// are classified again at every cell centre. Null if nothing changed.
+std::shared_ptr<const LutTable> ColorLut::build(const std::shared_ptr<const LutTable> &old,
+                                                const std::vector<ColorSpec> &colors) const
+{
+  size_t cellCount = (size_t)1 << (3 * bits);
+  auto lut = std::make_shared<LutTable>();
+  lut->bits = bits;
+  lut->shift = 8 - bits;
+  lut->colors = colors;
+
+  uint8_t keep = 0;  // Bits carried over from old
+  std::vector<ColorSpec> changed;
+  std::vector<int> changedIndex;
+  bool reuse = old && old->colors.size() == colors.size();
+  for (size_t c = 0; c < colors.size(); c++) {
+    if (reuse && same_spec(old->colors[c], colors[c])) {
+      keep |= (uint8_t)(1 << c);
+    } else {
+      changed.push_back(colors[c]);
+      changedIndex.push_back((int)c);
+    }
+  }
+  if (reuse && changed.empty()) return nullptr;
+
+  if (reuse) {
+    lut->cells.resize(cellCount);
+    for (size_t i = 0; i < cellCount; i++) lut->cells[i] = old->cells[i] & keep;
+  } else {
+    lut->cells.assign(cellCount, 0);
+  }
+  if (changed.empty()) return lut;
+
+  // Cell centres as a row of BGR pixels, classified like a frame
+  int half = bits < 8 ? 1 << (lut->shift - 1) : 0;
+  int side = 1 << bits;
+  uint8_t pixels[BUILD_CHUNK * 3];
+  std::vector<uint8_t> maskBuf(BUILD_CHUNK * changed.size());
+  uint8_t *masks[VISION_MAX_COLORS];
+  for (size_t k = 0; k < changed.size(); k++) masks[k] = maskBuf.data() + k * BUILD_CHUNK;
+
+  for (size_t base = 0; base < cellCount; base += BUILD_CHUNK) {
+    int n = (int)(cellCount - base < BUILD_CHUNK ? cellCount - base : BUILD_CHUNK);
+    for (int i = 0; i < n; i++) {
+      size_t cell = base + i;
+      pixels[3 * i] = (uint8_t)(((cell >> (2 * bits)) << lut->shift) + half);
+      pixels[3 * i + 1] = (uint8_t)((((cell >> bits) & (side - 1)) << lut->shift) + half);
+      pixels[3 * i + 2] = (uint8_t)(((cell & (side - 1)) << lut->shift) + half);
+    }
+    classify_hsv(pixels, n, 1, (size_t)n * 3, changed, masks, BUILD_CHUNK);
+    for (size_t k = 0; k < changed.size(); k++) {
+      uint8_t bit = (uint8_t)(1 << changedIndex[k]);
+      for (int i = 0; i < n; i++) lut->cells[base + i] |= masks[k][i] & bit;
+    }
+  }
+  return lut;
+}
+
+void classify_lut(const uint8_t *bgr, int width, int height, size_t bgr_stride,
+                  const LutTable &lut, int only, uint8_t *const *masks, size_t mask_stride)
+{
+  int count = only >= 0 ? 1 : (int)lut.colors.size();
+  int first = only >= 0 ? only : 0;
+  std::vector<uint8_t> classes(width);
+
+  for (int y = 0; y < height; y++) {
+    const uint8_t *px = bgr + y * bgr_stride;
+    for (int x = 0; x < width; x++) classes[x] = lut.lookup(px[3 * x], px[3 * x + 1], px[3 * x + 2]);
+
+    // Bits to 0/255, a flat loop per colour that vectorizes
+    for (int k = 0; k < count; k++) {
+      uint8_t *out = masks[k] + y * mask_stride;
+      int shift = first + k;
+      for (int x = 0; x < width; x++) out[x] = (uint8_t)-((classes[x] >> shift) & 1);
+    }
+  }
+}
+
+}  // namespace native
@@ -0,0 +1,87 @@
+#ifndef NATIVE_LUT_H
+#define NATIVE_LUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "vision.h"
+
+// Colour classification by table lookup. The BGR cube is quantized to
+// bits per channel and each cell holds a bitmask of the colours its
+// centre falls in (by the same HSV conversion as classify_hsv), so a
+// pixel costs one load instead of an HSV conversion and a range test per
+// box. 6 bits is a 256 kB table that stays in L2; 8 bits is 16 MB but
+// matches classify_hsv exactly.
+//
+// update() hands new ranges to a builder thread, which re-evaluates only
+// the colours whose ranges changed on a copy of the table and swaps it in.
+// Readers keep a reference to the table they started with, so a frame
+// never sees half a rebuild.
+
+namespace native {
+
+#define LUT_MIN_BITS 4
+#define LUT_MAX_BITS 8
+
+struct LutTable {
+  int bits;
+  int shift;  // 8 - bits
+  std::vector<ColorSpec> colors;  // What the cells were built from
+  std::vector<uint8_t> cells;     // [b][g][r], bit c = colour c
+
+  uint8_t lookup(uint8_t b, uint8_t g, uint8_t r) const
+  {
+    return cells[((size_t)(b >> shift) << (2 * bits)) | ((size_t)(g >> shift) << bits) |
+                 (size_t)(r >> shift)];
+  }
+};
+
+class ColorLut {
+public:
+  explicit ColorLut(int bits);
+  ~ColorLut();
+  ColorLut(const ColorLut &) = delete;
+  ColorLut &operator=(const ColorLut &) = delete;
+
+  // New ranges. The first call builds before returning so there is always
+  // a table to use; later ones return at once and the table follows.
+  void update(const std::vector<ColorSpec> &colors);
+
+  // Current table, null before the first update()
+  std::shared_ptr<const LutTable> table() const;
+
+  void wait_idle();  // Until every update() so far is in the table
+  uint64_t builds() const;
+
+  const int bits;
+
+private:
+  std::shared_ptr<const LutTable> build(const std::shared_ptr<const LutTable> &old,
+                                        const std::vector<ColorSpec> &colors) const;
+  void run();
+
+  std::shared_ptr<const LutTable> current;  // std::atomic_load / atomic_store
+
+  mutable std::mutex mutex;
+  std::condition_variable wake, idle;
+  std::vector<ColorSpec> pending;
+  bool hasPending = false;
+  bool building = false;
+  bool stopping = false;
+  uint64_t buildCount = 0;
+  std::thread thread;
+};
+
+// Per-colour 0/255 masks from a table, like classify_hsv. only >= 0
+// classifies just that colour into masks[0].
+void classify_lut(const uint8_t *bgr, int width, int height, size_t bgr_stride,
+                  const LutTable &lut, int only, uint8_t *const *masks, size_t mask_stride);
+
+}  // namespace native
+
+#endif
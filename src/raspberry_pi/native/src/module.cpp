@@ -0,0 +1,598 @@
+// Python bindings for the native kernels. Kept thin: check shapes and
+// types, allocate outputs, drop the GIL and call the plain C++ code.
+
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+
+#include "detect.h"
+#include "esp32_link.h"
+#include "frame_pool.h"
+#include "fusion.h"
+#include "jpeg.h"
+#include "lut.h"
+#include "vision.h"
+
+namespace py = pybind11;
+
+typedef py::array_t<uint8_t> u8array;
+
+// [[(h_lo, s_lo, v_lo, h_hi, s_hi, v_hi), ...], ...] -> one ColorSpec per colour
+static std::vector<native::ColorSpec> parse_colors(const py::sequence &colors)
+{
+  if (colors.size() > VISION_MAX_COLORS) {
+    throw py::value_error("at most " + std::to_string(VISION_MAX_COLORS) + " colours");
+  }
+
+  std::vector<native::ColorSpec> specs;
+  for (py::handle color : colors) {
+    py::sequence boxes = py::reinterpret_borrow<py::sequence>(color);
+    if (boxes.size() < 1 || boxes.size() > VISION_MAX_BOXES) {
+      throw py::value_error("each colour needs 1 to " + std::to_string(VISION_MAX_BOXES) +
+                            " ranges");
+    }
+
+    native::ColorSpec spec;
+    for (py::handle item : boxes) {
+      py::sequence bounds = py::reinterpret_borrow<py::sequence>(item);
+      if (bounds.size() != 6) {
+        throw py::value_error("a range is (h_lo, s_lo, v_lo, h_hi, s_hi, v_hi)");
+      }
+      native::HsvBox box;
+      for (int i = 0; i < 6; i++) {
+        int value = bounds[i].cast<int>();
+        if (value < 0 || value > 255) throw py::value_error("HSV bounds are 0-255");
+        (i < 3 ? box.lo[i] : box.hi[i - 3]) = (uint8_t)value;
+      }
+      spec.push_back(box);
+    }
+    specs.push_back(spec);
+  }
+  return specs;
+}
+
+// colors: a ColorLut, or ranges as for parse_colors. Returns the table to
+// classify with, or null with the ranges in specs.
+static std::shared_ptr<const native::LutTable> parse_classifier(
+    const py::object &colors, std::vector<native::ColorSpec> *specs)
+{
+  if (py::isinstance<native::ColorLut>(colors)) {
+    std::shared_ptr<const native::LutTable> table = colors.cast<native::ColorLut &>().table();
+    if (!table) throw py::value_error("ColorLut has no table before update()");
+    return table;
+  }
+  *specs = parse_colors(py::reinterpret_borrow<py::sequence>(colors));
+  return nullptr;
+}
+
+// frame: HxWx3 uint8 BGR. Rows may be padded or a slice of a bigger
+// frame, but each row must be packed pixels.
+static void check_frame(const u8array &frame)
+{
+  if (frame.ndim() != 3 || frame.shape(2) != 3) {
+    throw py::value_error("frame must be HxWx3");
+  }
+  if (frame.strides(2) != 1 || frame.strides(1) != 3 || frame.strides(0) < frame.shape(1) * 3) {
+    throw py::value_error("frame rows must be packed BGR pixels");
+  }
+}
+
+static py::list py_classify_hsv(const u8array &frame, const py::object &colors)
+{
+  check_frame(frame);
+  std::vector<native::ColorSpec> specs;
+  std::shared_ptr<const native::LutTable> table = parse_classifier(colors, &specs);
+  size_t count = table ? table->colors.size() : specs.size();
+  int height = (int)frame.shape(0);
+  int width = (int)frame.shape(1);
+
+  std::vector<u8array> out;
+  std::vector<uint8_t *> masks;
+  for (size_t c = 0; c < count; c++) {
+    out.emplace_back(std::vector<py::ssize_t>{ height, width });
+    masks.push_back(out.back().mutable_data());
+  }
+
+  const uint8_t *bgr = frame.data();
+  size_t stride = (size_t)frame.strides(0);
+  {
+    py::gil_scoped_release release;
+    if (table) {
+      native::classify_lut(bgr, width, height, stride, *table, -1, masks.data(), (size_t)width);
+    } else {
+      native::classify_hsv(bgr, width, height, stride, specs, masks.data(), (size_t)width);
+    }
+  }
+
+  py::list result;
+  for (u8array &mask : out) result.append(mask);
+  return result;
+}
+
+// roi: (x, y, width, height) or None for the whole frame
+static py::list py_detect_blobs(const u8array &frame, const py::object &colors,
+                                const py::object &roi, int scale, int min_area)
+{
+  check_frame(frame);
+  std::vector<native::ColorSpec> specs;
+  std::shared_ptr<const native::LutTable> table = parse_classifier(colors, &specs);
+  int height = (int)frame.shape(0);
+  int width = (int)frame.shape(1);
+
+  native::Roi region = { 0, 0, width, height };
+  if (!roi.is_none()) {
+    py::sequence r = py::reinterpret_borrow<py::sequence>(roi);
+    if (r.size() != 4) throw py::value_error("roi is (x, y, width, height)");
+    region = { r[0].cast<int>(), r[1].cast<int>(), r[2].cast<int>(), r[3].cast<int>() };
+  }
+  if (scale < 1 || scale > DETECT_MAX_SCALE) {
+    throw py::value_error("scale must be 1 to " + std::to_string(DETECT_MAX_SCALE));
+  }
+
+  std::vector<native::Blob> blobs;
+  const uint8_t *bgr = frame.data();
+  size_t stride = (size_t)frame.strides(0);
+  {
+    py::gil_scoped_release release;
+    if (table) {
+      native::detect_blobs(bgr, width, height, stride, *table, region, scale, min_area, &blobs);
+    } else {
+      native::detect_blobs(bgr, width, height, stride, specs, region, scale, min_area, &blobs);
+    }
+  }
+
+  py::list result;
+  for (const native::Blob &b : blobs) {
+    result.append(py::make_tuple(b.color, b.x, b.y, b.width, b.height, b.area));
+  }
+  return result;
+}
+
+// One reference to a pool slot. Arrays taken from it keep it alive, so
+// the slot is only reused once the last view is gone.
+struct Frame {
+  std::shared_ptr<native::FramePool> pool;
+  int slot;
+  bool writable;
+
+  Frame(std::shared_ptr<native::FramePool> pool, int slot, bool writable)
+    : pool(std::move(pool)), slot(slot), writable(writable) {}
+  Frame(const Frame &) = delete;
+  Frame &operator=(const Frame &) = delete;
+  ~Frame() { pool->release(slot); }
+};
+
+// HxWxC view of the slot, read-only once published
+static py::array frame_array(py::object self)
+{
+  Frame &f = self.cast<Frame &>();
+  const native::FramePool &p = *f.pool;
+  py::array view(py::dtype::of<uint8_t>(),
+                 { (py::ssize_t)p.height, (py::ssize_t)p.width, (py::ssize_t)p.channels },
+                 { (py::ssize_t)p.width * p.channels, (py::ssize_t)p.channels, (py::ssize_t)1 },
+                 f.pool->data(f.slot), self);
+  if (!f.writable) view.attr("setflags")(py::arg("write") = false);
+  return view;
+}
+
+static std::shared_ptr<native::FramePool> make_pool(int slots, int height, int width, int channels)
+{
+  if (slots < 2 || slots > FRAME_POOL_MAX_SLOTS) {
+    throw py::value_error("slots must be 2 to " + std::to_string(FRAME_POOL_MAX_SLOTS));
+  }
+  if (height <= 0 || width <= 0 || channels <= 0) {
+    throw py::value_error("frame dimensions must be positive");
+  }
+  return std::make_shared<native::FramePool>(slots, height, width, channels);
+}
+
+static py::object pool_acquire(const std::shared_ptr<native::FramePool> &pool)
+{
+  int slot = pool->acquire();
+  if (slot < 0) return py::none();
+  return py::cast(new Frame(pool, slot, true), py::return_value_policy::take_ownership);
+}
+
+static void pool_publish(const std::shared_ptr<native::FramePool> &pool, Frame &frame, uint64_t id)
+{
+  if (frame.pool != pool) throw py::value_error("frame is from another pool");
+  pool->publish(frame.slot, id);
+  frame.writable = false;
+}
+
+static py::object pool_latest(const std::shared_ptr<native::FramePool> &pool)
+{
+  int slot = pool->latest(nullptr);
+  if (slot < 0) return py::none();
+  return py::cast(new Frame(pool, slot, false), py::return_value_policy::take_ownership);
+}
+
+#ifdef WRO_TURBOJPEG
+
+// image: HxWx3 BGR or HxW gray, packed rows. Downscaled by scale first.
+static py::bytes py_encode_jpeg(const u8array &image, int quality, int scale)
+{
+  int channels = image.ndim() == 3 ? (int)image.shape(2) : 1;
+  if ((image.ndim() != 2 && image.ndim() != 3) || (channels != 1 && channels != 3)) {
+    throw py::value_error("image must be HxW or HxWx3");
+  }
+  if (image.strides(1) != channels || (image.ndim() == 3 && image.strides(2) != 1)) {
+    throw py::value_error("image rows must be packed pixels");
+  }
+  if (quality < 1 || quality > 100) throw py::value_error("quality must be 1 to 100");
+  if (scale < 1 || scale > JPEG_MAX_SCALE) {
+    throw py::value_error("scale must be 1 to " + std::to_string(JPEG_MAX_SCALE));
+  }
+
+  const uint8_t *pixels = image.data();
+  int height = (int)image.shape(0);
+  int width = (int)image.shape(1);
+  size_t stride = (size_t)image.strides(0);
+
+  static thread_local native::JpegEncoder encoder;
+  static thread_local std::vector<uint8_t> small;
+  std::vector<uint8_t> jpeg;
+  bool ok;
+  {
+    py::gil_scoped_release release;
+    if (scale > 1) {
+      native::downscale(pixels, width, height, stride, channels, scale, &small);
+      pixels = small.data();
+      width /= scale;
+      height /= scale;
+      stride = (size_t)width * channels;
+    }
+    ok = width > 0 && height > 0 &&
+         encoder.encode(pixels, width, height, stride, channels, quality, &jpeg);
+  }
+  if (!ok) throw std::runtime_error("JPEG encode failed");
+  return py::bytes((const char *)jpeg.data(), jpeg.size());
+}
+
+#endif
+
+template <typename T>
+static T get_le(const uint8_t *p)
+{
+  T v;
+  memcpy(&v, p, sizeof(v));  // The Pi is little-endian like the ESP32
+  return v;
+}
+
+// telemetry_record_t fields, in the firmware's units
+static py::dict decode_record(const native::LinkTelemetry &t)
+{
+  const uint8_t *r = t.record;
+  py::dict d;
+  d["rx_ns"] = t.rx_ns;
+  d["time_us"] = get_le<uint32_t>(r);
+  d["type"] = r[4];
+  d["seq"] = r[5];
+  d["flags"] = get_le<uint16_t>(r + 6);
+  const uint8_t *b = r + 8;
+  switch (r[4]) {
+    case LINK_TELEM_STATE:
+      d["count"] = get_le<int32_t>(b);
+      d["velocity"] = get_le<int32_t>(b + 4);
+      d["duty"] = get_le<int16_t>(b + 8);
+      d["steer_cdeg"] = get_le<int16_t>(b + 10);
+      d["overruns"] = get_le<uint32_t>(b + 12);
+      break;
+    case LINK_TELEM_ODOM:
+      d["x"] = get_le<int32_t>(b);
+      d["y"] = get_le<int32_t>(b + 4);
+      d["heading"] = get_le<int16_t>(b + 8);
+      d["yaw_rate"] = get_le<int16_t>(b + 10);
+      d["distance"] = get_le<uint32_t>(b + 12);
+      break;
+    default:
+      d["raw"] = py::bytes((const char *)b, 16);
+      break;
+  }
+  return d;
+}
+
+static py::dict link_snapshot(const native::Esp32Link &link)
+{
+  native::LinkSnapshot s = link.snapshot();
+  py::dict d;
+  py::object none = py::none();
+  if (s.status_rx_ns) {
+    py::dict status;
+    status["rx_ns"] = s.status_rx_ns;
+    status["rtt_ns"] = s.status_rtt_ns;
+    status["count"] = s.status_count;
+    status["seq"] = s.status_seq;
+    d["status"] = status;
+  } else {
+    d["status"] = none;
+  }
+  d["state"] = s.state.rx_ns ? (py::object)decode_record(s.state) : none;
+  d["odom"] = s.odom.rx_ns ? (py::object)decode_record(s.odom) : none;
+  return d;
+}
+
+static py::tuple frame_tuple(const native::LinkFrame &f)
+{
+  return py::make_tuple(f.type, f.seq, py::bytes((const char *)f.payload, LINK_PROTO_PAYLOAD_SIZE),
+                        f.rx_ns, f.rtt_ns);
+}
+
+static py::list link_poll_events(native::Esp32Link &link, int max)
+{
+  py::list out;
+  native::LinkFrame f;
+  while ((int)out.size() < max && link.poll_event(&f)) out.append(frame_tuple(f));
+  return out;
+}
+
+static py::list link_poll_loads(native::Esp32Link &link, int max)
+{
+  py::list out;
+  native::LinkFrame f;
+  while ((int)out.size() < max && link.poll_load(&f)) out.append(frame_tuple(f));
+  return out;
+}
+
+static py::list link_read_telemetry(native::Esp32Link &link, int max)
+{
+  py::list out;
+  native::LinkTelemetry t;
+  while ((int)out.size() < max && link.poll_telemetry(&t)) out.append(decode_record(t));
+  return out;
+}
+
+static py::dict link_stats(const native::Esp32Link &link)
+{
+  native::LinkStats s = link.stats();
+  py::dict d;
+  d["tx_frames"] = s.tx_frames;
+  d["tx_deferred"] = s.tx_deferred;
+  d["rx_frames"] = s.rx_frames;
+  d["rx_telemetry"] = s.rx_telemetry;
+  d["crc_errors"] = s.crc_errors;
+  d["telemetry_gaps"] = s.telemetry_gaps;
+  d["events_dropped"] = s.events_dropped;
+  d["loads_dropped"] = s.loads_dropped;
+  d["telemetry_dropped"] = s.telemetry_dropped;
+  d["rtt_last_ns"] = s.rtt_last_ns;
+  d["rtt_min_ns"] = s.rtt_min_ns;
+  d["rtt_max_ns"] = s.rtt_max_ns;
+  return d;
+}
+
+static py::dict pose_dict(const native::Pose &p)
+{
+  py::dict d;
+  d["t_ns"] = p.t_ns;
+  d["x"] = p.x;
+  d["y"] = p.y;
+  d["heading"] = p.heading;
+  d["yaw_rate"] = p.yaw_rate;
+  d["speed"] = p.speed;
+  d["distance"] = p.distance;
+  return d;
+}
+
+// [(color, angle, x, y, width, height, area), ...]
+static void fusion_add_camera(native::Fusion &fusion, int64_t t_ns, uint64_t frame_id,
+                              const py::sequence &blobs)
+{
+  if (blobs.size() > FUSION_MAX_BLOBS) {
+    throw py::value_error("at most " + std::to_string(FUSION_MAX_BLOBS) + " blobs");
+  }
+  native::CameraFrame frame;
+  frame.t_ns = t_ns;
+  frame.frame_id = frame_id;
+  for (py::handle item : blobs) {
+    py::sequence b = py::reinterpret_borrow<py::sequence>(item);
+    if (b.size() != 7) throw py::value_error("a blob is (color, angle, x, y, width, height, area)");
+    frame.blobs.push_back({ b[0].cast<uint8_t>(), b[1].cast<float>(), b[2].cast<int32_t>(),
+                            b[3].cast<int32_t>(), b[4].cast<int32_t>(), b[5].cast<int32_t>(),
+                            b[6].cast<int32_t>() });
+  }
+  py::gil_scoped_release release;
+  fusion.add_camera(frame);
+}
+
+// [(t_ns, angle, distance), ...]
+static void fusion_add_lidar(native::Fusion &fusion, const py::sequence &points)
+{
+  std::vector<native::LidarPoint> parsed;
+  parsed.reserve(points.size());
+  for (py::handle item : points) {
+    py::sequence p = py::reinterpret_borrow<py::sequence>(item);
+    if (p.size() != 3) throw py::value_error("a point is (t_ns, angle, distance)");
+    parsed.push_back({ p[0].cast<int64_t>(), p[1].cast<float>(), p[2].cast<float>() });
+  }
+  py::gil_scoped_release release;
+  fusion.add_lidar(parsed.data(), parsed.size());
+}
+
+static py::object fusion_pose_at(const native::Fusion &fusion, int64_t t_ns)
+{
+  native::Pose pose;
+  bool interpolated;
+  if (!fusion.pose_at(t_ns, &pose, &interpolated)) return py::none();
+  py::dict d = pose_dict(pose);
+  d["interpolated"] = interpolated;
+  return d;
+}
+
+static py::object fusion_world(const native::Fusion &fusion)
+{
+  std::shared_ptr<const native::WorldState> state = fusion.world();
+  if (!state) return py::none();
+  const native::WorldState &w = *state;
+  py::object none = py::none();
+
+  py::dict d;
+  d["seq"] = w.seq;
+  d["t_ns"] = w.t_ns;
+  d["odom_age_ns"] = w.odom_age_ns;
+  d["clock_offset_ns"] = w.clock_offset_ns;
+  if (w.pose_valid) {
+    py::dict pose = pose_dict(w.pose);
+    pose["interpolated"] = w.pose_interpolated;
+    d["pose"] = pose;
+  } else {
+    d["pose"] = none;
+  }
+
+  if (w.frame_valid) {
+    py::dict frame;
+    frame["id"] = w.frame_id;
+    frame["t_ns"] = w.frame_t_ns;
+    frame["pose"] = pose_dict(w.frame_pose);
+    frame["interpolated"] = w.frame_interpolated;
+    d["frame"] = frame;
+  } else {
+    d["frame"] = none;
+  }
+
+  py::list landmarks;
+  for (const native::Landmark &l : w.landmarks) {
+    py::dict item;
+    item["color"] = l.blob.color;
+    item["angle"] = l.blob.angle;
+    item["bearing"] = l.bearing;
+    item["relative"] = l.relative;
+    item["x"] = l.blob.x;
+    item["y"] = l.blob.y;
+    item["width"] = l.blob.width;
+    item["height"] = l.blob.height;
+    item["area"] = l.blob.area;
+    landmarks.append(item);
+  }
+  d["landmarks"] = landmarks;
+
+  py::list lidar;
+  for (const native::WorldPoint &p : w.lidar) lidar.append(py::make_tuple(p.x, p.y));
+  d["lidar"] = lidar;
+  return d;
+}
+
+PYBIND11_MODULE(_native, m)
+{
+  m.doc() = "Native vision kernels";
+
+  m.def("classify_hsv", &py_classify_hsv, py::arg("frame"), py::arg("colors"),
+        "BGR frame -> list of HxW 0/255 masks, one per colour. Each colour is a\n"
+        "list of (h_lo, s_lo, v_lo, h_hi, s_hi, v_hi) ranges, OR'ed together.\n"
+        "Matches cv2.cvtColor(BGR2HSV) + cv2.inRange exactly. colors may also\n"
+        "be a ColorLut, for its table's colours.");
+
+  m.def("detect_blobs", &py_detect_blobs, py::arg("frame"), py::arg("colors"),
+        py::arg("roi") = py::none(), py::arg("scale") = 1, py::arg("min_area") = 0,
+        "Classify and label 8-connected blobs inside roi (x, y, width, height).\n"
+        "Returns (color_index, x, y, width, height, area) per blob, x/y the\n"
+        "bounding box top-left in frame pixels. scale 2-4 finds candidates on a\n"
+        "subsampled pass first, then measures them at full resolution. colors\n"
+        "may also be a ColorLut.");
+
+  py::class_<native::ColorLut>(m, "ColorLut", "BGR -> colour bitmask lookup table")
+      .def(py::init([](int bits) {
+             if (bits < LUT_MIN_BITS || bits > LUT_MAX_BITS) {
+               throw py::value_error("bits must be " + std::to_string(LUT_MIN_BITS) + " to " +
+                                     std::to_string(LUT_MAX_BITS));
+             }
+             return new native::ColorLut(bits);
+           }), py::arg("bits") = 6)
+      .def("update", [](native::ColorLut &lut, const py::sequence &colors) {
+             std::vector<native::ColorSpec> specs = parse_colors(colors);
+             py::gil_scoped_release release;
+             lut.update(specs);
+           }, py::arg("colors"),
+           "New ranges, as for classify_hsv. The first call builds the table before\n"
+           "returning; later ones rebuild the changed colours on a thread and swap.")
+      .def("wait_idle", &native::ColorLut::wait_idle, py::call_guard<py::gil_scoped_release>(),
+           "Block until every update() so far is in the table")
+      .def_property_readonly("bits", [](const native::ColorLut &lut) { return lut.bits; })
+      .def_property_readonly("ready", [](const native::ColorLut &lut) { return (bool)lut.table(); })
+      .def_property_readonly("builds", &native::ColorLut::builds);
+
+#ifdef WRO_TURBOJPEG
+  m.def("encode_jpeg", &py_encode_jpeg, py::arg("image"), py::arg("quality") = 80,
+        py::arg("scale") = 1,
+        "HxWx3 BGR or HxW gray -> JPEG bytes via libjpeg-turbo, shrunk by an\n"
+        "integer scale (box filter) first.");
+#endif
+
+  m.def("monotonic_ns", &native::monotonic_ns, "CLOCK_MONOTONIC, as time.monotonic_ns()");
+
+  py::class_<native::Esp32Link>(m, "Esp32Link", "Pipelined binary link to the ESP32")
+      .def(py::init<>())
+      .def("open", [](native::Esp32Link &link, const std::string &device, int baud) {
+             if (!link.open(device, baud)) throw std::runtime_error(link.error());
+           }, py::arg("device"), py::arg("baud") = 115200)
+      .def("close", &native::Esp32Link::close, py::call_guard<py::gil_scoped_release>())
+      .def_property_readonly("is_open", &native::Esp32Link::is_open)
+      .def_property_readonly("error", &native::Esp32Link::error)
+      .def("send", [](native::Esp32Link &link, uint8_t type, const py::bytes &payload) {
+             std::string data = payload;
+             return link.send(type, (const uint8_t *)data.data(), data.size());
+           }, py::arg("type"), py::arg("payload") = py::bytes(),
+           "Queue one frame without waiting for the reply. Returns its seq (1-255), -1 if closed.")
+      .def("snapshot", &link_snapshot,
+           "Latest STATUS, STATE and ODOM (None until received), read without locking")
+      .def("poll_events", &link_poll_events, py::arg("max") = 64,
+           "Other frames since the last call, but LOAD: (type, seq, payload, rx_ns, rtt_ns). One consumer.")
+      .def("poll_loads", &link_poll_loads, py::arg("max") = 64,
+           "LOAD frames since the last call, as poll_events(). One consumer.")
+      .def("read_telemetry", &link_read_telemetry, py::arg("max") = 1024,
+           "Every telemetry record since the last call, oldest first. One consumer.")
+      .def("stats", &link_stats);
+
+  py::class_<native::Fusion>(m, "Fusion", "Time-aligned odometry, camera and LIDAR")
+      .def(py::init<>())
+      .def("start", &native::Fusion::start, py::arg("rate_hz"),
+           "Publish a world state rate_hz times a second on a thread")
+      .def("stop", &native::Fusion::stop, py::call_guard<py::gil_scoped_release>())
+      .def_property_readonly("is_running", &native::Fusion::is_running)
+      .def("attach", [](native::Fusion &fusion, native::Esp32Link &link) {
+             native::Fusion *f = &fusion;
+             link.set_telemetry_sink([f](const native::LinkTelemetry &t) { f->add_telemetry(t); });
+           }, py::arg("link"), py::keep_alive<2, 1>(),
+           "Take ODOM records straight from the link's thread, no Python in between")
+      .def("add_odom", [](native::Fusion &fusion, uint32_t time_us, int64_t rx_ns, double x,
+                          double y, double heading, double yaw_rate, double distance) {
+             native::Pose pose = {};
+             pose.x = x;
+             pose.y = y;
+             pose.heading = heading;
+             pose.yaw_rate = yaw_rate;
+             pose.distance = distance;
+             fusion.add_odom(time_us, rx_ns, pose);
+           }, py::arg("time_us"), py::arg("rx_ns"), py::arg("x"), py::arg("y"),
+           py::arg("heading"), py::arg("yaw_rate"), py::arg("distance"),
+           "One odometry sample: ESP32 time_us, arrival time, mm and rad")
+      .def("add_camera", &fusion_add_camera, py::arg("t_ns"), py::arg("frame_id"),
+           py::arg("blobs"), "Blobs of one frame as (color, angle, x, y, width, height, area)")
+      .def("add_lidar", &fusion_add_lidar, py::arg("points"),
+           "LIDAR points as (t_ns, angle, distance)")
+      .def("reset", &native::Fusion::reset, "Drop the odometry history")
+      .def("set_link_latency", &native::Fusion::set_link_latency, py::arg("ns"))
+      .def("pose_at", &fusion_pose_at, py::arg("t_ns"),
+           "Pose at a monotonic_ns() time, or None outside the history")
+      .def("publish", &native::Fusion::publish, py::arg("now_ns"),
+           py::call_guard<py::gil_scoped_release>())
+      .def("world", &fusion_world, "Latest published world state, or None");
+
+  py::class_<Frame>(m, "Frame", "A reference to one pool slot")
+      .def_property_readonly("id", [](const Frame &f) { return f.pool->id(f.slot); })
+      .def_property_readonly("slot", [](const Frame &f) { return f.slot; })
+      .def_property_readonly("array", &frame_array,
+                             "View of the pixels (no copy), read-only once published");
+
+  py::class_<native::FramePool, std::shared_ptr<native::FramePool>>(
+      m, "FramePool", "Preallocated, reference counted frame buffers")
+      .def(py::init(&make_pool), py::arg("slots"), py::arg("height"), py::arg("width"),
+           py::arg("channels") = 3)
+      .def("acquire", &pool_acquire, "Free slot to write into, or None if every slot is held")
+      .def("publish", &pool_publish, py::arg("frame"), py::arg("id"),
+           "Make frame the latest; it turns read-only")
+      .def("latest", &pool_latest, "Latest published frame, or None")
+      .def_property_readonly("held", &native::FramePool::held)
+      .def_property_readonly("shape", [](const native::FramePool &p) {
+        return py::make_tuple(p.height, p.width, p.channels);
+      });
+}
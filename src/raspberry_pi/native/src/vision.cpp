@@ -0,0 +1,103 @@
+#include "vision.h"
+
+namespace native {
+
+// Pixels per chunk. Each stage below is a flat loop over one chunk, which
+// GCC and Clang vectorize at -O3: ld3 deinterleave, 16-lane u8 min/max and
+// compares, 4-lane f32/s32 for the divisions (NEON on the Pi).
+#define CHUNK 64
+
+// OpenCV's fixed point: h and s come from reciprocal tables scaled by
+// 2^12, sdiv[v] = round(255 * 2^12 / v), hdiv[d] = round(180 * 2^12 / (6 d)).
+// Tables don't vectorize on NEON, so the reciprocals are computed per
+// pixel in float instead. For denominators up to 255 a correctly rounded
+// float quotient is far enough from .5 that rounding it gives exactly the
+// table value, so the result stays bit exact.
+#define HSV_SHIFT 12
+#define HSV_ROUND (1 << (HSV_SHIFT - 1))
+#define SDIV_NUM ((float)(255 << HSV_SHIFT))
+#define HDIV_NUM ((float)(180 << HSV_SHIFT) / 6.0f)
+
+static void convert_chunk(const uint8_t *__restrict src, int n,
+                          uint8_t *__restrict h, uint8_t *__restrict s, uint8_t *__restrict v)
+{
+  uint8_t b[CHUNK], g[CHUNK], r[CHUNK], d[CHUNK];
+
+  for (int i = 0; i < n; i++) {
+    b[i] = src[3 * i];
+    g[i] = src[3 * i + 1];
+    r[i] = src[3 * i + 2];
+  }
+
+  for (int i = 0; i < n; i++) {
+    uint8_t hi = b[i] > g[i] ? b[i] : g[i];
+    hi = hi > r[i] ? hi : r[i];
+    uint8_t lo = b[i] < g[i] ? b[i] : g[i];
+    lo = lo < r[i] ? lo : r[i];
+    v[i] = hi;
+    d[i] = hi - lo;
+  }
+
+  // Branch free so it vectorizes: zero denominators divide by 1 and the
+  // result is masked off, quotients are positive so +0.5 and truncate rounds
+  for (int i = 0; i < n; i++) {
+    int32_t bi = b[i], gi = g[i], ri = r[i];
+    int32_t vi = v[i];
+    int32_t di = d[i];
+    int32_t sdiv = (int32_t)(SDIV_NUM / (float)(vi | (vi == 0)) + 0.5f) & -(int32_t)(vi != 0);
+    int32_t hdiv = (int32_t)(HDIV_NUM / (float)(di | (di == 0)) + 0.5f) & -(int32_t)(di != 0);
+
+    // Sextant: v == r wins over v == g, like OpenCV
+    int32_t fromG = bi - ri + 2 * di;
+    int32_t fromB = ri - gi + 4 * di;
+    int32_t hh = vi == ri ? gi - bi : (vi == gi ? fromG : fromB);
+    int32_t hv = (hh * hdiv + HSV_ROUND) >> HSV_SHIFT;
+    hv += 180 & -(int32_t)(hv < 0);
+    h[i] = (uint8_t)hv;
+    s[i] = (uint8_t)((di * sdiv + HSV_ROUND) >> HSV_SHIFT);
+  }
+}
+
+static void mask_chunk(const uint8_t *__restrict h, const uint8_t *__restrict s,
+                       const uint8_t *__restrict v, int n, const HsvBox *boxes, int count,
+                       uint8_t *__restrict out)
+{
+  for (int i = 0; i < n; i++) out[i] = 0;
+
+  for (int k = 0; k < count; k++) {
+    const HsvBox box = boxes[k];
+    for (int i = 0; i < n; i++) {
+      uint8_t in = (h[i] >= box.lo[0]) & (h[i] <= box.hi[0]) &
+                   (s[i] >= box.lo[1]) & (s[i] <= box.hi[1]) &
+                   (v[i] >= box.lo[2]) & (v[i] <= box.hi[2]);
+      out[i] |= (uint8_t)-in;
+    }
+  }
+}
+
+void classify_hsv(const uint8_t *bgr, int width, int height, size_t bgr_stride,
+                  const std::vector<ColorSpec> &colors,
+                  uint8_t *const *masks, size_t mask_stride)
+{
+  uint8_t h[CHUNK], s[CHUNK], v[CHUNK];
+
+  for (int y = 0; y < height; y++) {
+    const uint8_t *row = bgr + y * bgr_stride;
+    for (int x = 0; x < width; x += CHUNK) {
+      int n = width - x < CHUNK ? width - x : CHUNK;
+      convert_chunk(row + 3 * x, n, h, s, v);
+      for (size_t c = 0; c < colors.size(); c++) {
+        mask_chunk(h, s, v, n, colors[c].data(), (int)colors[c].size(),
+                   masks[c] + y * mask_stride + x);
+      }
+    }
+  }
+}
+
+void bgr_to_hsv(uint8_t b, uint8_t g, uint8_t r, uint8_t *h, uint8_t *s, uint8_t *v)
+{
+  uint8_t px[3] = { b, g, r };
+  convert_chunk(px, 1, h, s, v);
+}
+
+}  // namespace native
@@ -0,0 +1,41 @@
+#ifndef NATIVE_VISION_H
+#define NATIVE_VISION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Fused colour classification: one pass over a BGR frame converts each
+// pixel to HSV and tests it against every configured range, writing one
+// 0/255 mask per colour. Replaces cvtColor + one inRange per range.
+//
+// HSV uses OpenCV's 8-bit convention and arithmetic (H 0-179, S and V
+// 0-255, same rounding as cv2.COLOR_BGR2HSV), so the ranges in params.py
+// mean the same thing on both paths.
+
+namespace native {
+
+// Inclusive bounds, like cv2.inRange
+struct HsvBox {
+  uint8_t lo[3];  // H, S, V
+  uint8_t hi[3];
+};
+
+// A colour is the union of its boxes (red needs two, it wraps at 180)
+typedef std::vector<HsvBox> ColorSpec;
+
+#define VISION_MAX_COLORS 8
+#define VISION_MAX_BOXES 4  // Per colour
+
+// bgr: height rows of width * 3 bytes, rows bgr_stride bytes apart.
+// masks[c]: height rows of width bytes, rows mask_stride bytes apart.
+void classify_hsv(const uint8_t *bgr, int width, int height, size_t bgr_stride,
+                  const std::vector<ColorSpec> &colors,
+                  uint8_t *const *masks, size_t mask_stride);
+
+// Same conversion for a single pixel, for tests and LUT builders
+void bgr_to_hsv(uint8_t b, uint8_t g, uint8_t r, uint8_t *h, uint8_t *s, uint8_t *v);
+
+}  // namespace native
+
+#endif
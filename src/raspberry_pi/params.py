@@ -78,8 +78,34 @@ class Parameters:
     # Minimum blob area in pixels (filter out small noise)
     min_area: int = 300
 
+    # Region of interest: only this part of the frame is searched.
+    # Pillars sit in a band around the horizon, so the floor & ceiling
+    # can be cut off. Clipped to the frame; defaults are the full image.
+    roi_x: int = 0
+    roi_y: int = 0
+    roi_width: int = 640
+    roi_height: int = 480
+
+    # Native detector only: 2-4 finds candidates on every Nth pixel,
+    # then measures just those at full resolution. 1 = full resolution.
+    detect_scale: int = 1
+
+    # Exposure to read() returning, ms. Taken off each frame's timestamp
+    # so fusion pairs the blobs with the pose at the moment of capture.
+    camera_latency_ms: int = 30
+
     # ── Methods ─────────────────────────────────────────────────
 
+    def __setattr__(self, name, value):
+        """Count field changes in self.revision (not a field, never saved).
+
+        Anything derived from params (camera.py's colour table) can check
+        revision instead of comparing every field each frame.
+        """
+        super().__setattr__(name, value)
+        if name in self.__dataclass_fields__:
+            object.__setattr__(self, "revision", getattr(self, "revision", 0) + 1)
+
     def update(self, **kwargs):
         """Update parameters from a dict.
 
@@ -0,0 +1,310 @@
+"""
+World model - camera, ESP32 odometry and LIDAR on one clock.
+
+Each sensor arrives at its own rate and with its own delay: a camera
+frame is ~30 ms old by the time its blobs are found, odometry comes in
+USB batches, the LIDAR spins while it scans. If a pillar's
+ColorBlob.angle is simply added to the latest pose, the car has already
+turned by the time the angle is used.
+
+So every measurement keeps the time it was taken (time.monotonic_ns(),
+the Pi's CLOCK_MONOTONIC) and native.Fusion (C++) keeps a short history
+of each stream indexed by that time. The pose of the car at any moment
+is interpolated from the odometry around it, so:
+
+    bearing  = heading at capture time + blob angle     (fixed in the world)
+    relative = bearing - heading now                     (where to steer now)
+
+ESP32 odometry is stamped by the ESP32 clock; Fusion learns the offset
+between the two clocks from the records themselves (see fusion.h).
+
+A thread publishes the fused state at FUSION_RATE_HZ:
+
+    world = WorldModel(camera, esp)
+    world.start()
+    state = world.state()
+    state["pose"]                   # x, y (mm), heading (rad), speed (mm/s)
+    for pillar in state["landmarks"]:
+        pillar["color"], pillar["relative"]
+
+Without the native module the same thing runs in Python.
+"""
+
+import bisect
+import math
+import threading
+import time
+
+import native
+from control.esp32_serial import TELEM_ODOM
+from sensors.camera import COLOR_RANGES
+
+FUSION_RATE_HZ = 50
+
+# Mirrors native/src/fusion.h
+ODOM_HISTORY = 2048
+CAMERA_HISTORY = 8
+LIDAR_HISTORY = 4096
+LIDAR_WINDOW_NS = 100_000_000
+MAX_EXTRAPOLATE_NS = 100_000_000
+CLOCK_DRIFT_PPM = 100
+MAX_BLOBS = 32  # Per frame, largest kept
+
+
+def _wrap(a: float) -> float:
+    return (a + math.pi) % (2 * math.pi) - math.pi
+
+
+class _PyFusion:
+    """Fallback with native.Fusion's interface and behaviour."""
+
+    def __init__(self):
+        self._lock = threading.Lock()
+        self._thread = None
+        self._running = False
+        self._publishes = 0
+        self._world = None
+
+        # Clock sync: unwrapped ESP32 time, offset to the Pi clock
+        self._started = False
+        self._last_us = 0
+        self._remote_ns = 0
+        self._last_rx = 0
+        self._offset = 0
+        self._latency = 0
+
+        self._odom_t = []   # ESP32 clock, sorted
+        self._odom = []     # (x, y, heading, yaw_rate, speed, distance)
+        self._frames = []   # (t_ns, frame_id, blobs)
+        self._lidar_t = []
+        self._lidar = []    # (angle, distance)
+
+    @property
+    def is_running(self) -> bool:
+        return self._running
+
+    def start(self, rate_hz: float):
+        self.stop()
+        self._running = True
+        self._thread = threading.Thread(target=self._run, args=(1.0 / rate_hz,), daemon=True)
+        self._thread.start()
+
+    def stop(self):
+        self._running = False
+        if self._thread:
+            self._thread.join(timeout=1.0)
+            self._thread = None
+
+    def attach(self, link):
+        link.telemetry_sink = self._add_record
+
+    def add_odom(self, time_us, rx_ns, x, y, heading, yaw_rate, distance):
+        with self._lock:
+            step = (time_us - self._last_us + 2**31) % 2**32 - 2**31
+            if self._started and step < -1_000_000:
+                self._started = False  # ESP32 rebooted
+                self._odom_t.clear()
+                self._odom.clear()
+            if not self._started:
+                self._started = True
+                self._remote_ns = time_us * 1000
+                self._offset = rx_ns - self._remote_ns
+            else:
+                self._remote_ns += max(step, 0) * 1000
+                drift = max(rx_ns - self._last_rx, 0) * CLOCK_DRIFT_PPM // 1_000_000
+                self._offset = min(self._offset + drift, rx_ns - self._remote_ns)
+            self._last_us = time_us
+            self._last_rx = rx_ns
+
+            t = self._remote_ns
+            speed = 0.0
+            if self._odom:
+                dt = t - self._odom_t[-1]
+                if dt <= 0:
+                    return
+                px, py = self._odom[-1][:2]
+                speed = ((x - px) * math.cos(heading) + (y - py) * math.sin(heading)) * 1e9 / dt
+            self._odom_t.append(t)
+            self._odom.append((x, y, heading, yaw_rate, speed, distance))
+            if len(self._odom) > ODOM_HISTORY:
+                del self._odom_t[0], self._odom[0]
+
+    def add_camera(self, t_ns, frame_id, blobs):
+        with self._lock:
+            self._frames.append((t_ns, frame_id, list(blobs)))
+            del self._frames[:-CAMERA_HISTORY]
+
+    def add_lidar(self, points):
+        with self._lock:
+            for t_ns, angle, distance in points:
+                self._lidar_t.append(t_ns)
+                self._lidar.append((angle, distance))
+            del self._lidar_t[:-LIDAR_HISTORY], self._lidar[:-LIDAR_HISTORY]
+
+    def reset(self):
+        with self._lock:
+            self._odom_t.clear()
+            self._odom.clear()
+
+    def set_link_latency(self, ns):
+        with self._lock:
+            self._latency = max(int(ns), 0)
+
+    def pose_at(self, t_ns):
+        with self._lock:
+            return self._pose_at(t_ns)
+
+    def publish(self, now_ns):
+        with self._lock:
+            pose = self._pose_at(now_ns)
+            offset = self._offset - self._latency
+            age = now_ns - (self._odom_t[-1] + offset) if self._odom else -1
+
+            frame = None
+            landmarks = []
+            if self._frames:
+                t_ns, frame_id, blobs = self._frames[-1]
+                at = self._pose_at(t_ns)
+                if at is not None:
+                    frame = {"id": frame_id, "t_ns": t_ns, "pose": at,
+                             "interpolated": at.pop("interpolated")}
+                    for color, angle, x, y, w, h, area in blobs:
+                        bearing = _wrap(at["heading"] + angle)
+                        relative = _wrap(bearing - pose["heading"]) if pose else angle
+                        landmarks.append({"color": color, "angle": angle, "bearing": bearing,
+                                          "relative": relative, "x": x, "y": y,
+                                          "width": w, "height": h, "area": area})
+
+            lidar = []
+            first = bisect.bisect_right(self._lidar_t, now_ns - LIDAR_WINDOW_NS)
+            for t_ns, (angle, distance) in zip(self._lidar_t[first:], self._lidar[first:]):
+                at = self._pose_at(t_ns)
+                if at is None:
+                    continue
+                a = at["heading"] + angle
+                lidar.append((at["x"] + distance * math.cos(a), at["y"] + distance * math.sin(a)))
+
+        self._publishes += 1
+        self._world = {"seq": self._publishes, "t_ns": now_ns, "odom_age_ns": age,
+                       "clock_offset_ns": offset, "pose": pose, "frame": frame,
+                       "landmarks": landmarks, "lidar": lidar}
+
+    def world(self):
+        return self._world
+
+    def _add_record(self, record: dict):
+        if record["type"] != TELEM_ODOM:
+            return
+        self.add_odom(record["time_us"], record["rx_ns"], record["x"] * 0.1, record["y"] * 0.1,
+                      record["heading"] * 1e-4, record["yaw_rate"] * 1e-3, record["distance"])
+
+    def _pose_at(self, t_ns):
+        """Same as Fusion::pose_at_locked() in fusion.cpp."""
+        if not self._odom:
+            return None
+        t = t_ns - self._offset + self._latency
+        i = bisect.bisect_right(self._odom_t, t) - 1
+        if i < 0:
+            return None
+        ax, ay, ah, aw, av, ad = self._odom[i]
+        if i + 1 < len(self._odom):
+            bx, by, bh, bw, bv, bd = self._odom[i + 1]
+            f = (t - self._odom_t[i]) / (self._odom_t[i + 1] - self._odom_t[i])
+            pose = {"x": ax + (bx - ax) * f, "y": ay + (by - ay) * f,
+                    "heading": _wrap(ah + _wrap(bh - ah) * f), "yaw_rate": aw + (bw - aw) * f,
+                    "speed": bv, "distance": ad + (bd - ad) * f, "interpolated": True}
+        else:
+            ahead = t - self._odom_t[i]
+            if ahead > MAX_EXTRAPOLATE_NS:
+                return None
+            dt = ahead * 1e-9
+            mid = ah + aw * dt / 2
+            pose = {"x": ax + av * dt * math.cos(mid), "y": ay + av * dt * math.sin(mid),
+                    "heading": _wrap(ah + aw * dt), "yaw_rate": aw, "speed": av,
+                    "distance": ad + abs(av) * dt, "interpolated": False}
+        pose["t_ns"] = t_ns
+        return pose
+
+    def _run(self, period: float):
+        deadline = time.monotonic()
+        while self._running:
+            deadline += period
+            time.sleep(max(deadline - time.monotonic(), 0))
+            now = time.monotonic()
+            if now - deadline > period:
+                deadline = now
+            self.publish(time.monotonic_ns())
+
+
+class WorldModel:
+    """
+    Feeds the camera and ESP32 into the fusion core and hands out the
+    fused state. Camera frames arrive through Camera.subscribe(), ESP32
+    odometry straight from the link thread.
+    """
+
+    def __init__(self, camera, esp=None, rate_hz: float = FUSION_RATE_HZ):
+        self.camera = camera
+        self.esp = esp
+        self.rate_hz = rate_hz
+        self._colors = list(COLOR_RANGES)
+        self._fusion = native.Fusion() if native.AVAILABLE else _PyFusion()
+
+    def start(self, publish_thread: bool = True):
+        """Hook up the sources. Replays pass False and call publish() on log time."""
+        if self.esp is not None:
+            self._fusion.attach(self.esp.link)
+        self.camera.subscribe(self._on_frame)
+        if publish_thread:
+            self._fusion.start(self.rate_hz)
+
+    def stop(self):
+        self._fusion.stop()
+
+    def state(self) -> dict | None:
+        """Latest fused state (see the module docstring), None before the first."""
+        world = self._fusion.world()
+        if world is None:
+            return None
+        world = dict(world)
+        world["landmarks"] = [{**l, "color": self._colors[l["color"]]} for l in world["landmarks"]]
+        return world
+
+    def pose_at(self, t_ns: int) -> dict | None:
+        """Pose at a time.monotonic_ns() moment, None if out of the history."""
+        return self._fusion.pose_at(t_ns)
+
+    def odom_reset(self):
+        """Call along with Esp32Serial.odom_reset(): the old poses are void."""
+        self._fusion.reset()
+
+    def add_lidar(self, points):
+        """LIDAR samples as (t_ns, angle rad CCW from forward, distance mm)."""
+        self._fusion.add_lidar(points)
+
+    def add_telemetry(self, record: dict):
+        """A decoded telemetry record, for sources other than the live link."""
+        if record["type"] == TELEM_ODOM:
+            self._fusion.add_odom(record["time_us"], record["rx_ns"],
+                                  record["x"] * 0.1, record["y"] * 0.1,
+                                  record["heading"] * 1e-4, record["yaw_rate"] * 1e-3,
+                                  record["distance"])
+
+    def publish(self, now_ns: int):
+        """Publish the state at now_ns without the thread."""
+        self._fusion.publish(now_ns)
+
+    def _on_frame(self, frame_id: int, t_ns: int, blobs, image):
+        """Camera thread, once per frame."""
+        # ColorBlob.angle is degrees, positive to the right; fusion wants
+        # radians counter-clockwise like the odometry heading
+        blobs = sorted(blobs, key=lambda b: b.area, reverse=True)[:MAX_BLOBS]
+        items = [(self._colors.index(b.color), -math.radians(b.angle),
+                  b.x, b.y, b.width, b.height, b.area) for b in blobs]
+        self._fusion.add_camera(t_ns, frame_id, items)
+
+        # Half the best STATUS round trip is the odometry's one-way delay
+        if self.esp is not None:
+            rtt = self.esp.stats().get("rtt_min_ns", -1)
+            if rtt > 0:
+                self._fusion.set_link_latency(rtt // 2)
@@ -0,0 +1,253 @@
+"""
+Vision benchmark - time Camera detection over a set of stored frames.
+
+Runs the same Camera._color_masks() / _detect_blobs() the capture thread
+runs, once per implementation, over every frame of a directory of images
+(.jpg / .png, e.g. t-photos/ or v-photos/) or of a recorded binlog:
+
+    python -m recording.bench runs/today.wlog
+    python -m recording.bench ../../v-photos --set min_area=300 --set detect_scale=2
+    python -m recording.bench frames/ --resize 320x240 --repeat 5 --json after.json
+
+Implementations (only those available are run):
+
+    python      OpenCV: cvtColor + inRange, erode / dilate, contours
+    native      C++ kernel through the colour table (native.ColorLut)
+    native-hsv  C++ kernel converting every pixel to HSV
+
+For each it reports frames/s of the whole detection and p50 / p99 per
+stage:
+
+    masks    colour masks of the ROI (what the streams and detection start from)
+    detect   _detect_blobs(), masks through to the blob list
+
+and how far it agrees with the first implementation run: mask pixels
+that match, and blobs matched one to one (same colour, boxes overlapping
+by at least BLOB_MATCH_IOU). All three open the masks and measure areas
+alike, so at detect_scale 1 native-hsv should match python, and
+native apart from the table's quantization. Blobs nested inside a hole
+of a same-coloured blob show up natively only (see native/__init__.py).
+
+--json writes the numbers for comparing two runs.
+"""
+
+import argparse
+import json
+import time
+from dataclasses import asdict
+from pathlib import Path
+
+import cv2
+import numpy as np
+
+import native
+from params import Parameters
+from recording.binlog import REC_FRAME_JPEG, REC_FRAME_RAW, LogReader, unpack_frame
+from sensors.camera import COLOR_RANGES, Camera
+
+IMAGE_SUFFIXES = (".jpg", ".jpeg", ".png", ".bmp")
+BLOB_MATCH_IOU = 0.5
+IMPLEMENTATIONS = ("python", "native", "native-hsv")
+
+
+def load_frames(source: str, resize: tuple[int, int] | None = None) -> list[np.ndarray]:
+    """BGR frames from an image directory or a binlog, optionally resized."""
+    path = Path(source)
+    frames = []
+    if path.is_dir():
+        for file in sorted(path.iterdir()):
+            if file.suffix.lower() in IMAGE_SUFFIXES:
+                image = cv2.imread(str(file), cv2.IMREAD_COLOR)
+                if image is not None:
+                    frames.append(image)
+    else:
+        with LogReader(path) as log:
+            for rec in log.records(REC_FRAME_RAW, REC_FRAME_JPEG):
+                _, _, image = unpack_frame(rec)
+                if rec.type == REC_FRAME_JPEG:
+                    image = cv2.imdecode(np.frombuffer(image, np.uint8), cv2.IMREAD_COLOR)
+                    if image is None:
+                        continue
+                else:
+                    image = np.array(image)  # Off the mapping before it closes
+                frames.append(image)
+
+    if resize:
+        frames = [cv2.resize(f, resize, interpolation=cv2.INTER_AREA) for f in frames]
+    return frames
+
+
+def parse_value(current, text: str):
+    """--set text as the type of the param's current value (int, float or str)."""
+    if isinstance(current, int):
+        return int(text)
+    if isinstance(current, float):
+        return float(text)
+    return text
+
+
+def make_camera(params: Parameters, implementation: str) -> Camera:
+    """A Camera that is never started, set to one implementation."""
+    camera = Camera(params)
+    camera.use_native = implementation != "python"
+    camera.use_lut = implementation == "native"
+    if camera.use_native:
+        camera._classifier()
+        camera._lut.wait_idle()  # Time lookups, not the table build
+    return camera
+
+
+def percentile(values: list[float], p: float) -> float:
+    if not values:
+        return 0.0
+    ordered = sorted(values)
+    return ordered[min(int(len(ordered) * p / 100), len(ordered) - 1)]
+
+
+def run(camera: Camera, frames: list[np.ndarray], repeat: int = 1, warmup: int = 2) -> dict:
+    """Time every stage on every frame. Returns timings (ms), masks and blobs of the last pass."""
+    names = list(COLOR_RANGES)
+    timings = {"masks": [], "detect": []}
+    masks, blobs = [], []
+
+    for _ in range(min(warmup, len(frames))):
+        camera._detect_blobs(frames[0])
+
+    for rep in range(repeat):
+        for frame in frames:
+            x, y, w, h = camera._roi(frame)
+            roi = frame[y:y + h, x:x + w]
+
+            started = time.perf_counter_ns()
+            frame_masks = camera._color_masks(roi, names)
+            timings["masks"].append((time.perf_counter_ns() - started) / 1e6)
+
+            started = time.perf_counter_ns()
+            frame_blobs = camera._detect_blobs(frame)
+            timings["detect"].append((time.perf_counter_ns() - started) / 1e6)
+
+            if rep == repeat - 1:
+                masks.append(frame_masks)
+                blobs.append(frame_blobs)
+
+    return {"timings": timings, "masks": masks, "blobs": blobs}
+
+
+def _iou(a, b) -> float:
+    ax0, ay0 = a.x - a.width // 2, a.y - a.height // 2
+    bx0, by0 = b.x - b.width // 2, b.y - b.height // 2
+    w = min(ax0 + a.width, bx0 + b.width) - max(ax0, bx0)
+    h = min(ay0 + a.height, by0 + b.height) - max(ay0, by0)
+    if w <= 0 or h <= 0:
+        return 0.0
+    inter = w * h
+    return inter / (a.width * a.height + b.width * b.height - inter)
+
+
+def agreement(reference: dict, other: dict) -> dict:
+    """Mask pixels and blobs of other that agree with reference."""
+    same_px = total_px = 0
+    for ref_masks, masks in zip(reference["masks"], other["masks"]):
+        for color in ref_masks:
+            same_px += int(np.count_nonzero(ref_masks[color] == masks[color]))
+            total_px += ref_masks[color].size
+
+    matched = ref_count = other_count = same_frames = 0
+    for ref_blobs, blobs in zip(reference["blobs"], other["blobs"]):
+        left = list(blobs)
+        found = 0
+        for blob in ref_blobs:
+            best = max((b for b in left if b.color == blob.color),
+                       key=lambda b: _iou(blob, b), default=None)
+            if best is not None and _iou(blob, best) >= BLOB_MATCH_IOU:
+                left.remove(best)
+                found += 1
+        matched += found
+        ref_count += len(ref_blobs)
+        other_count += len(blobs)
+        if found == len(ref_blobs) == len(blobs):
+            same_frames += 1
+
+    frames = len(reference["blobs"])
+    return {
+        "mask_match_pct": 100.0 * same_px / total_px if total_px else 100.0,
+        "blobs_matched": matched,
+        "blobs_reference": ref_count,
+        "blobs": other_count,
+        "frames_same_pct": 100.0 * same_frames / frames if frames else 100.0,
+    }
+
+
+def summarize(result: dict) -> dict:
+    out = {}
+    for stage, values in result["timings"].items():
+        out[stage] = {"p50_ms": percentile(values, 50), "p99_ms": percentile(values, 99),
+                      "mean_ms": sum(values) / len(values) if values else 0.0}
+    detect = result["timings"]["detect"]
+    out["fps"] = len(detect) / (sum(detect) / 1e3) if detect and sum(detect) > 0 else 0.0
+    return out
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Benchmark Camera detection on stored frames")
+    parser.add_argument("source", help="directory of images, or a binlog")
+    parser.add_argument("--impl", action="append", choices=IMPLEMENTATIONS,
+                        help="implementation to run, repeatable (default: all available)")
+    parser.add_argument("--set", action="append", default=[], metavar="KEY=VALUE",
+                        help="override a param, e.g. min_area=300")
+    parser.add_argument("--defaults", action="store_true", help="default params, not params.json")
+    parser.add_argument("--resize", metavar="WxH", help="scale every frame first, e.g. 320x240")
+    parser.add_argument("--repeat", type=int, default=3, help="passes over the frames")
+    parser.add_argument("--json", metavar="FILE", help="also write the results here")
+    args = parser.parse_args()
+
+    resize = tuple(int(v) for v in args.resize.lower().split("x")) if args.resize else None
+    frames = load_frames(args.source, resize)
+    if not frames:
+        parser.error(f"no frames in {args.source}")
+
+    params = Parameters() if args.defaults else Parameters.load()
+    for item in args.set:
+        key, _, value = item.partition("=")
+        if not hasattr(params, key):
+            parser.error(f"unknown param {key}")
+        try:
+            setattr(params, key, parse_value(getattr(params, key), value))
+        except ValueError as e:
+            parser.error(f"--set {key}: {e}")
+
+    impls = args.impl or [i for i in IMPLEMENTATIONS if i == "python" or native.AVAILABLE]
+    if not native.AVAILABLE and any(i != "python" for i in impls):
+        parser.error(f"native module not available ({native.UNAVAILABLE_REASON})")
+
+    h, w = frames[0].shape[:2]
+    print(f"{len(frames)} frames {w}x{h} from {args.source}, {args.repeat} passes, "
+          f"min_area={params.min_area} detect_scale={params.detect_scale}")
+
+    results, report = {}, {}
+    for impl in impls:
+        results[impl] = run(make_camera(params, impl), frames, args.repeat)
+        report[impl] = summarize(results[impl])
+        if impl != impls[0]:
+            report[impl]["agreement"] = agreement(results[impls[0]], results[impl])
+
+    print(f"\n{'':12}{'fps':>8}{'masks p50':>11}{'p99':>8}{'detect p50':>12}{'p99':>8}  ms")
+    for impl in impls:
+        r = report[impl]
+        print(f"{impl:12}{r['fps']:8.1f}{r['masks']['p50_ms']:11.2f}{r['masks']['p99_ms']:8.2f}"
+              f"{r['detect']['p50_ms']:12.2f}{r['detect']['p99_ms']:8.2f}")
+    for impl in impls[1:]:
+        a = report[impl]["agreement"]
+        print(f"{impl} vs {impls[0]}: masks {a['mask_match_pct']:.3f} % same, "
+              f"blobs {a['blobs_matched']}/{a['blobs_reference']} matched "
+              f"({a['blobs']} found), {a['frames_same_pct']:.1f} % of frames identical")
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump({"source": args.source, "frames": len(frames), "size": [w, h],
+                       "params": asdict(params),
+                       "results": report}, f, indent=2)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,299 @@
+"""
+Binary run log - one append-only file per run, read back through mmap.
+
+Layout (little-endian):
+
+    file header   16 B   "WROLOG" | uint16 version | int64 wall-clock ns at creation
+    record        16 B   uint32 size | uint16 type | uint16 flags | int64 t_ns
+                  size B payload, then zero padding to a multiple of 8
+
+t_ns is time.monotonic_ns() when the data became available on the Pi,
+so replaying in t_ns order (by_time()) gives the order the live run saw.
+File order is only roughly that, a writer thread may lag. Payloads that
+measure something at another moment (a frame's capture time, a
+telemetry record's arrival) carry that time themselves.
+
+Every record starts 8-byte aligned, so a raw frame's pixels can be
+handed out as a numpy view of the mapping without a copy. A run cut
+short (crash, power) leaves at most one partial record at the end,
+which the reader drops. A writer opening that file again cuts it off
+first, so what it appends starts on a record boundary.
+
+    with LogWriter("run.wlog") as log:
+        log.write(REC_PARAMS, t_ns, pack_params(params))
+
+    log = LogReader("run.wlog")
+    for rec in log:
+        rec.type, rec.t_ns, rec.payload   # payload is a memoryview
+"""
+
+import json
+import mmap
+import os
+import struct
+import threading
+import time
+from dataclasses import asdict
+
+import numpy as np
+
+LOG_MAGIC = b"WROLOG"
+LOG_VERSION = 1
+FILE_HEADER = struct.Struct("<6sHq")
+RECORD_HEADER = struct.Struct("<IHHq")
+ALIGN = 8
+
+# Record types
+REC_PARAMS = 1      # Parameters as JSON, at start and on every change
+REC_FRAME_RAW = 2   # FRAME_HEADER + height * width * channels pixels
+REC_FRAME_JPEG = 3  # FRAME_HEADER (height / width / channels 0) + JPEG bytes
+REC_BLOBS = 4       # BLOBS_HEADER + count * BLOB
+REC_TELEMETRY = 5   # count * TELEMETRY_ITEM, a batch as it came off the link
+REC_COMMAND = 6     # COMMAND, one frame sent to the ESP32
+
+FRAME_HEADER = struct.Struct("<QqHHH2x")    # frame_id, capture t_ns, height, width, channels
+BLOBS_HEADER = struct.Struct("<QqH6x")      # frame_id, capture t_ns, count
+BLOB = struct.Struct("<B3xfhhhhI")          # color index, angle (deg), x, y, width, height, area
+TELEMETRY_ITEM = struct.Struct("<q24s")     # rx_ns, telemetry_record_t
+COMMAND = struct.Struct("<BB8s")            # type, seq, payload
+
+# Colour index in BLOB records
+BLOB_COLORS = ("red", "green", "magenta")
+
+
+def _complete_end(f, path: str) -> int:
+    """Offset just past the last whole, padded record of an existing log."""
+    f.seek(0)
+    header = f.read(FILE_HEADER.size)
+    if len(header) < FILE_HEADER.size:
+        raise ValueError(f"{path}: not a run log")
+    magic, version, _ = FILE_HEADER.unpack(header)
+    if magic != LOG_MAGIC:
+        raise ValueError(f"{path}: not a run log")
+    if version != LOG_VERSION:
+        raise ValueError(f"{path}: log version {version}, need {LOG_VERSION}")
+
+    size = os.fstat(f.fileno()).st_size
+    end = FILE_HEADER.size
+    while end + RECORD_HEADER.size <= size:
+        f.seek(end)
+        rec_size = RECORD_HEADER.unpack(f.read(RECORD_HEADER.size))[0]
+        next_end = end + RECORD_HEADER.size + rec_size + (-rec_size % ALIGN)
+        if next_end > size:
+            break
+        end = next_end
+    return end
+
+
+class LogWriter:
+    """Appends records to a log file, new or left by an earlier run. Thread safe."""
+
+    def __init__(self, path):
+        self.path = str(path)
+        self._lock = threading.Lock()
+        if os.path.exists(self.path) and os.path.getsize(self.path) > 0:
+            self._file = open(self.path, "r+b", buffering=1 << 20)
+            end = _complete_end(self._file, self.path)
+            self._file.truncate(end)  # A partial record from a crash
+            self._file.seek(end)
+        else:
+            self._file = open(self.path, "wb", buffering=1 << 20)
+            self._file.write(FILE_HEADER.pack(LOG_MAGIC, LOG_VERSION, time.time_ns()))
+        self.records = 0
+        self.bytes = self._file.tell()
+        self.dropped = 0  # Written after close()
+
+    def write(self, rec_type: int, t_ns: int, *parts):
+        """One record; parts (bytes-like) are concatenated into its payload.
+
+        After close() the record is counted in dropped instead: a camera or
+        sender thread already inside its callback can still get here while
+        the recorder stops, and must not die of a closed file.
+        """
+        size = sum(memoryview(p).nbytes for p in parts)
+        pad = -size % ALIGN
+        with self._lock:
+            if self._file.closed:
+                self.dropped += 1
+                return
+            self._file.write(RECORD_HEADER.pack(size, rec_type, 0, t_ns))
+            for part in parts:
+                self._file.write(part)
+            if pad:
+                self._file.write(b"\0" * pad)
+            self.records += 1
+            self.bytes += RECORD_HEADER.size + size + pad
+
+    def flush(self):
+        with self._lock:
+            if not self._file.closed:
+                self._file.flush()
+
+    def close(self):
+        with self._lock:
+            if not self._file.closed:
+                self._file.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+
+class Record:
+    __slots__ = ("type", "flags", "t_ns", "payload")
+
+    def __init__(self, rec_type, flags, t_ns, payload):
+        self.type = rec_type
+        self.flags = flags
+        self.t_ns = t_ns
+        self.payload = payload  # memoryview into the mapping
+
+
+class LogReader:
+    """Memory-maps a log and indexes its records. Nothing is copied until asked."""
+
+    def __init__(self, path):
+        self.path = str(path)
+        self._file = open(self.path, "rb")
+        size = os.fstat(self._file.fileno()).st_size
+        if size < FILE_HEADER.size:
+            raise ValueError(f"{self.path}: not a run log")
+        self._map = mmap.mmap(self._file.fileno(), 0, access=mmap.ACCESS_READ)
+        self._view = memoryview(self._map)
+
+        magic, self.version, self.created_ns = FILE_HEADER.unpack_from(self._map)
+        if magic != LOG_MAGIC:
+            raise ValueError(f"{self.path}: not a run log")
+        if self.version != LOG_VERSION:
+            raise ValueError(f"{self.path}: log version {self.version}, need {LOG_VERSION}")
+
+        # (offset, type, flags, t_ns, size) per whole record
+        self._index = []
+        offset = FILE_HEADER.size
+        while offset + RECORD_HEADER.size <= size:
+            rec_size, rec_type, flags, t_ns = RECORD_HEADER.unpack_from(self._map, offset)
+            start = offset + RECORD_HEADER.size
+            if start + rec_size > size:
+                break  # Cut off mid-record
+            self._index.append((start, rec_type, flags, t_ns, rec_size))
+            offset = start + rec_size + (-rec_size % ALIGN)
+
+    def __len__(self):
+        return len(self._index)
+
+    def __getitem__(self, i) -> Record:
+        start, rec_type, flags, t_ns, size = self._index[i]
+        return Record(rec_type, flags, t_ns, self._view[start:start + size])
+
+    def __iter__(self):
+        for i in range(len(self._index)):
+            yield self[i]
+
+    def records(self, *types):
+        """Records of the given types (all if none), in file order."""
+        for i, (_, rec_type, _, _, _) in enumerate(self._index):
+            if not types or rec_type in types:
+                yield self[i]
+
+    def by_time(self, *types):
+        """Like records(), in t_ns order (stable, so ties keep file order)."""
+        order = sorted(range(len(self._index)), key=lambda i: self._index[i][3])
+        for i in order:
+            if not types or self._index[i][1] in types:
+                yield self[i]
+
+    def count(self, rec_type: int) -> int:
+        return sum(1 for entry in self._index if entry[1] == rec_type)
+
+    @property
+    def start_ns(self) -> int:
+        return min(entry[3] for entry in self._index) if self._index else 0
+
+    @property
+    def end_ns(self) -> int:
+        return max(entry[3] for entry in self._index) if self._index else 0
+
+    def close(self):
+        # Views still handed out keep the mapping alive until they go
+        try:
+            self._view.release()
+            self._map.close()
+        except BufferError:
+            pass
+        self._file.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+
+# ── Payloads ─────────────────────────────────────────────────────
+
+def pack_params(params) -> bytes:
+    return json.dumps(asdict(params)).encode()
+
+
+def unpack_params(payload) -> dict:
+    return json.loads(bytes(payload))
+
+
+def pack_frame_raw(frame_id: int, t_ns: int, image: np.ndarray):
+    h, w = image.shape[:2]
+    channels = image.shape[2] if image.ndim == 3 else 1
+    return FRAME_HEADER.pack(frame_id, t_ns, h, w, channels), np.ascontiguousarray(image)
+
+
+def pack_frame_jpeg(frame_id: int, t_ns: int, jpeg: bytes):
+    return FRAME_HEADER.pack(frame_id, t_ns, 0, 0, 0), jpeg
+
+
+def unpack_frame(rec: Record):
+    """(frame_id, capture t_ns, image or JPEG bytes). A raw image is a read-only view."""
+    frame_id, t_ns, h, w, channels = FRAME_HEADER.unpack_from(rec.payload)
+    data = rec.payload[FRAME_HEADER.size:]
+    if rec.type == REC_FRAME_JPEG:
+        return frame_id, t_ns, data
+    shape = (h, w, channels) if channels > 1 else (h, w)
+    return frame_id, t_ns, np.frombuffer(data, np.uint8).reshape(shape)
+
+
+def pack_blobs(frame_id: int, t_ns: int, blobs) -> bytes:
+    """ColorBlob list -> payload. Colours outside BLOB_COLORS are left out."""
+    items = [BLOB.pack(BLOB_COLORS.index(b.color), b.angle, b.x, b.y, b.width, b.height,
+                       b.area)
+             for b in blobs if b.color in BLOB_COLORS]
+    return BLOBS_HEADER.pack(frame_id, t_ns, len(items)) + b"".join(items)
+
+
+def unpack_blobs(payload):
+    """(frame_id, capture t_ns, [(color, angle, x, y, width, height, area), ...])"""
+    frame_id, t_ns, count = BLOBS_HEADER.unpack_from(payload)
+    blobs = []
+    for i in range(count):
+        color, *rest = BLOB.unpack_from(payload, BLOBS_HEADER.size + i * BLOB.size)
+        blobs.append((BLOB_COLORS[color], *rest))
+    return frame_id, t_ns, blobs
+
+
+def pack_telemetry(items) -> bytes:
+    """[(rx_ns, 24 record bytes), ...] -> payload"""
+    return b"".join(TELEMETRY_ITEM.pack(rx_ns, record) for rx_ns, record in items)
+
+
+def unpack_telemetry(payload):
+    """-> [(rx_ns, 24 record bytes), ...]"""
+    return [TELEMETRY_ITEM.unpack_from(payload, i)
+            for i in range(0, len(payload), TELEMETRY_ITEM.size)]
+
+
+def pack_command(msg_type: int, seq: int, payload: bytes) -> bytes:
+    return COMMAND.pack(msg_type, seq, payload[:8])
+
+
+def unpack_command(payload):
+    """-> (type, seq, 8 payload bytes)"""
+    return COMMAND.unpack_from(payload)
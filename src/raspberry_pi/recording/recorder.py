@@ -0,0 +1,161 @@
+"""
+Recorder - writes a live run to a binlog for replay.
+
+Hooks into what's already there: Camera.subscribe() for frames and
+blobs, Esp32Serial.command_sink for commands, Esp32Serial.telemetry()
+for the telemetry stream, and the params object for tuning changes.
+
+    recorder = Recorder("runs/today.wlog", camera, esp, params)
+    recorder.start()
+    ...
+    recorder.stop()
+
+The camera thread only queues the frame (a reference to the pool
+buffer, no copy); a writer thread encodes and writes it. If the writer
+falls behind, frames are dropped and counted rather than holding up
+capture. Blobs, telemetry and commands are never dropped.
+
+frames="jpeg" keeps runs small (~40 kB/frame); "raw" keeps the exact
+pixels (900 kB/frame at 640x480) so a replay detects exactly what the
+car saw; None records no frames at all.
+"""
+
+import queue
+import threading
+import time
+from dataclasses import asdict
+
+import cv2
+
+import native
+from control.esp32_serial import encode_record
+from recording.binlog import (
+    REC_BLOBS, REC_COMMAND, REC_FRAME_JPEG, REC_FRAME_RAW, REC_PARAMS, REC_TELEMETRY,
+    LogWriter, pack_blobs, pack_command, pack_frame_jpeg, pack_frame_raw, pack_params,
+    pack_telemetry,
+)
+
+FRAME_QUEUE = 2        # Frames waiting for the writer; each holds a pool buffer
+WRITER_PERIOD = 0.02   # s between telemetry polls
+FLUSH_PERIOD = 1.0     # s
+
+
+class Recorder:
+    """Record camera, detections, ESP32 telemetry / commands and params."""
+
+    def __init__(self, path, camera, esp=None, params=None,
+                 frames: str | None = "jpeg", jpeg_quality: int = 90):
+        if frames not in ("jpeg", "raw", None):
+            raise ValueError("frames must be 'jpeg', 'raw' or None")
+        self.path = str(path)
+        self.camera = camera
+        self.esp = esp
+        self.params = params
+        self.frames = frames
+        self.jpeg_quality = jpeg_quality
+
+        self._log = None
+        self._running = False
+        self._thread = None
+        self._queue = queue.Queue(maxsize=FRAME_QUEUE)
+        self._last_params = None
+        self.frames_dropped = 0
+
+    @property
+    def is_running(self) -> bool:
+        return self._running
+
+    def start(self):
+        self._log = LogWriter(self.path)
+        self._running = True
+        self._check_params()
+        self.camera.subscribe(self._on_frame)
+        if self.esp is not None:
+            self.esp.command_sink = self._on_command
+        self._thread = threading.Thread(target=self._writer, daemon=True)
+        self._thread.start()
+        print(f"Recording to {self.path}")
+
+    def stop(self):
+        if not self._running:
+            return
+        self._running = False
+        self.camera.unsubscribe(self._on_frame)
+        if self.esp is not None:
+            self.esp.command_sink = None
+        self._thread.join(timeout=2.0)
+        self._thread = None
+        self._log.close()
+        print(f"Recorded {self._log.records} records, {self._log.bytes / 1e6:.1f} MB, "
+              f"{self.frames_dropped} frames dropped, {self._log.dropped} records after stop")
+
+    def stats(self) -> dict:
+        log = self._log
+        return {"records": log.records if log else 0, "bytes": log.bytes if log else 0,
+                "frames_dropped": self.frames_dropped}
+
+    # ── Sources ──────────────────────────────────────────────────
+
+    def _on_frame(self, frame_id: int, t_ns: int, blobs, image):
+        """Camera thread: blobs now, the frame later on the writer thread."""
+        if not self._running:
+            return
+        now = time.monotonic_ns()
+        self._log.write(REC_BLOBS, now, pack_blobs(frame_id, t_ns, blobs))
+        if self.frames is None:
+            return
+        try:
+            self._queue.put_nowait((frame_id, t_ns, image, now))
+        except queue.Full:
+            self.frames_dropped += 1
+
+    def _on_command(self, msg_type: int, seq: int, payload: bytes, t_ns: int):
+        self._log.write(REC_COMMAND, t_ns, pack_command(msg_type, seq, payload))
+
+    # ── Writer thread ────────────────────────────────────────────
+
+    def _writer(self):
+        flushed = time.monotonic()
+        while self._running or not self._queue.empty():
+            try:
+                frame_id, t_ns, image, now = self._queue.get(timeout=WRITER_PERIOD)
+                self._write_frame(frame_id, t_ns, image, now)
+                del image  # Give the pool buffer back
+            except queue.Empty:
+                pass
+
+            self._poll_telemetry()
+            self._check_params()
+            if time.monotonic() - flushed > FLUSH_PERIOD:
+                self._log.flush()
+                flushed = time.monotonic()
+        self._poll_telemetry()
+
+    def _write_frame(self, frame_id: int, t_ns: int, image, now: int):
+        if self.frames == "raw":
+            self._log.write(REC_FRAME_RAW, now, *pack_frame_raw(frame_id, t_ns, image))
+            return
+        if native.JPEG_AVAILABLE:
+            jpeg = native.encode_jpeg(image, self.jpeg_quality)
+        else:
+            ok, buf = cv2.imencode(".jpg", image, [cv2.IMWRITE_JPEG_QUALITY, self.jpeg_quality])
+            jpeg = buf.tobytes() if ok else None
+        if jpeg:
+            self._log.write(REC_FRAME_JPEG, now, *pack_frame_jpeg(frame_id, t_ns, jpeg))
+
+    def _poll_telemetry(self):
+        if self.esp is None:
+            return
+        records = self.esp.telemetry()
+        if records:
+            items = [(r["rx_ns"], encode_record(r)) for r in records]
+            self._log.write(REC_TELEMETRY, items[-1][0], pack_telemetry(items))
+
+    def _check_params(self):
+        """A PARAMS record at start and whenever a value changes."""
+        if self.params is None:
+            return
+        current = asdict(self.params)
+        if current != self._last_params:
+            self._last_params = current
+            self._log.write(REC_PARAMS, time.monotonic_ns(), pack_params(self.params))
@@ -0,0 +1,259 @@
+"""
+Replay - run a recorded binlog back through Camera and the world model.
+
+ReplayCamera is a Camera whose frames come from the log instead of a
+device, so everything built on Camera (the web server, WorldModel, even
+a Recorder) works on it unchanged. Detection runs again with the
+current params, which is the point: change a threshold or the detector,
+replay real track footage, and see what it does to the blobs and the
+time per frame. Telemetry goes into the WorldModel with its recorded
+timestamps, and the world state is published on the log's clock, so
+fusion behaves as it did on the car.
+
+    python -m recording.replay runs/today.wlog              # flat out, print a report
+    python -m recording.replay runs/today.wlog --speed 1    # real time
+    python -m recording.replay runs/today.wlog --serve      # watch it on :8080
+
+    --recorded-params   detect with the params stored in the log
+    --no-detect         publish the recorded blobs instead of detecting
+
+Blobs are compared with the ones recorded live. With JPEG frames some
+differences are expected (compression); with raw frames and
+--recorded-params any difference is a change in behaviour.
+"""
+
+import argparse
+import asyncio
+import threading
+import time
+
+import cv2
+import numpy as np
+
+import native
+from control.esp32_serial import decode_record
+from params import Parameters
+from perception.fusion import FUSION_RATE_HZ, WorldModel
+from recording.binlog import (
+    REC_BLOBS, REC_COMMAND, REC_FRAME_JPEG, REC_FRAME_RAW, REC_PARAMS, REC_TELEMETRY,
+    LogReader, unpack_blobs, unpack_frame, unpack_params, unpack_telemetry,
+)
+from sensors.camera import FRAME_POOL_SLOTS, Camera, ColorBlob
+
+BLOB_TOLERANCE_PX = 3  # Centre / size difference still counted as the same blob
+
+
+class ReplayCamera(Camera):
+    """Camera fed by feed() instead of a capture device."""
+
+    def __init__(self, params: Parameters, detect: bool = True):
+        super().__init__(params)
+        self.detect = detect
+        self._pool = None
+
+    def start(self) -> bool:
+        self._running = True
+        return True
+
+    def stop(self):
+        self._running = False
+
+    def feed(self, image: np.ndarray, t_ns: int,
+             blobs: list[ColorBlob] | None = None) -> list[ColorBlob]:
+        """Publish one frame as if just captured at t_ns. Returns its blobs.
+
+        With detect off, blobs are published as given instead.
+        """
+        pool = self._pool
+        if pool is None or tuple(pool.shape) != image.shape:
+            pool = self._pool = native.FramePool(FRAME_POOL_SLOTS, *image.shape[:2])
+        frame = pool.acquire()
+        while frame is None:  # Stream clients still hold every buffer
+            time.sleep(0.001)
+            frame = pool.acquire()
+        np.copyto(frame.array, image)
+        self._publish(pool, frame, t_ns, None if self.detect else (blobs or []))
+        return self.get_blobs()
+
+
+class Replay:
+    """Plays a log into a ReplayCamera and WorldModel, in recorded time order.
+
+    speed 1 is real time, 4 four times faster, 0 as fast as possible.
+    """
+
+    def __init__(self, log: LogReader, camera: ReplayCamera, world: WorldModel | None = None,
+                 speed: float = 0.0, apply_params: bool = False):
+        self.log = log
+        self.camera = camera
+        self.world = world
+        self.speed = speed
+        self.apply_params = apply_params
+        self._running = False
+        self._thread = None
+        self.stats = {}
+
+    @property
+    def is_running(self) -> bool:
+        return self._running
+
+    def start(self):
+        """run() on a thread, for --serve."""
+        self._running = True
+        self._thread = threading.Thread(target=self.run, daemon=True)
+        self._thread.start()
+
+    def stop(self):
+        self._running = False
+        if self._thread:
+            self._thread.join(timeout=2.0)
+            self._thread = None
+
+    def run(self) -> dict:
+        log = self.log
+        self._running = True
+        self.camera.start()
+        recorded = {}  # frame_id -> live blobs, until its frame comes up
+        detect_ns = []
+        frames = changed = telemetry = commands = 0
+        period = int(1e9 / FUSION_RATE_HZ)
+        next_publish = log.start_ns
+        wall_start = time.perf_counter()
+
+        for rec in log.by_time():
+            if not self._running:
+                break
+            if self.world is not None:
+                while next_publish <= rec.t_ns:
+                    self.world.publish(next_publish)
+                    next_publish += period
+            if self.speed > 0:
+                due = wall_start + (rec.t_ns - log.start_ns) / 1e9 / self.speed
+                time.sleep(max(due - time.perf_counter(), 0))
+
+            if rec.type == REC_PARAMS:
+                if self.apply_params:
+                    self.camera.params.update(**unpack_params(rec.payload))
+            elif rec.type == REC_BLOBS:
+                frame_id, _, blobs = unpack_blobs(rec.payload)
+                recorded[frame_id] = [ColorBlob(*b) for b in blobs]
+            elif rec.type in (REC_FRAME_RAW, REC_FRAME_JPEG):
+                frame_id, t_ns, image = unpack_frame(rec)
+                if rec.type == REC_FRAME_JPEG:
+                    image = cv2.imdecode(np.frombuffer(image, np.uint8), cv2.IMREAD_COLOR)
+                    if image is None:
+                        continue
+                live = recorded.pop(frame_id, [])
+                started = time.perf_counter_ns()
+                blobs = self.camera.feed(image, t_ns, live)
+                detect_ns.append(time.perf_counter_ns() - started)
+                frames += 1
+                if not _same_blobs(blobs, live):
+                    changed += 1
+            elif rec.type == REC_TELEMETRY:
+                for rx_ns, raw in unpack_telemetry(rec.payload):
+                    telemetry += 1
+                    if self.world is not None:
+                        self.world.add_telemetry(decode_record(raw, rx_ns))
+            elif rec.type == REC_COMMAND:
+                commands += 1
+
+        wall = time.perf_counter() - wall_start
+        span = (log.end_ns - log.start_ns) / 1e9
+        detect_ms = sorted(t / 1e6 for t in detect_ns)
+        self.stats = {
+            "frames": frames,
+            "frames_changed": changed,
+            "telemetry": telemetry,
+            "commands": commands,
+            "log_s": span,
+            "wall_s": wall,
+            "speedup": span / wall if wall > 0 else 0.0,
+            "detect_ms_mean": sum(detect_ms) / len(detect_ms) if detect_ms else 0.0,
+            "detect_ms_p95": detect_ms[int(len(detect_ms) * 0.95)] if detect_ms else 0.0,
+            "detect_ms_max": detect_ms[-1] if detect_ms else 0.0,
+        }
+        self._running = False
+        return self.stats
+
+
+def _same_blobs(a: list[ColorBlob], b: list[ColorBlob]) -> bool:
+    """Same blobs, in any order, within BLOB_TOLERANCE_PX."""
+    if len(a) != len(b):
+        return False
+    left = list(b)
+    for blob in a:
+        for other in left:
+            if (other.color == blob.color
+                    and abs(other.x - blob.x) <= BLOB_TOLERANCE_PX
+                    and abs(other.y - blob.y) <= BLOB_TOLERANCE_PX
+                    and abs(other.width - blob.width) <= BLOB_TOLERANCE_PX
+                    and abs(other.height - blob.height) <= BLOB_TOLERANCE_PX):
+                left.remove(other)
+                break
+        else:
+            return False
+    return True
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Replay a recorded run")
+    parser.add_argument("log")
+    parser.add_argument("--speed", type=float, default=None,
+                        help="1 = real time, 0 = as fast as possible (default, 1 with --serve)")
+    parser.add_argument("--recorded-params", action="store_true",
+                        help="detect with the params stored in the log")
+    parser.add_argument("--no-detect", action="store_true",
+                        help="publish the recorded blobs instead of detecting again")
+    parser.add_argument("--serve", action="store_true", help="web server on :8080 meanwhile")
+    args = parser.parse_args()
+
+    log = LogReader(args.log)
+    print(f"{args.log}: {len(log)} records, {(log.end_ns - log.start_ns) / 1e9:.1f} s, "
+          f"{log.count(REC_FRAME_RAW) + log.count(REC_FRAME_JPEG)} frames, "
+          f"native {'on' if native.AVAILABLE else 'off'}")
+
+    params = Parameters() if args.recorded_params else Parameters.load()
+    camera = ReplayCamera(params, detect=not args.no_detect)
+    world = WorldModel(camera)
+    world.start(publish_thread=False)
+    speed = args.speed if args.speed is not None else (1.0 if args.serve else 0.0)
+    replay = Replay(log, camera, world, speed, args.recorded_params)
+
+    if args.serve:
+        from server import run_server
+
+        async def serve():
+            runner = await run_server(camera, params, world)
+            replay.start()
+            try:
+                while replay.is_running:
+                    await asyncio.sleep(0.5)
+            finally:
+                replay.stop()
+                await runner.cleanup()
+
+        try:
+            asyncio.run(serve())
+        except KeyboardInterrupt:
+            replay.stop()
+        stats = replay.stats
+    else:
+        stats = replay.run()
+
+    if stats:
+        print(f"{stats['frames']} frames in {stats['wall_s']:.2f} s "
+              f"({stats['speedup']:.1f}x real time)")
+        print(f"detect: mean {stats['detect_ms_mean']:.2f} ms, "
+              f"p95 {stats['detect_ms_p95']:.2f} ms, max {stats['detect_ms_max']:.2f} ms")
+        print(f"frames with different blobs than live: {stats['frames_changed']}")
+        print(f"telemetry records: {stats['telemetry']}, commands: {stats['commands']}")
+        state = world.state()
+        if state and state["pose"]:
+            pose = state["pose"]
+            print(f"final pose: x {pose['x']:.0f} mm, y {pose['y']:.0f} mm, "
+                  f"heading {pose['heading']:.2f} rad")
+
+
+if __name__ == "__main__":
+    main()
@@ -10,7 +10,8 @@ What changed from Stage 2:
   - If you change params at runtime, the NEXT frame uses new values!
 
 This is possible because Python reads self.params.red_h_min each frame.
-There is no caching. So the web server can update params between frames,
+There is no caching (the native colour table below is rebuilt from
+params.revision). So the web server can update params between frames,
 and the camera thread sees the new values immediately.
 
 Key insight: the Camera doesn't OWN the parameters. It just holds a
@@ -19,6 +20,31 @@ REFERENCE to the same object that the web server modifies.
     params = Parameters()
     camera = Camera(params)   # camera.params IS the same object
     params.red_h_min = 5      # camera sees the change next frame
+
+Color masks come from the native kernel (native/) when it is built: one
+pass over the frame instead of cvtColor + an inRange per range. The
+native path classifies through a native.ColorLut, a BGR -> colour table
+rebuilt in the background only when params.revision says a range moved;
+until the new table is in, frames use the old one. At LUT_BITS 6 a few
+pixels right on a range edge can come out differently from OpenCV, at 8
+the masks are identical. The OpenCV path is the fallback.
+
+Frames live in a native.FramePool: capture writes into a free buffer,
+and detection and every stream client share that one read-only frame
+instead of each taking a copy. Products of a frame (HSV, masks, JPEGs)
+are made on first request and shared by everyone else asking for the
+same frame, so extra browser viewers cost almost nothing. JPEGs go
+through libjpeg-turbo (native.encode_jpeg) when it was built in.
+
+Every frame keeps its capture time (time.monotonic_ns(), less
+params.camera_latency_ms) and subscribers get it with the blobs, so
+perception/fusion.py can use the pose the car had when it was taken.
+
+Detection only looks inside the params ROI. With native, blobs come
+from connected-component labeling instead of contours, after the same
+erode / dilate as _find_blobs() and with the same area (cv2.contourArea
+of the outer border), so min_area filters alike on both paths.
+params.detect_scale can add a subsampled first pass.
 """
 
 import threading
@@ -28,6 +54,7 @@ from dataclasses import dataclass
 import cv2
 import numpy as np
 
+import native
 from params import Parameters
 
 # Camera settings
@@ -36,6 +63,21 @@ CAMERA_WIDTH = 640
 CAMERA_HEIGHT = 480
 CAMERA_FOV = 120  # degrees (wide-angle lens)
 
+# Frame buffers: the one being captured, the latest, and room for
+# stream clients still encoding older ones
+FRAME_POOL_SLOTS = 6
+
+# Bits per channel of the native colour table: 6 is 256 kB and about
+# 6x faster than converting to HSV; 8 is exact but 16 MB
+LUT_BITS = 6
+
+# Detected colors and the param ranges that make each one up
+COLOR_RANGES = {
+    "red": ("red1", "red2"),  # Hue wraps at 180, so red needs two
+    "green": ("green",),
+    "magenta": ("magenta",),
+}
+
 
 @dataclass
 class ColorBlob:
@@ -81,13 +123,58 @@ class Camera:
         self._thread: threading.Thread | None = None
         self._lock = threading.Lock()
 
-        self._frame: np.ndarray | None = None
+        self._frame = None  # Latest published native.FramePool frame
         self._blobs: list[ColorBlob] = []
+        self._frame_ns = 0  # Capture time of _frame, time.monotonic_ns() clock
+        self._frame_count = 0  # Id of the last published frame
+        self._subscribers = []
+
+        # Per-frame products, dropped when the frame changes. RLock since
+        # one product can be built from another (mask from HSV).
+        self._shared_lock = threading.RLock()
+        self._shared_id = -1
+        self._shared_items: dict = {}
+
+        # Detection path: native when built, the table unless use_lut is
+        # off. recording/bench.py switches these to compare the paths.
+        self.use_native = native.AVAILABLE
+        self.use_lut = True
+
+        # Native colour table, and the params revision / ranges it follows
+        self._lut = native.ColorLut(LUT_BITS) if native.AVAILABLE else None
+        self._lut_lock = threading.Lock()
+        self._lut_revision = -1
+        self._lut_specs = None
 
     @property
     def is_running(self) -> bool:
         return self._running
 
+    @property
+    def frame_id(self) -> int:
+        """Id of the latest frame, 0 before the first. Goes up by one per frame."""
+        frame = self._frame
+        return frame.id if frame is not None else 0
+
+    @property
+    def frame_time_ns(self) -> int:
+        """When the latest frame was taken (time.monotonic_ns()), 0 before the first."""
+        return self._frame_ns
+
+    def subscribe(self, callback):
+        """Call callback(frame_id, t_ns, blobs, image) on the capture thread after each frame.
+
+        t_ns is the capture time, not when detection finished, so the
+        blobs can be matched with where the car was. image is the
+        read-only frame; holding on to it keeps its pool buffer busy.
+        Keep it quick.
+        """
+        # A new list each time, so the capture thread never sees one change
+        self._subscribers = self._subscribers + [callback]
+
+    def unsubscribe(self, callback):
+        self._subscribers = [c for c in self._subscribers if c != callback]
+
     def start(self) -> bool:
         """Open camera and start capturing in background."""
         if self._running:
@@ -125,25 +212,88 @@ class Camera:
             return self._blobs.copy()
 
     def get_frame(self) -> np.ndarray | None:
-        """Get latest frame (BGR format)."""
+        """Get latest frame (BGR format).
+
+        Read-only and not a copy: the buffer stays valid while you hold
+        it. Use .copy() if you want to draw on it.
+        """
         with self._lock:
             if self._frame is not None:
-                return self._frame.copy()
+                return self._frame.array
             return None
 
-    def get_jpeg_frame(self, quality: int = 80) -> bytes | None:
-        """Get frame with bounding boxes as JPEG bytes."""
+    def get_jpeg_frame(self, quality: int = 80, scale: int = 1) -> bytes | None:
+        """Get frame with bounding boxes as JPEG bytes, 1/scale the size."""
         with self._lock:
             if self._frame is None:
                 return None
-            frame = self._frame.copy()
+            frame = self._frame
             blobs = self._blobs.copy()
 
+        def encode():
+            annotated = self._shared(frame, "annotated",
+                                     lambda: self._annotate(frame.array, blobs))
+            return self._encode_jpeg(annotated, quality, scale)
+
+        return self._shared(frame, ("jpeg", quality, scale), encode)
+
+    def get_jpeg_mask(self, color: str, quality: int = 80, scale: int = 1) -> bytes | None:
+        """Get binary color mask as JPEG bytes, 1/scale the size."""
+        if color not in COLOR_RANGES:
+            return None
+        with self._lock:
+            if self._frame is None:
+                return None
+            frame = self._frame
+
+        return self._shared(frame, ("mask_jpeg", color, quality, scale),
+                            lambda: self._encode_jpeg(self._shared_mask(frame, color),
+                                                      quality, scale))
+
+    # ── Private methods ──────────────────────────────────────────
+
+    def _shared(self, frame, key, make):
+        """Build a product of frame once; later callers get the same object."""
+        with self._shared_lock:
+            if self._shared_id != frame.id:
+                self._shared_id = frame.id
+                self._shared_items = {}
+            if key not in self._shared_items:
+                self._shared_items[key] = make()
+            return self._shared_items[key]
+
+    def _shared_mask(self, frame, color: str) -> np.ndarray:
+        """One color's mask of frame, via a shared HSV image on the OpenCV path."""
+        def make():
+            hsv = None
+            if not self.use_native:
+                hsv = self._shared(frame, "hsv",
+                                   lambda: cv2.cvtColor(frame.array, cv2.COLOR_BGR2HSV))
+            return self._color_masks(frame.array, [color], hsv)[color]
+
+        return self._shared(frame, ("mask", color), make)
+
+    def _encode_jpeg(self, image: np.ndarray, quality: int, scale: int) -> bytes | None:
+        """JPEG of image shrunk by scale, libjpeg-turbo if built in."""
+        if native.JPEG_AVAILABLE:
+            return native.encode_jpeg(image, quality, scale)
+        if scale > 1:
+            h, w = image.shape[:2]
+            image = cv2.resize(image, (w // scale, h // scale), interpolation=cv2.INTER_AREA)
+        ret, jpeg = cv2.imencode(".jpg", image, [cv2.IMWRITE_JPEG_QUALITY, quality])
+        return jpeg.tobytes() if ret else None
+
+    def _annotate(self, image: np.ndarray, blobs: list[ColorBlob]) -> np.ndarray:
+        """Copy of image with the ROI, boxes and labels drawn on."""
+        frame = image.copy()
         colors = {
             "red": (0, 0, 255),
             "green": (0, 255, 0),
             "magenta": (255, 0, 255),
         }
+        x, y, w, h = self._roi(frame)
+        cv2.rectangle(frame, (x, y), (x + w - 1, y + h - 1), (128, 128, 128), 1)
+
         for blob in blobs:
             bgr = colors.get(blob.color, (255, 255, 255))
             x = blob.x - blob.width // 2
@@ -154,38 +304,7 @@ class Camera:
                 (x, y - 8), cv2.FONT_HERSHEY_SIMPLEX, 0.5, bgr, 1,
             )
 
-        ret, jpeg = cv2.imencode(".jpg", frame, [cv2.IMWRITE_JPEG_QUALITY, quality])
-        return jpeg.tobytes() if ret else None
-
-    def get_jpeg_mask(self, color: str, quality: int = 80) -> bytes | None:
-        """Get binary color mask as JPEG bytes."""
-        with self._lock:
-            if self._frame is None:
-                return None
-            frame = self._frame.copy()
-
-        hsv = cv2.cvtColor(frame, cv2.COLOR_BGR2HSV)
-
-        if color == "red":
-            lower1, upper1 = self._range("red1")
-            lower2, upper2 = self._range("red2")
-            mask = cv2.bitwise_or(
-                cv2.inRange(hsv, lower1, upper1),
-                cv2.inRange(hsv, lower2, upper2),
-            )
-        elif color == "green":
-            lower, upper = self._range("green")
-            mask = cv2.inRange(hsv, lower, upper)
-        elif color == "magenta":
-            lower, upper = self._range("magenta")
-            mask = cv2.inRange(hsv, lower, upper)
-        else:
-            return None
-
-        ret, jpeg = cv2.imencode(".jpg", mask, [cv2.IMWRITE_JPEG_QUALITY, quality])
-        return jpeg.tobytes() if ret else None
-
-    # ── Private methods ──────────────────────────────────────────
+        return frame
 
     def _range(self, color: str):
         """Build (lower, upper) HSV numpy arrays from params.
@@ -211,46 +330,135 @@ class Camera:
         return (np.array([p.magenta_h_min, p.magenta_s_min, p.magenta_v_min]),
                 np.array([p.magenta_h_max, p.magenta_s_max, p.magenta_v_max]))
 
+    def _roi(self, frame: np.ndarray) -> tuple[int, int, int, int]:
+        """Params ROI clipped to the frame, as (x, y, width, height)."""
+        p = self.params
+        frame_h, frame_w = frame.shape[:2]
+        x0 = min(max(p.roi_x, 0), frame_w)
+        y0 = min(max(p.roi_y, 0), frame_h)
+        x1 = min(max(p.roi_x + p.roi_width, x0), frame_w)
+        y1 = min(max(p.roi_y + p.roi_height, y0), frame_h)
+        return x0, y0, x1 - x0, y1 - y0
+
+    def _bounds(self, name: str) -> tuple:
+        """_range() flattened to (h_lo, s_lo, v_lo, h_hi, s_hi, v_hi) for native."""
+        lower, upper = self._range(name)
+        return tuple(int(x) for x in (*lower, *upper))
+
+    def _classifier(self):
+        """colors argument for native: the table, updated if a range changed
+        (or the ranges themselves, with use_lut off)."""
+        with self._lut_lock:
+            if self.params.revision != self._lut_revision:
+                self._lut_revision = self.params.revision
+                specs = [[self._bounds(r) for r in COLOR_RANGES[c]] for c in COLOR_RANGES]
+                if specs != self._lut_specs:
+                    self._lut_specs = specs
+                    self._lut.update(specs)
+            return self._lut if self.use_lut else self._lut_specs
+
     def _capture_loop(self):
         """Background thread: grab frames and run detection."""
+        pool = None
+        in_place = True  # Until read() is seen to hand back a buffer of its own
         while self._running:
-            ret, frame = self._cap.read()
+            frame = pool.acquire() if pool else None
+            if pool and frame is None:
+                # Every buffer still held by a slow reader
+                time.sleep(0.001)
+                continue
+
+            # read() fills the buffer in place when the size matches
+            buf = frame.array if frame and in_place else None
+            ret, image = self._cap.read(buf) if buf is not None else self._cap.read()
             if not ret:
                 continue
-            blobs = self._detect_blobs(frame)
-            with self._lock:
-                self._frame = frame
-                self._blobs = blobs
+            # read() returns once the frame is in; exposure was before that
+            t_ns = time.monotonic_ns() - int(self.params.camera_latency_ms * 1e6)
+            if frame is None or image.shape != frame.array.shape:
+                # First frame, or the camera size changed: size the pool to it
+                pool = native.FramePool(FRAME_POOL_SLOTS, *image.shape[:2])
+                frame = pool.acquire()
+                np.copyto(frame.array, image)
+            elif image.ctypes.data != frame.array.ctypes.data:
+                # Same size but not filled in place (some backends never
+                # do): one copy into the slot, and stop offering the buffer
+                if in_place:
+                    print("Camera: read() does not fill the frame buffer, copying")
+                    in_place = False
+                np.copyto(frame.array, image)
+
+            self._publish(pool, frame, t_ns)
+
+    def _publish(self, pool, frame, t_ns: int, blobs: list[ColorBlob] | None = None):
+        """Detect (unless blobs are given), make frame the latest, tell subscribers."""
+        if blobs is None:
+            blobs = self._detect_blobs(frame.array)
+        self._frame_count += 1
+        pool.publish(frame, self._frame_count)
+        with self._lock:
+            self._frame = frame
+            self._blobs = blobs
+            self._frame_ns = t_ns
+        for callback in self._subscribers:
+            callback(self._frame_count, t_ns, blobs, frame.array)
 
     def _detect_blobs(self, frame: np.ndarray) -> list[ColorBlob]:
         """Detect colored blobs using current params."""
-        hsv = cv2.cvtColor(frame, cv2.COLOR_BGR2HSV)
         blobs = []
 
         # Read min_area from params (not a constant!)
         min_area = self.params.min_area
-
-        # Red (two ranges)
-        rl1, ru1 = self._range("red1")
-        rl2, ru2 = self._range("red2")
-        mask_red = cv2.bitwise_or(
-            cv2.inRange(hsv, rl1, ru1),
-            cv2.inRange(hsv, rl2, ru2),
-        )
-        blobs.extend(self._find_blobs(mask_red, "red", min_area))
-
-        # Green
-        gl, gu = self._range("green")
-        blobs.extend(self._find_blobs(cv2.inRange(hsv, gl, gu), "green", min_area))
-
-        # Magenta
-        ml, mu = self._range("magenta")
-        blobs.extend(self._find_blobs(cv2.inRange(hsv, ml, mu), "magenta", min_area))
+        x, y, w, h = self._roi(frame)
+
+        if self.use_native:
+            names = list(COLOR_RANGES)
+            found = native.detect_blobs(frame, self._classifier(), (x, y, w, h),
+                                        self.params.detect_scale, min_area)
+            for index, bx, by, bw, bh, area in found:
+                center_x = bx + bw // 2
+                center_y = by + bh // 2
+                angle = self._pixel_to_angle(center_x)
+                blobs.append(ColorBlob(names[index], angle, center_x, center_y, bw, bh, area))
+            return blobs
+
+        # A slice is a view, so the crop costs nothing
+        roi = frame[y:y + h, x:x + w]
+        for color, mask in self._color_masks(roi, COLOR_RANGES).items():
+            blobs.extend(self._find_blobs(mask, color, min_area, (x, y)))
 
         return blobs
 
-    def _find_blobs(self, mask: np.ndarray, color: str, min_area: int) -> list[ColorBlob]:
-        """Find blobs in a binary mask."""
+    def _color_masks(self, frame: np.ndarray, colors,
+                     hsv: np.ndarray | None = None) -> dict[str, np.ndarray]:
+        """Binary (0/255) mask per color name, from the current params.
+
+        hsv: frame already converted, if the caller has it (OpenCV path).
+        """
+        colors = list(colors)
+
+        if self.use_native:
+            masks = dict(zip(COLOR_RANGES, native.classify_hsv(frame, self._classifier())))
+            return {color: masks[color] for color in colors}
+
+        if hsv is None:
+            hsv = cv2.cvtColor(frame, cv2.COLOR_BGR2HSV)
+        masks = {}
+        for color in colors:
+            mask = None
+            for name in COLOR_RANGES[color]:
+                lower, upper = self._range(name)
+                part = cv2.inRange(hsv, lower, upper)
+                mask = part if mask is None else cv2.bitwise_or(mask, part)
+            masks[color] = mask
+        return masks
+
+    def _find_blobs(self, mask: np.ndarray, color: str, min_area: int,
+                    offset: tuple[int, int] = (0, 0)) -> list[ColorBlob]:
+        """Find blobs in a binary mask whose top-left is at offset in the frame.
+
+        native/src/detect.cpp does the same opening and area; change both.
+        """
         blobs = []
         kernel = np.ones((5, 5), np.uint8)
         mask = cv2.erode(mask, kernel, iterations=1)
@@ -262,6 +470,8 @@ class Camera:
             if area < min_area:
                 continue
             x, y, w, h = cv2.boundingRect(contour)
+            x += offset[0]
+            y += offset[1]
             center_x = x + w // 2
             center_y = y + h // 2
             angle = self._pixel_to_angle(center_x)
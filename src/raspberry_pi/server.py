@@ -17,10 +17,23 @@ The flow:
   6. User sees the effect immediately in the MJPEG stream
 
 No restart needed! The Camera reads params every frame.
+
+  GET  /api/world      -> fused pose, landmarks and LIDAR (perception/fusion.py)
+  GET  /api/latency    -> per-stage latency histograms (control/latency.py)
+  POST /api/latency    -> clears them
+
+Streams take ?scale=1|2|4 (shrink), ?fps=N and ?quality=N per client, e.g.
+/stream/camera/red?scale=4&fps=5. Each distinct JPEG is encoded once per
+frame and the same bytes go to every client asking for it. Encoding runs
+on one low-priority background thread, so however many browsers are open
+the streams use at most one core and always yield to detection.
 """
 
 import asyncio
 import json
+import os
+import threading
+from concurrent.futures import ThreadPoolExecutor
 from dataclasses import asdict
 from pathlib import Path
 
@@ -30,15 +43,51 @@ from params import Parameters
 
 TEMPLATES_DIR = Path(__file__).parent / "templates"
 
+# Stream limits
+STREAM_DEFAULT_FPS = 20
+STREAM_MAX_FPS = 30
+STREAM_SCALES = (1, 2, 4)
+STREAM_NICE = 10  # Encoder thread priority (higher = nicer)
+
+
+def _lower_priority():
+    """Runs in the encoder thread: nice just this thread (Linux)."""
+    try:
+        os.setpriority(os.PRIO_PROCESS, threading.get_native_id(), STREAM_NICE)
+    except (AttributeError, OSError):
+        pass
+
+
+def _stream_options(request) -> tuple[int, float, int]:
+    """(scale, seconds between frames, quality) from the query string."""
+    try:
+        scale = int(request.query.get("scale", 1))
+        fps = float(request.query.get("fps", STREAM_DEFAULT_FPS))
+        quality = int(request.query.get("quality", 80))
+    except ValueError:
+        raise web.HTTPBadRequest(text="scale, fps and quality must be numbers")
+    if scale not in STREAM_SCALES:
+        raise web.HTTPBadRequest(text=f"scale must be one of {STREAM_SCALES}")
+    fps = min(max(fps, 0.5), STREAM_MAX_FPS)
+    quality = min(max(quality, 10), 95)
+    return scale, 1.0 / fps, quality
+
 
 class WebServer:
     """Web server with camera stream and parameter tuning."""
 
-    def __init__(self, camera, params: Parameters):
+    def __init__(self, camera, params: Parameters, world=None, tracer=None):
         self.camera = camera
         self.params = params
+        self.world = world
+        self.tracer = tracer
         self.app = web.Application()
 
+        # All stream encoding happens here, one frame at a time
+        self._encoder = ThreadPoolExecutor(
+            max_workers=1, thread_name_prefix="stream", initializer=_lower_priority,
+        )
+
         # Pages
         self.app.router.add_get("/", self.index)
 
@@ -50,29 +99,23 @@ class WebServer:
         self.app.router.add_get("/api/params", self.api_params_get)
         self.app.router.add_post("/api/params", self.api_params_set)
 
+        # Fused world state
+        self.app.router.add_get("/api/world", self.api_world)
+
+        # Camera -> PWM latency
+        self.app.router.add_get("/api/latency", self.api_latency_get)
+        self.app.router.add_post("/api/latency", self.api_latency_reset)
+
     async def index(self, request):
         html = (TEMPLATES_DIR / "camera.html").read_text()
         return web.Response(text=html, content_type="text/html")
 
     async def stream_camera(self, request):
         """MJPEG stream with bounding boxes."""
-        response = web.StreamResponse()
-        response.content_type = "multipart/x-mixed-replace; boundary=frame"
-        await response.prepare(request)
-        try:
-            while True:
-                if self.camera.is_running:
-                    jpeg = self.camera.get_jpeg_frame()
-                    if jpeg:
-                        await response.write(
-                            b"--frame\r\n"
-                            b"Content-Type: image/jpeg\r\n\r\n"
-                            + jpeg + b"\r\n"
-                        )
-                await asyncio.sleep(0.05)
-        except (ConnectionResetError, ConnectionAbortedError):
-            pass
-        return response
+        scale, interval, quality = _stream_options(request)
+        return await self._stream(
+            request, interval, lambda: self.camera.get_jpeg_frame(quality, scale),
+        )
 
     async def stream_camera_mask(self, request):
         """MJPEG stream of a single color mask."""
@@ -80,20 +123,33 @@ class WebServer:
         if color not in ("red", "green", "magenta"):
             return web.Response(status=404, text="Unknown color")
 
+        scale, interval, quality = _stream_options(request)
+        return await self._stream(
+            request, interval, lambda: self.camera.get_jpeg_mask(color, quality, scale),
+        )
+
+    async def _stream(self, request, interval: float, encode):
+        """Send encode() as MJPEG every interval seconds, new frames only."""
         response = web.StreamResponse()
         response.content_type = "multipart/x-mixed-replace; boundary=frame"
         await response.prepare(request)
+
+        loop = asyncio.get_running_loop()
+        sent_id = None
         try:
             while True:
-                if self.camera.is_running:
-                    jpeg = self.camera.get_jpeg_mask(color)
+                started = loop.time()
+                frame_id = self.camera.frame_id
+                if self.camera.is_running and frame_id != sent_id:
+                    sent_id = frame_id
+                    jpeg = await loop.run_in_executor(self._encoder, encode)
                     if jpeg:
                         await response.write(
                             b"--frame\r\n"
                             b"Content-Type: image/jpeg\r\n\r\n"
                             + jpeg + b"\r\n"
                         )
-                await asyncio.sleep(0.05)
+                await asyncio.sleep(max(interval - (loop.time() - started), 0.005))
         except (ConnectionResetError, ConnectionAbortedError):
             pass
         return response
@@ -125,9 +181,34 @@ class WebServer:
         return web.json_response(asdict(self.params))
 
 
-async def run_server(camera, params, host="0.0.0.0", port=8080):
+    # ── World API ────────────────────────────────────────────────
+
+    async def api_world(self, request):
+        """GET /api/world - Latest fused pose, landmarks and LIDAR points."""
+        state = self.world.state() if self.world else None
+        if state is None:
+            return web.Response(status=503, text="No world state yet")
+        return web.json_response(state)
+
+    # ── Latency API ──────────────────────────────────────────────
+
+    async def api_latency_get(self, request):
+        """GET /api/latency - Histograms per stage, camera exposure to PWM."""
+        if self.tracer is None:
+            return web.Response(status=503, text="No latency tracing (ESP32 not connected)")
+        return web.json_response(self.tracer.snapshot())
+
+    async def api_latency_reset(self, request):
+        """POST /api/latency - Start the histograms over."""
+        if self.tracer is None:
+            return web.Response(status=503, text="No latency tracing (ESP32 not connected)")
+        self.tracer.reset()
+        return web.json_response(self.tracer.snapshot())
+
+
+async def run_server(camera, params, world=None, tracer=None, host="0.0.0.0", port=8080):
     """Start the web server."""
-    server = WebServer(camera, params)
+    server = WebServer(camera, params, world, tracer)
     runner = web.AppRunner(server.app)
     await runner.setup()
     site = web.TCPSite(runner, host, port)